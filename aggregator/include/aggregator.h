@@ -9,53 +9,328 @@
 #include <grpcpp/grpcpp.h>
 // #include <grpcpp/server_builder.h>
 #include <map>
+#include <atomic>
+#include <cstdint>
 #include <mutex>
+#include <deque>
 #include <vector>
 #include <memory>
 #include <string>
+#include <chrono>
 
-#include "binance_connector.h"
-#include "okx_connector.h"
-#include "bitget_connector.h"
-#include "bybit_connector.h"
+#include "venue_registry.h"
+#include "consolidated_book.h"
+#include "io_pool.h"
+#include "merge_scheduler.h"
+#include "replay_connector.h"
+#include "latency.h"
+#include "metrics_server.h"
+#include "publish_throttle.h"
 
 class Connector;  // 前向声明
 
-class AggregatorServiceImpl final : public aggregator::AggregatorService::Service {
+class AggregatorServiceImpl;
+class BookFeed;
+class BandFeed;
+
+// 已序列化的 BookUpdate。每条消息只编码一次，所有订阅者共享同一份引用计数的 slice，
+// 写出时不再逐个订阅者序列化
+struct EncodedMessage {
+    grpc::ByteBuffer buffer;
+    int64_t origin_ns = 0;   // 触发本条消息的最早一帧的收到时间（mono_ns），0 表示不计延迟
+    int64_t publish_ns = 0;  // 编码入队的时间
+};
+using EncodedUpdate = std::shared_ptr<const EncodedMessage>;
+
+// 订阅流积压时少发的条数，见 BookWriter
+struct SubscriberStats {
+    uint64_t conflated = 0;
+    uint64_t dropped = 0;
+};
+
+// 单个订阅流（callback API），不占用线程。同一时刻最多一个 Write 在途，
+// 其余更新进有界队列。完整簿模式积压时丢最旧的（只保留最新的不丢信息）；
+// 增量模式不能丢单条增量，积压时由 feed 改发一次当前快照。
+class BookWriter final : public grpc::ServerWriteReactor<grpc::ByteBuffer> {
+public:
+    static constexpr size_t kQueueCapacity = 4;
+
+    BookWriter(AggregatorServiceImpl* service, std::string peer, bool deltas)
+        : service_(service), peer_(std::move(peer)), deltas_(deltas) {}
+
+    // 订阅的是合并簿还是档位，二者只设其一。由 service 在 subscribers_mutex_ 下设置
+    BookFeed* feed() const { return feed_; }
+    void set_feed(BookFeed* feed) { feed_ = feed; }
+    BandFeed* band_feed() const { return band_feed_; }
+    void set_band_feed(BandFeed* feed) { band_feed_ = feed; }
+    const std::string& peer() const { return peer_; }
+    // 到目前为止的 conflated / dropped，/metrics 读取
+    SubscriberStats stats();
+
+    // 行情线程调用：只入队或发起一次异步写，不阻塞。
+    // 增量模式队列已满时不入队并返回 false，调用方需改用 resync
+    bool push(const EncodedUpdate& msg);
+    // 丢弃积压的增量，改发快照
+    void resync(const EncodedUpdate& snapshot);
+
+    void OnWriteDone(bool ok) override;
+    void OnCancel() override;
+    void OnDone() override;
+
+private:
+    AggregatorServiceImpl* service_;
+    std::string peer_;
+    const bool deltas_;
+    BookFeed* feed_ = nullptr;
+    BandFeed* band_feed_ = nullptr;
+
+    std::mutex mutex_;
+    std::deque<EncodedUpdate> queue_;
+    EncodedUpdate in_flight_;  // 写完成前保持存活
+    bool writing_ = false;
+    bool closing_ = false;   // 已取消或写失败，不再接收新更新
+    bool finished_ = false;  // Finish 只能调用一次
+    uint64_t delivered_ = 0;
+    uint64_t conflated_ = 0;  // 队列满时被更新覆盖掉的条数（增量模式下被快照替换的条数）
+    uint64_t dropped_ = 0;    // 订阅断开时仍未发出的条数
+};
+
+// 订阅参数，来自 SubscribeRequest，已按默认值和上限规整
+struct FeedOptions {
+    size_t instrument = 0;
+    int depth = kTopLevels;
+    bool deltas = false;
+    bool on_change_only = false;  // 前 depth 档没有变化时不推送
+    bool venue_breakdown = false;  // 每档附带各交易所的数量
+    bool tradable = false;  // 推送对冲后不交叉的可成交视图，而不是原始合并簿
+    std::chrono::milliseconds min_interval{0};
+
+    bool operator==(const FeedOptions& o) const {
+        return instrument == o.instrument && depth == o.depth && deltas == o.deltas &&
+               on_change_only == o.on_change_only && min_interval == o.min_interval &&
+               venue_breakdown == o.venue_breakdown && tradable == o.tradable;
+    }
+};
+
+// 同一组订阅参数的所有订阅者共用一个 feed：每个 tick 最多生成一条消息，
+// 编码一次后所有订阅者共享同一份字节。所有成员受 service 的 subscribers_mutex_ 保护
+class BookFeed {
+public:
+    BookFeed(const FeedOptions& options, const Instrument& instrument,
+             std::chrono::milliseconds snapshot_interval)
+        : options_(options), instrument_(instrument), snapshot_interval_(snapshot_interval),
+          throttle_(options.min_interval) {}
+
+    const FeedOptions& options() const { return options_; }
+    std::vector<BookWriter*>& writers() { return writers_; }
+
+    // 合并簿变化后调用（持有该交易对的合并簿锁）：按节流和变化条件决定是否生成消息并推给订阅者。
+    // origin_ns 为本次变化最早一帧的收到时间，随消息带到写完成时统计端到端延迟
+    void publish(const ConsolidatedBook& book, int64_t origin_ns);
+    // publish 的前半部分：生成本次要推送的消息（完整快照或增量），不需要推送时返回空。
+    // 不碰订阅者，bench_deltas 直接用它比较两种模式的字节数
+    EncodedUpdate next(const ConsolidatedBook& book, int64_t origin_ns);
+    // 节流压下的变化已到期，需要补发（见 AggregatorServiceImpl::flush）
+    bool due(PublishThrottle::Clock::time_point now) const { return throttle_.due(now); }
+    // 上次推送后的完整快照，新订阅者先收到它；还没推送过返回空
+    EncodedUpdate snapshot();
+
+private:
+    EncodedUpdate encode(const aggregator::BookUpdate& msg) const;
+    void fill(aggregator::BookUpdate& msg, const std::vector<TopLevel>& bids,
+              const std::vector<TopLevel>& asks) const;
+    void fill_venues(aggregator::BookUpdate& msg) const;
+    void add_level(aggregator::BookUpdate& msg, bool is_bid, const TopLevel& lvl) const;
+
+    const FeedOptions options_;
+    const Instrument& instrument_;
+    const std::chrono::milliseconds snapshot_interval_;
+    std::vector<BookWriter*> writers_;
+
+    std::vector<TopLevel> top_bids_;  // 上次推送的前 depth 档
+    std::vector<TopLevel> top_asks_;
+    std::vector<TopLevel> cur_bids_;  // 本次的前 depth 档，复用内存
+    std::vector<TopLevel> cur_asks_;
+    uint64_t sequence_ = 0;
+    bool published_ = false;
+    PublishThrottle throttle_;
+    std::chrono::steady_clock::time_point last_snapshot_{};
+    EncodedUpdate snapshot_;  // 懒生成，推送后失效
+    VenueStamp venues_[kVenueCount];  // 上次推送时各交易所的状态
+    int64_t origin_ns_ = 0;   // 本次推送的打点，encode 时写入消息
+    int64_t publish_ns_ = 0;
+};
+
+// 档位订阅参数，来自 VolumeBandsRequest / PriceBandsRequest，已按默认值规整
+struct BandOptions {
+    size_t instrument = 0;
+    bool price_bands = false;        // false：名义金额档位；true：偏离 mid 的价格档位
+    std::vector<double> thresholds;  // 名义金额（计价币）或基点，按请求顺序
+    std::chrono::milliseconds min_interval{0};
+
+    bool operator==(const BandOptions& o) const {
+        return instrument == o.instrument && price_bands == o.price_bands &&
+               thresholds == o.thresholds && min_interval == o.min_interval;
+    }
+};
+
+// 一个档位的结果。价格为 0 表示深度不够；名义金额档位不填数量
+struct BandLevel {
+    PriceTicks bid_price = 0;
+    Quantity bid_qty = 0;
+    PriceTicks ask_price = 0;
+    Quantity ask_qty = 0;
+
+    bool operator==(const BandLevel& o) const {
+        return bid_price == o.bid_price && bid_qty == o.bid_qty && ask_price == o.ask_price &&
+               ask_qty == o.ask_qty;
+    }
+};
+
+// 同一组档位参数的订阅者共用一个 feed：每次合并在前缀和索引上逐档二分，结果与上次相同就不推送。
+// 每条消息都是完整结果，订阅者积压时只保留最新的；节流压下的结果到期后由定时检查补发（flush）。
+// 所有成员受 service 的 subscribers_mutex_ 保护
+class BandFeed {
 public:
-    grpc::Status SubscribeBook(grpc::ServerContext* context,
-                               const aggregator::SubscribeRequest* request,
-                               grpc::ServerWriter<aggregator::BookUpdate>* writer) override;
+    BandFeed(const BandOptions& options, const Instrument& instrument)
+        : options_(options), instrument_(instrument), throttle_(options.min_interval) {}
+
+    const BandOptions& options() const { return options_; }
+    std::vector<BookWriter*>& writers() { return writers_; }
 
-    void add_subscriber(grpc::ServerWriter<aggregator::BookUpdate>* writer);
-    void remove_subscriber(grpc::ServerWriter<aggregator::BookUpdate>* writer);
-    void notify_all(const aggregator::BookUpdate& update);
+    // 合并簿变化后调用（持有该交易对的合并簿锁）
+    void publish(const ConsolidatedBook& book, int64_t origin_ns);
+    // 节流压下的结果已到期，需要按当前簿重算后补发
+    bool due(PublishThrottle::Clock::time_point now) const { return throttle_.due(now); }
+    // 上次推送的消息，新订阅者先收到它；还没推送过返回空
+    EncodedUpdate snapshot() const { return last_; }
 
 private:
-    std::vector<grpc::ServerWriter<aggregator::BookUpdate>*> subscribers_;
-    std::mutex subscribers_mutex_;
+    void compute(const ConsolidatedBook& book);
+    EncodedUpdate encode(int64_t origin_ns) const;
+
+    const BandOptions options_;
+    const Instrument& instrument_;
+    std::vector<BookWriter*> writers_;
+
+    std::vector<BandLevel> bands_;  // 上次推送的结果
+    std::vector<BandLevel> cur_;    // 本次的结果，复用内存
+    PriceTicks best_[2] = {};       // 价格档位的最优买卖价：上次推送的
+    PriceTicks cur_best_[2] = {};   // 本次的，任一边为空时都为 0
+    uint64_t sequence_ = 0;
+    bool published_ = false;
+    PublishThrottle throttle_;
+    EncodedUpdate last_;
 };
 
-class Aggregator {
+// SubscribeBook 走 raw 方法：请求自行反序列化，响应直接写预编码的 ByteBuffer。
+// 对客户端透明，proto 定义和 stub 不变。档位订阅同样走 raw 方法，复用 BookWriter；
+// QueryImpact 是一问一答的小消息，走普通 callback 方法
+class AggregatorServiceImpl final
+    : public aggregator::AggregatorService::WithRawCallbackMethod_SubscribeBook<
+          aggregator::AggregatorService::WithRawCallbackMethod_SubscribeVolumeBands<
+              aggregator::AggregatorService::WithRawCallbackMethod_SubscribePriceBands<
+                  aggregator::AggregatorService::WithCallbackMethod_QueryImpact<
+                      aggregator::AggregatorService::Service>>>> {
 public:
-    Aggregator();
+    grpc::ServerWriteReactor<grpc::ByteBuffer>* SubscribeBook(
+        grpc::CallbackServerContext* context,
+        const grpc::ByteBuffer* request) override;
+    grpc::ServerWriteReactor<grpc::ByteBuffer>* SubscribeVolumeBands(
+        grpc::CallbackServerContext* context,
+        const grpc::ByteBuffer* request) override;
+    grpc::ServerWriteReactor<grpc::ByteBuffer>* SubscribePriceBands(
+        grpc::CallbackServerContext* context,
+        const grpc::ByteBuffer* request) override;
+    // 在调用线程里持合并簿锁 refresh 索引后二分，不经过合并线程
+    grpc::ServerUnaryReactor* QueryImpact(
+        grpc::CallbackServerContext* context,
+        const aggregator::ImpactRequest* request,
+        aggregator::ImpactResponse* response) override;
+
+    // 启动前设置可订阅的交易对，下标即交易对编号
+    void set_instruments(const std::vector<Instrument>* instruments,
+                         std::chrono::milliseconds snapshot_interval);
+    // 启动前设置各交易对的合并簿（与 instruments 同下标），QueryImpact 直接读
+    void set_books(const std::vector<std::unique_ptr<ConsolidatedBook>>* books) { books_ = books; }
+
+    void add_subscriber(BookWriter* writer, const FeedOptions& options);
+    void add_subscriber(BookWriter* writer, const BandOptions& options);
+    void remove_subscriber(BookWriter* writer);
+    // 所有订阅（含已关闭的）的合计；by_peer 按 peer 汇总当前还开着的订阅（同一连接上可有多个流）
+    SubscriberStats subscriber_stats(std::map<std::string, SubscriberStats>& by_peer) const;
+    // 该交易对有档位订阅，合并后需要重建前缀和索引
+    bool wants_depth(size_t instrument) const {
+        return band_users_[instrument].load(std::memory_order_relaxed) > 0;
+    }
+    // 合并簿变化后调用，由各 feed 决定推送内容
+    void publish(size_t instrument, const ConsolidatedBook& book, int64_t origin_ns = 0);
+    // 合并簿没有变化时调用（合并线程的定时检查）：只让节流压下、已到期的 feed 补发一次
+    void flush(size_t instrument, const ConsolidatedBook& book);
+
+    // 写完成时的延迟统计，启动前设置；为空时不统计
+    void set_latency(LatencyMetrics* latency) { latency_ = latency; }
+    LatencyMetrics* latency() const { return latency_; }
+
+private:
+    // symbol 为空时取第一个交易对
+    grpc::Status find_instrument(const std::string& symbol, size_t& instrument) const;
+
+    LatencyMetrics* latency_ = nullptr;
+    const std::vector<Instrument>* instruments_ = nullptr;
+    const std::vector<std::unique_ptr<ConsolidatedBook>>* books_ = nullptr;
+    std::chrono::milliseconds snapshot_interval_{5000};
+    std::vector<std::vector<std::unique_ptr<BookFeed>>> feeds_;  // 按交易对分组
+    std::vector<std::vector<std::unique_ptr<BandFeed>>> band_feeds_;
+    std::unique_ptr<std::atomic<int>[]> band_users_;  // 各交易对的档位 feed 数，合并线程无锁读取
+    SubscriberStats closed_stats_;  // 已关闭的订阅的合计
+    mutable std::mutex subscribers_mutex_;
+};
+
+class Aggregator : public BookListener {
+public:
+    Aggregator();  // 配置见 load_config()
     ~Aggregator();
 
     void run_server();
 
 
-    void on_book_updated(Connector* connector);
+    // connector 的 inst 号交易对有新变化：只标记，合并由 merge_scheduler_ 统一调度
+    void on_book_updated(Connector* connector, size_t inst) override;
+    // connector 断线：标记其所有交易对，让合并线程立即把它排除
+    void on_feed_down(Connector* connector) override;
+    void on_book_down(Connector* connector, size_t inst) override;
 private:  
-    void merge_books();
+    explicit Aggregator(AggregatorConfig config);
+
+    // 合并线程调用：取走 venues 中各交易所的变化，合并后推送一次。
+    // venues 为 0 是定时检查，只在有交易所被排除或恢复时推送
+    void merge(size_t inst, uint32_t venues);
+    aggregator::BookUpdate build_update(size_t inst) const;
+    void verify_consolidated(size_t inst);
+    // /metrics 的内容：各段延迟分布、合并计数和订阅积压
+    std::string render_metrics() const;
+
+    // 配置的交易对，构造后不再变化，connector 持有其引用
+    std::vector<Instrument> instruments_;
+    std::vector<std::unique_ptr<ConsolidatedBook>> books_;  // 按交易对下标
+
+    // connector 的 IO 线程池，需先于 connector 构造、晚于其析构
+    std::unique_ptr<IoPool> io_pool_;
+
+    // 启用的交易所，按配置顺序；合并、校验、指标只遍历这些
+    std::vector<std::unique_ptr<Connector>> connectors_;
+    Connector* by_venue_[kVenueCount] = {};  // 按 Venue 下标，未启用的为空
+
+    std::unique_ptr<MergeScheduler> merge_scheduler_;
+    std::unique_ptr<ReplayConnector> replay_;  // AGG_REPLAY 设置时代替网络连接
 
-    std::unique_ptr<BinanceConnector> binance_;
-    std::unique_ptr<OKXConnector> okx_;
-    std::unique_ptr<BitgetConnector> bitget_;
-    std::unique_ptr<BybitConnector> bybit_;
+    bool verify_merge_{false};  // AGG_VERIFY_MERGE=1：每次更新与全量合并结果比对
+    std::vector<LevelChange> venue_levels_;  // exclude_venue / include_venue 的暂存，只在合并线程使用
+    std::atomic<uint64_t> exclusions_[kVenueCount] = {};  // 交易所的某个交易对被排除的次数
 
-    std::map<double, double, std::greater<double>> consolidated_bids_;
-    std::map<double, double> consolidated_asks_;
-    std::mutex consolidated_mutex_;
+    LatencyMetrics latency_;
+    std::unique_ptr<MetricsServer> metrics_server_;  // AGG_METRICS_PORT，0 表示不开
 
     AggregatorServiceImpl service_;
     std::unique_ptr<grpc::Server> grpc_server_;
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "fixed_point.h"
+#include "flat_book.h"
+
+// 交易所本地簿的一边：离本边最优价 kBandTicks 以内的价位放在稠密 FlatBook 里，
+// 更远的放在按价格排好序的稀疏数组里。只有稠密部分对外可见（遍历、find、发布给合并端的变化），
+// 全深度里的远端挂单不会把 FlatBook 的窗口撑大。
+// 最优价变好时，落到带外的稠密价位移到稀疏数组（对外为删除）；最优价变差时，
+// 进入带内的稀疏价位移回稠密部分（对外为新增）。
+// IsBid = true 时从高价往低价遍历，否则从低价往高价
+template <bool IsBid>
+class BandedBook {
+public:
+    static constexpr PriceTicks kBandTicks = PriceTicks(1) << 14;
+    static_assert(2 * kBandTicks < FlatBook<Quantity, IsBid>::kMaxSpan, "band must fit the dense window");
+
+    using const_iterator = typename FlatBook<Quantity, IsBid>::const_iterator;
+
+    // 以下只涉及稠密部分
+    const_iterator begin() const { return dense_.begin(); }
+    const_iterator end() const { return dense_.end(); }
+    const_iterator from(PriceTicks price) const { return dense_.from(price); }
+    size_t size() const { return dense_.size(); }
+    bool empty() const { return dense_.empty(); }
+    PriceTicks best_price() const { return dense_.best_price(); }
+    PriceTicks worst_price() const { return dense_.worst_price(); }
+    const Quantity* find(PriceTicks price) const { return dense_.find(price); }
+
+    // 带外的价位数
+    size_t far_size() const { return far_.size(); }
+
+    // price 上的数量（含带外），没有为 0
+    Quantity get(PriceTicks price) const {
+        if (const Quantity* qty = dense_.find(price)) return *qty;
+        auto it = far_lower_bound(price);
+        return it != far_.end() && it->first == price ? it->second : 0;
+    }
+
+    // 设置 price 的数量（0 删除）。稠密部分每个真正变化的价位调用一次 on_change(price, qty)，
+    // 包括因最优价移动而移出（qty 为 0）、移入带内的价位
+    template <typename Fn>
+    void set(PriceTicks price, Quantity qty, Fn&& on_change) {
+        if (qty > 0) insert(price, qty, on_change);
+        else remove(price, on_change);
+    }
+    void set(PriceTicks price, Quantity qty) { set(price, qty, [](PriceTicks, Quantity) {}); }
+    // 快照暂存用：落到同一 tick 的多档数量累加
+    void add(PriceTicks price, Quantity qty) { set(price, get(price) + qty); }
+
+    void clear() {
+        dense_.clear();
+        far_.clear();
+    }
+
+    void swap(BandedBook& other) {
+        std::swap(dense_, other.dense_);
+        far_.swap(other.far_);
+    }
+
+private:
+    using Far = std::vector<std::pair<PriceTicks, Quantity>>;
+
+    // a 比 b 离盘口远
+    static bool worse(PriceTicks a, PriceTicks b) { return IsBid ? a < b : a > b; }
+    static bool in_band(PriceTicks price, PriceTicks best) {
+        return (IsBid ? best - price : price - best) <= kBandTicks;
+    }
+
+    // far_ 从最差价排到最优价，最优价在末尾：移出 / 移回都发生在末尾
+    typename Far::const_iterator far_lower_bound(PriceTicks price) const {
+        return std::lower_bound(far_.begin(), far_.end(), price,
+                                [](const auto& level, PriceTicks p) { return worse(level.first, p); });
+    }
+    typename Far::iterator far_lower_bound(PriceTicks price) {
+        return std::lower_bound(far_.begin(), far_.end(), price,
+                                [](const auto& level, PriceTicks p) { return worse(level.first, p); });
+    }
+
+    template <typename Fn>
+    void insert(PriceTicks price, Quantity qty, Fn& on_change) {
+        if (!dense_.empty() && !worse(price, dense_.best_price())) {
+            // 新的最优价：先把落到带外的移走，稠密窗口不会跨过整个带
+            while (!dense_.empty() && !in_band(dense_.worst_price(), price)) {
+                const PriceTicks evicted = dense_.worst_price();
+                far_.emplace_back(evicted, *dense_.find(evicted));
+                dense_.erase(evicted);
+                on_change(evicted, Quantity(0));
+            }
+        } else if (!dense_.empty() && !in_band(price, dense_.best_price())) {
+            auto it = far_lower_bound(price);
+            if (it != far_.end() && it->first == price) it->second = qty;
+            else far_.insert(it, {price, qty});
+            return;
+        }
+        // 稠密部分为空时稀疏部分也为空：删掉最后一个稠密价位时 remove 会把稀疏价位移回来
+        Quantity& current = dense_[price];
+        if (current == qty) return;
+        current = qty;
+        on_change(price, qty);
+    }
+
+    template <typename Fn>
+    void remove(PriceTicks price, Fn& on_change) {
+        if (!dense_.find(price)) {
+            auto it = far_lower_bound(price);
+            if (it != far_.end() && it->first == price) far_.erase(it);
+            return;
+        }
+        const bool was_best = dense_.best_price() == price;
+        dense_.erase(price);
+        on_change(price, Quantity(0));
+        if (was_best && !far_.empty()) promote(dense_.empty() ? far_.back().first : dense_.best_price(), on_change);
+    }
+
+    // 把离 best 在带内的稀疏价位移回稠密部分
+    template <typename Fn>
+    void promote(PriceTicks best, Fn& on_change) {
+        while (!far_.empty() && in_band(far_.back().first, best)) {
+            const auto [price, qty] = far_.back();
+            far_.pop_back();
+            dense_[price] = qty;
+            on_change(price, qty);
+        }
+    }
+
+    FlatBook<Quantity, IsBid> dense_;
+    Far far_;
+};
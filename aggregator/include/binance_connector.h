@@ -4,18 +4,49 @@
 
 class BinanceConnector : public Connector {
 public:
-    explicit BinanceConnector(Aggregator* aggregator);  
+    BinanceConnector(BookListener* aggregator, net::io_context& ioc, const std::vector<Instrument>& instruments);
 protected:
     std::string host() const override { return "stream.binance.com"; }
     std::string port() const override { return "9443"; }
-    std::string path() const override { return "/ws"; }
-    std::string subscribe_message() const override {
-        return R"({"method":"SUBSCRIBE","params":["btcusdt@depth20@100ms"],"id":1})";
+    std::string path() const override { return "/stream"; }  // 组合流：每条推送带 stream 名，用来区分交易对
+    std::string rest_host() const override { return "api.binance.com"; }
+    // 全深度用 @depth 增量流，配合 REST 快照建簿；否则用 20 档分档快照
+    std::vector<std::string> subscribe_messages() const override {
+        std::string params;
+        for (const auto& s : subscribed_symbols()) {
+            if (!params.empty()) params += ',';
+            params += '"' + s + (full_depth_ ? "@depth@100ms\"" : "@depth20@100ms\"");
+        }
+        return {R"({"method":"SUBSCRIBE","params":[)" + params + R"(],"id":1})"};
         // return R"({"method":"SUBSCRIBE","params":["btcusdt@depth5@100ms"],"id":1})";
         // return R"({"method":"SUBSCRIBE","params":["btcusdt@depth20@100ms"],"id":1})";
         // 如果想 5 檔測試：R"({"method":"SUBSCRIBE","params":["btcusdt@depth5@100ms"],"id":1})"
     }
 
-    void parse_message(const std::string& msg) override;
+    void parse_message(std::string_view msg) override;
     bool needs_ping() const override { return false; }  // <--- Binance 不需要 ping
+    void on_session_start() override;
+private:
+    bool parse_fast(std::string_view msg);
+
+    // 全深度同步（Binance 文档的本地簿维护流程）：未同步时缓存增量并拉 REST 快照，
+    // 快照包装成 <symbol>@rest 帧走正常解析（因此也会被录制，回放时照样能建簿），
+    // 之后丢弃 u <= lastUpdateId 的增量，第一条需满足 U <= lastUpdateId + 1 <= u，此后 U 必须接上一条 u + 1。
+    // 返回 false 表示档位格式不对
+    bool on_snapshot(size_t inst, std::string_view msg, std::string_view bids, std::string_view asks);
+    bool on_diff(size_t inst, std::string_view msg, uint64_t first_id, uint64_t last_id,
+                 std::string_view bids, std::string_view asks);
+    void request_snapshot(size_t inst);
+
+    static constexpr int kSnapshotLimit = 1000;     // REST 快照档数（权重 50）
+    static constexpr size_t kMaxBuffered = 1000;    // 等快照时最多缓存的增量条数
+    static constexpr std::chrono::seconds kSnapshotRetry{1};  // 同一交易对两次拉快照的最小间隔
+
+    struct DiffSync {
+        std::vector<std::string> buffered;  // 快照到达前收到的增量（原始帧）
+        bool pending = false;               // 快照请求在途
+        std::chrono::steady_clock::time_point next_request{};
+    };
+    std::vector<DiffSync> sync_;    // 按交易对下标，只在 strand 上访问
+    uint64_t sync_generation_ = 0;  // 每次重连加一，旧连接发出的快照请求回来后丢弃
 };
\ No newline at end of file
@@ -4,18 +4,37 @@
 
 class BitgetConnector : public Connector {
 public:
-    explicit BitgetConnector(Aggregator* aggregator);
+    BitgetConnector(BookListener* aggregator, net::io_context& ioc, const std::vector<Instrument>& instruments);
 protected:
     std::string host() const override { return "ws.bitget.com"; }
     std::string port() const override { return "443"; }
     std::string path() const override { return "/v2/ws/public"; }  // V2 公共端點
-    std::string subscribe_message() const override {
+    std::vector<std::string> subscribe_messages() const override {
         // return R"({"op":"subscribe","args":[{"instType":"SPOT","channel":"ticker","instId":"BTCUSDT"}]})";  // 永續合約 50 檔
-        return R"({"op":"subscribe","args":[{"instType":"SPOT","channel":"books50","instId":"BTCUSDT"}]})";  // <--- 改成 books50
+        std::string args;
+        for (const auto& s : subscribed_symbols()) {
+            if (!args.empty()) args += ',';
+            args += book_arg(s);
+        }
+        return {R"({"op":"subscribe","args":[)" + args + "]}"};
         // 如果想 15 檔： "channel":"books15"
         // 如果想增量更新： "channel":"books"
         //public md only level one
     }
 
-    void parse_message(const std::string& msg) override;
+    void parse_message(std::string_view msg) override;
+private:
+    bool parse_fast(std::string_view msg);
+
+    // 全深度用 books 频道（先推 snapshot 再推 update），否则用 books50 分档快照
+    std::string book_arg(const std::string& inst_id) const {
+        return std::string(R"({"instType":"SPOT","channel":")") + (full_depth_ ? "books" : "books50") +
+               R"(","instId":")" + inst_id + R"("})";
+    }
+    // books 频道：Bitget 的 seq 只保证递增、不保证连续，漏掉的增量靠校验和发现：
+    // update 的 seq 不大于上一条（乱序）或应用后前 25 档校验和不一致时，退订再订阅该交易对取新快照。
+    // 返回 false 表示档位格式不对
+    bool on_books(size_t inst, std::string_view action, std::string_view data, std::string_view bids,
+                  std::string_view asks);
+    void resubscribe(size_t inst);
 };
\ No newline at end of file
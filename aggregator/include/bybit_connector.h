@@ -5,15 +5,34 @@
 
 class BybitConnector : public Connector {
 public:
-    explicit BybitConnector(Aggregator* aggregator);
+    BybitConnector(BookListener* aggregator, net::io_context& ioc, const std::vector<Instrument>& instruments);
 
 protected:
     std::string host() const override { return "stream.bybit.com"; }
     std::string port() const override { return "443"; }
     std::string path() const override { return "/v5/public/spot"; }
-    std::string subscribe_message() const override {
-        return R"({"op":"subscribe","args":["orderbook.50.BTCUSDT"]})";  // top 50 档（snapshot + incremental）
+    // top 50 档（snapshot + incremental）。现货一条订阅最多 10 个 topic，超出时拆成多条
+    std::vector<std::string> subscribe_messages() const override {
+        std::vector<std::string> out;
+        const std::vector<std::string> symbols = subscribed_symbols();
+        for (size_t i = 0; i < symbols.size(); i += 10) {
+            std::string args;
+            for (size_t k = i; k < symbols.size() && k < i + 10; ++k) {
+                if (!args.empty()) args += ',';
+                args += "\"orderbook.50." + symbols[k] + '"';
+            }
+            out.push_back(R"({"op":"subscribe","args":[)" + args + "]}");
+        }
+        return out;
     }
 
-    void parse_message(const std::string& msg) override;
+    void parse_message(std::string_view msg) override;
+private:
+    bool parse_fast(std::string_view msg);
+
+    // orderbook 推送（两条解析路径共用）：snapshot 重建原始价格簿；delta 的 u 必须比上一条大，
+    // 否则按断档处理。档位格式不对时本地簿已改了一半，同样退出合并、退订再订阅该交易对取新快照
+    void on_orderbook(size_t inst, std::string_view type, std::string_view msg, std::string_view bids,
+                      std::string_view asks);
+    void resubscribe(size_t inst);
 };
\ No newline at end of file
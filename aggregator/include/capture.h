@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// 行情录制文件格式（小端，8 字节对齐）：
+//   CaptureFileHeader
+//   { CaptureRecord, payload[length], 补齐到 8 字节 } ...
+// 文件按固定大小预分配并 mmap 追加写，length 为 0 的记录头表示数据结束；
+// 正常轮转/关闭时文件截断到实际长度。
+struct CaptureFileHeader {
+    char magic[8];         // "AGGCAP\0\0"
+    uint32_t version;
+    uint32_t header_size;  // sizeof(CaptureFileHeader)
+};
+
+struct CaptureRecord {
+    int64_t recv_ns;   // 收到帧时的 system_clock 纳秒
+    uint32_t length;   // payload 字节数
+    uint8_t venue;     // Venue
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(CaptureFileHeader) == 16 && sizeof(CaptureRecord) == 16, "capture layout");
+
+constexpr char kCaptureMagic[8] = {'A', 'G', 'G', 'C', 'A', 'P', 0, 0};
+constexpr uint32_t kCaptureVersion = 1;
+
+// 单个 connector 的录制文件，只在该 connector 的 strand 上调用，不加锁。
+// 文件写满后轮转到 <dir>/<prefix>-<启动秒数>-<序号>.cap
+class CaptureWriter {
+public:
+    CaptureWriter(std::string dir, std::string prefix, size_t file_bytes);
+    ~CaptureWriter();
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    // 追加一帧；打开/映射文件失败时打印错误并停止录制，不影响行情处理
+    void append(uint8_t venue, int64_t recv_ns, std::string_view frame);
+
+    uint64_t frames() const { return frames_; }
+
+private:
+    bool open_next(size_t min_bytes);
+    void close_current();
+
+    const std::string dir_;
+    const std::string prefix_;
+    const size_t file_bytes_;
+    const int64_t started_;  // 文件名里的启动时间（秒）
+    int index_ = 0;
+
+    int fd_ = -1;
+    char* map_ = nullptr;
+    size_t size_ = 0;  // 映射长度
+    size_t pos_ = 0;   // 下一条记录的偏移
+    bool failed_ = false;
+    uint64_t frames_ = 0;
+};
+
+// 只读映射一个录制文件，顺序遍历其中的帧
+class CaptureReader {
+public:
+    explicit CaptureReader(const std::string& path);  // 打不开或格式不对抛 std::runtime_error
+    ~CaptureReader();
+
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+
+    // 取下一帧，payload 指向映射内存，在 reader 析构前有效；读完返回 false
+    bool next(CaptureRecord& record, std::string_view& payload);
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+    int fd_ = -1;
+    const char* map_ = nullptr;
+    size_t size_ = 0;
+    size_t pos_ = 0;
+};
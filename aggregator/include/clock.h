@@ -0,0 +1,16 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// 单调时钟纳秒，用于各阶段打点（与 system_clock 无关，只能在本进程内相减）
+inline int64_t mono_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Unix 纳秒，对外发布和录制用的收到时间
+inline int64_t unix_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
@@ -7,14 +7,32 @@
 #include <boost/asio/connect.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
 // #include <nlohmann/json.hpp>
+#include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <functional>
 #include <chrono>
 #include <thread>
 #include <cmath>
+#include <vector>
+#include <deque>
+#include <string_view>
+#include <cstring>
+#include <random>
+
+#include "fixed_point.h"
+#include "banded_book.h"
+#include "flat_book.h"
+#include "raw_book.h"
+#include "spsc_queue.h"
+#include "capture.h"
+#include "clock.h"
+#include "rest_client.h"
 
 namespace beast = boost::beast;
 namespace websocket = beast::websocket;
@@ -23,72 +41,347 @@ namespace ssl = boost::asio::ssl;
 using tcp = net::ip::tcp;
 // using json = nlohmann::json;
 
-class Aggregator;
+class Connector;
+
+// connector 向合并端的通知，由 Aggregator 实现（tests/ 里换成在当前线程直接合并的实现）。
+// 都在 connector 的 strand（回放时为回放线程）上调用
+class BookListener {
+public:
+    virtual ~BookListener() = default;
+    // inst 号交易对有新变化，由实现方调用 publish_changes 交出
+    virtual void on_book_updated(Connector* connector, size_t inst) = 0;
+    // 连接断开：所有交易对都应立即退出合并
+    virtual void on_feed_down(Connector* connector) = 0;
+    // inst 号交易对的本地簿不再可信（序号断档、坏档位、校验和不一致）：该交易对应立即退出合并，
+    // 重新按快照建簿后随下一次 on_book_updated 加回
+    virtual void on_book_down(Connector* connector, size_t inst) = 0;
+};
+
+// 交易所编号，顺序即合并时的累加顺序
+enum Venue : int { kBinance = 0, kOKX, kBitget, kBybit, kVenueCount };
+
+// 对外（proto、指标标签）使用的交易所名称
+inline const char* venue_label(int venue) {
+    static const char* const kLabels[kVenueCount] = {"binance", "okx", "bitget", "bybit"};
+    return kLabels[venue];
+}
+
+// 本地簿单个价位的变化，qty 为变化后的数量（0 表示删除）
+struct LevelChange {
+    bool is_bid;
+    PriceTicks price;
+    Quantity qty;
+};
+
+using BidBook = FlatBook<Quantity, true>;
+using AskBook = FlatBook<Quantity, false>;
+// 交易所本地簿：盘口附近稠密，远端稀疏，只有稠密部分参与合并（见 banded_book.h）
+using VenueBids = BandedBook<true>;
+using VenueAsks = BandedBook<false>;
+
+// 交易对：symbol 为对外统一名称（BTCUSDT），tick_size 为合并簿的价格粒度。
+// 由 make_instrument 构造，tick_units 是校验过的 tick_size 的 1e-8 整数表示，价格换算都用它
+struct Instrument {
+    std::string symbol;
+    std::string base;   // BTC
+    std::string quote;  // USDT
+    double tick_size = 0;
+    int64_t tick_units = 0;
+};
+
+// 配置文件里一个交易所的设置（见 venue_registry.h），空字段保持内置默认
+struct VenueConfig {
+    Venue venue;
+    std::string url;       // ws[s]://host[:port][/path]
+    std::string rest_url;  // http[s]://host[:port]
+    int full_depth = -1;   // 1 全深度增量频道，0 分档快照频道，-1 不指定（AGG_FULL_DEPTH，默认全深度）
+    std::vector<std::string> symbols;  // 只订阅这些交易对（BTCUSDT 形式），空表示全部
+    int64_t stale_ms = -1;         // 见 AGG_STALE_MS，-1 不指定
+    int64_t read_timeout_ms = -1;  // 见 AGG_READ_TIMEOUT_MS，-1 不指定
+};
+
+// 交易所推送里的事件时间和序号，以及本地收到该帧的时间，随变化一起交给合并线程
+struct VenueStamp {
+    int64_t event_ms = 0;      // 交易所事件时间（Unix 毫秒），推送里没有时为 0
+    int64_t recv_unix_ns = 0;  // 收到该帧的时间（Unix 纳秒），0 表示还没收到过
+    uint64_t sequence = 0;     // 交易所的序号（lastUpdateId / seqId / seq / u），没有时为 0
+};
+
+// 一条消息（队列满时为连续几条）产生的变化，带打点时间（mono_ns）
+struct ChangeBatch {
+    std::vector<LevelChange> changes;
+    int64_t recv_ns = 0;    // 其中最早一帧的收到时间
+    int64_t parsed_ns = 0;  // 交给合并线程的时间
+    VenueStamp stamp;       // 其中最后一条消息的时间和序号
+};
+
+// connector 线程到合并线程的无锁交接：每条消息的变化整批入 ready，
+// 合并线程用完的空 vector 经 spare 还回来复用容量，稳态下不分配内存
+struct ChangeHandoff {
+    static constexpr size_t kBatches = 256;
+    SpscQueue<ChangeBatch, kBatches> ready;                // connector -> 合并线程
+    SpscQueue<std::vector<LevelChange>, kBatches> spare;  // 合并线程 -> connector
+    // 最近一条交出变化的消息的收到时间（mono_ns）；0 表示未同步（断线、断档后还没有新的快照或消息），
+    // 合并线程据此排除。是否过期看连接的最近一帧，不看它（见 Connector::live）
+    std::atomic<int64_t> live_ns{0};
+};
+
+// 一个交易所上某个交易对的本地簿，下标与 Aggregator 的 instruments_ 一致
+struct VenueBook {
+    VenueBids bids;
+    VenueAsks asks;
+    std::vector<LevelChange> changes;  // 尚未交出的价位变化，受 book_mutex_ 保护
+    int64_t changes_recv_ns = 0;       // changes 中最早一帧的收到时间，0 表示没有
+    VenueStamp stamp;                  // 最近一条消息的时间和序号，受 book_mutex_ 保护
+    std::unique_ptr<ChangeHandoff> handoff = std::make_unique<ChangeHandoff>();
+    int64_t tick_units;                // tick_size 的 1e-8 整数表示
+
+    // 增量频道用，只在 connector 线程访问：交易所原始价格（1e-8 单位）-> 数量和原文。
+    // 推送按原始价位给绝对数量，多个原始价位落到同一 tick 时 bids/asks 上是它们之和。
+    // 最优价在末尾，校验和取前 25 档时从尾部遍历
+    RawSide<true> raw_bids;
+    RawSide<false> raw_asks;
+    bool synced = false;    // 已按快照建簿且之后的序号连续
+    uint64_t last_seq = 0;  // 最后应用的交易所序号
+};
 
 class Connector {
 public:
     // Connector();
-    Connector(Aggregator* aggregator, const std::string& name, double tick_size);
+    // 所有 IO 都在 ioc 上的一个 strand 里异步执行；销毁前需先停止 ioc
+    Connector(BookListener* aggregator, net::io_context& ioc, const std::string& name, Venue venue,
+              const std::vector<Instrument>& instruments);
     virtual ~Connector();
 
+    // start() 之前调用，应用配置文件里的设置；对应的环境变量设置时仍以环境变量为准
+    void configure(const VenueConfig& config);
     void start();
-    void print_book() const;
-    std::map<double, double, std::greater<double>> get_bids_snapshot() const {
-        std::lock_guard<std::mutex> lock(book_mutex_);
-        return local_bids_;  // copy 返回
+    // 增量频道序号断档后重新同步的次数
+    uint64_t resyncs() const { return resyncs_.load(std::memory_order_relaxed); }
+    // 其中由校验和不一致触发的次数
+    uint64_t checksum_failures() const { return checksum_failures_.load(std::memory_order_relaxed); }
+    // 收到的帧数和最近一帧的收到时间（mono_ns，0 表示还没收到），指标用
+    uint64_t frames() const { return frames_.load(std::memory_order_relaxed); }
+    int64_t last_frame_ns() const { return last_frame_ns_.load(std::memory_order_relaxed); }
+    // 读超时断开的次数、安排重连的次数
+    uint64_t read_timeouts() const { return read_timeouts_.load(std::memory_order_relaxed); }
+    uint64_t reconnects() const { return reconnects_.load(std::memory_order_relaxed); }
+    // 合并线程调用：inst 号交易对在 now_ns 时是否参与合并。未同步（连接断开或断档后、下一条消息之前）时为 false；
+    // 连接上最近一帧（含 pong）早于 AGG_STALE_MS 时也为 false。只看连接，不看该交易对自己的消息：
+    // 盘口安静的交易对只要连接还在收数据就一直参与合并
+    bool live(size_t inst, int64_t now_ns) const {
+        if (books_[inst].handoff->live_ns.load(std::memory_order_relaxed) == 0) return false;
+        return stale_ns_ == 0 || now_ns - last_frame_ns() <= stale_ns_;
     }
-    std::map<double, double> get_asks_snapshot() const {
-        std::lock_guard<std::mutex> lock(book_mutex_);
-        return local_asks_;
+    // 回放用：不经网络直接解析一帧，调用方需保证 connector 未启动（不与 strand 并发）。
+    // recv_unix_ns 为录制时的收到时间
+    void replay_frame(std::string_view msg, int64_t recv_unix_ns) {
+        frame_recv_ns_ = mono_ns();
+        frame_recv_unix_ns_ = recv_unix_ns;
+        frames_.store(frames_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        last_frame_ns_.store(frame_recv_ns_, std::memory_order_relaxed);  // live() 按它判断过期
+        parse_message(msg);
     }
-    inline double standardize_price(double raw_price, double tick_size,bool is_bid) const {
-        if (tick_size <= 0.0) return raw_price;  // 防除零
-        if(is_bid){
-            return int(raw_price/tick_size)*tick_size;
-        } else {
-            if(raw_price > int(raw_price / tick_size) * tick_size){
-                return (int(raw_price/tick_size) + 1) * tick_size;
-            }
-            else{
-                return raw_price;
-            }
+    void print_book(size_t inst) const;
+    // connector 线程调用：把本条消息累积的变化整批交给合并线程。
+    // ready 满（合并线程落后 kBatches 批）时留在 changes 里，随下一条消息一起交出
+    void publish_changes(size_t inst);
+    // 合并线程调用，不加锁、不拷贝：按到达顺序对每批变化调用 fn(const ChangeBatch&)
+    template <typename Fn>
+    void drain_changes(size_t inst, Fn&& fn) {
+        ChangeHandoff& h = *books_[inst].handoff;
+        ChangeBatch batch;
+        while (h.ready.pop(batch)) {
+            fn(static_cast<const ChangeBatch&>(batch));
+            batch.changes.clear();
+            h.spare.push(std::move(batch.changes));  // spare 满时直接释放
         }
     }
+    // 原始价格字符串 -> tick 编号：买价向下、卖价向上取整到 tick。格式不合法返回 false
+    inline bool to_ticks(size_t inst, std::string_view raw_price, bool is_bid, PriceTicks& ticks) const {
+        int64_t raw = 0;
+        if (!parse_decimal(raw_price, kDecimals, raw)) return false;
+        const int64_t units = books_[inst].tick_units;
+        ticks = is_bid ? raw / units : (raw + units - 1) / units;
+        return true;
+    }
+    inline PriceTicks to_ticks(size_t inst, std::string_view raw_price, bool is_bid) const {
+        PriceTicks ticks = 0;
+        if (!to_ticks(inst, raw_price, is_bid, ticks)) throw std::invalid_argument("bad price");
+        return ticks;
+    }
+    // 快速解析路径用：一档价格/数量，不抛异常
+    inline bool parse_level(size_t inst, std::string_view raw_price, std::string_view raw_qty,
+                            bool is_bid, PriceTicks& price, Quantity& qty) const {
+        return to_ticks(inst, raw_price, is_bid, price) && parse_decimal(raw_qty, kDecimals, qty);
+    }
     // connector.h (class Connector protected 或全局)
     
-    Aggregator* aggregator_{nullptr};  // 新增
+    BookListener* aggregator_{nullptr};  // 新增
     std::string name_;  // ← public
-    std::map<double, double, std::greater<double>> local_bids_;  // public
-    std::map<double, double> local_asks_;  // public
+    Venue venue_;
+    const std::vector<Instrument>& instruments_;
+    std::vector<VenueBook> books_;  // 按交易对下标，受 book_mutex_ 保护
     mutable std::mutex book_mutex_;
 protected:
+    // 交易所推送里的交易对名称 -> 交易对下标，未订阅的返回 false
+    bool find_instrument(std::string_view venue_symbol, size_t& inst) const;
+
+    // 以下三个函数修改本地簿并记录变化，调用方需持有 book_mutex_
+    // 从帧里取事件时间（毫秒）和序号字段记到本地簿（连同收到时间），字段缺失的记 0
+    void set_stamp(size_t inst, std::string_view msg, std::string_view time_key, std::string_view seq_key);
+    void set_level(size_t inst, bool is_bid, PriceTicks price, Quantity qty);
+    // 用 snapshot_bids_/snapshot_asks_ 中解析好的快照替换本地簿
+    void replace_book(size_t inst);
+
+    // 快速解析路径：把 [["p","q",...],...] 直接写进快照暂存簿，格式不对返回 false。
+    // accumulate 为 true 时落到同一 tick 的多档数量累加，否则覆盖
+    bool fill_snapshot_side(size_t inst, std::string_view levels, bool is_bid, bool accumulate);
+
+    // 增量频道（全深度）：快照重建原始价格簿并按 tick 累加进快照暂存簿，之后 replace_book；
+    // 增量按原始价位更新，差值落到所在 tick。离最优价较远的价位留在本地簿的稀疏部分，不参与合并
+    void clear_raw(size_t inst);
+    bool add_raw_snapshot_level(size_t inst, bool is_bid, std::string_view p, std::string_view q);
+    bool apply_raw_level(size_t inst, bool is_bid, std::string_view p, std::string_view q);  // 需持有 book_mutex_
+    bool fill_raw_snapshot_side(size_t inst, std::string_view levels, bool is_bid);
+    bool apply_raw_delta_side(size_t inst, std::string_view levels, bool is_bid);  // 需持有 book_mutex_
+    // 快照 + 增量频道的通用部分，序号检查由子类先做。stamp_src 中取事件时间和序号（见 set_stamp）。
+    // 快照：重建原始价格簿、替换本地簿、标记已同步；增量：按原始价位应用。返回 false 表示档位格式不对
+    bool apply_book_snapshot(size_t inst, std::string_view stamp_src, std::string_view time_key,
+                             std::string_view seq_key, std::string_view bids, std::string_view asks);
+    bool apply_book_update(size_t inst, std::string_view stamp_src, std::string_view time_key,
+                           std::string_view seq_key, std::string_view bids, std::string_view asks);
+    // OKX / Bitget 的深度校验和：前 25 档 bid、ask 交替拼成 "价:量:价:量..."（一边不足时只接另一边），
+    // 取 CRC-32 按有符号 32 位比较。拼接用栈上缓冲区，不分配。
+    // 返回 false 表示不一致；前 25 档有超长原文无法计算时跳过校验，返回 true
+    static constexpr int kChecksumLevels = 25;
+    bool verify_checksum(size_t inst, int64_t expected);
+    // 应用一条快照 / 增量后调用：msg 里有 checksum 字段且校验开启时验证，不一致则标记未同步并返回 false
+    bool checksum_ok(size_t inst, std::string_view msg);
+    // 标记未同步、计数并打日志，本地簿立即退出合并（同断线），由子类决定如何重新取快照
+    void mark_unsynced(size_t inst, const std::string& why);
+    void mark_gap(size_t inst, uint64_t expected, uint64_t got);
+
+    // 连接建立、发订阅之前调用（各簿已标记未同步）：旧连接上的序号作废，增量频道需从新快照开始
+    virtual void on_session_start() {}
+    // 正在连交易所（不是回放），只有这时才能发消息、拉 REST 快照
+    bool running() const { return running_; }
+    // Beast 同一时刻只允许一个写操作，订阅和 ping 都经过这个队列；只能在 strand 上调用
+    void send(std::string msg);
+    // REST 请求（如 Binance 深度快照），地址默认 rest_host()/rest_port()，
+    // 可用 AGG_<NAME>_REST_URL=http[s]://host[:port] 覆盖。回调在 strand 上执行
+    virtual std::string rest_host() const { return ""; }
+    virtual std::string rest_port() const { return "443"; }
+    void http_get(const std::string& path, RestCallback done);
+    // 与 WebSocket 收到的帧走同一路径（打点、录制、解析），用于把 REST 快照包装成帧送进解析
+    void handle_frame(std::string_view frame);
+
+    VenueBids snapshot_bids_;  // 快照暂存簿，只在 connector 线程使用，内存复用
+    VenueAsks snapshot_asks_;
+
+    // 各交易对在本交易所的名称（btcusdt / BTC-USDT / BTCUSDT），由子类构造时填写
+    std::vector<std::string> venue_symbols_;
+    std::vector<bool> subscribed_;  // 按交易对下标，配置里没列出的交易对不订阅
+    // 要订阅的交易对的交易所写法，subscribe_messages 用
+    std::vector<std::string> subscribed_symbols() const;
 
     virtual bool needs_ping() const { return true; }  // <--- 默认需要 ping，其他交易所用 true
-    double tick_size_{0.1};
     virtual std::string host() const = 0;
     virtual std::string port() const = 0;
     virtual std::string path() const = 0;
-    virtual std::string subscribe_message() const = 0;
-    virtual void parse_message(const std::string& msg) = 0;
-    // Aggregator* aggregator_{nullptr};  // 新增
+    // 连接后依次发送，一条消息可订阅的频道数受交易所限制时拆成多条
+    virtual std::vector<std::string> subscribe_messages() const = 0;
+    // msg 直接指向读缓冲区，只在本次调用期间有效
+    virtual void parse_message(std::string_view msg) = 0;
+
+    // 忽略空白后判断是否为 pong 回包（深度消息很长，直接跳过）
+    static bool is_pong(std::string_view msg);
 
-    // inline long long price_to_int(double raw_price) const {
-    //     if (tick_size_ <= 0.0) return static_cast<long long>(std::round(raw_price * 100000000.0));  // fallback 高精度
-    //     return static_cast<long long>(std::round(raw_price / tick_size_));
-    // }
+    bool fast_parse_{true};  // AGG_FAST_PARSE=0 时全部走 nlohmann::json
+    bool full_depth_{true};  // AGG_FULL_DEPTH=0 时改回各交易所的分档快照频道
+    bool verify_checksums_{true};  // AGG_VERIFY_CHECKSUM=0 时不验证深度校验和
+    std::atomic<uint64_t> resyncs_{0};
+    std::atomic<uint64_t> checksum_failures_{0};
+    std::atomic<uint64_t> frames_{0};          // 只由 strand 写
+    std::atomic<int64_t> last_frame_ns_{0};    // 同上
+    std::atomic<uint64_t> read_timeouts_{0};
+    std::atomic<uint64_t> reconnects_{0};
+    int64_t stale_ns_ = 5000 * 1000000LL;      // AGG_STALE_MS，0 表示只在断线时排除
+    int64_t read_timeout_ns_ = 30000 * 1000000LL;  // AGG_READ_TIMEOUT_MS，0 表示不检查
+    int64_t frame_recv_ns_ = 0;       // 当前正在解析的帧的收到时间（mono_ns）
+    int64_t frame_recv_unix_ns_ = 0;  // 同一时刻的 Unix 纳秒，对外发布和录制用
+    // Aggregator* aggregator_{nullptr};  // 新增
 
-    // inline double int_to_price(long long price_int) const {
-    //     if (tick_size_ <= 0.0) return price_int / 100000000.0;
-    //     return price_int * tick_size_;
-    // }
 private:
-    void run();
-    void ping_loop();
+    using WsStream = websocket::stream<beast::ssl_stream<beast::tcp_stream>>;
+    using PlainWsStream = websocket::stream<beast::tcp_stream>;
+
+    // 实际连接的地址：默认取 host()/port()/path()，可用 AGG_<NAME>_URL=ws[s]://host:port/path 覆盖
+    // （如指向本地 mock_exchange），ws:// 不走 TLS
+    struct Endpoint {
+        std::string host;
+        std::string port;
+        std::string path;
+        bool tls = true;
+    };
+    void load_endpoint();
+    // AGG_<NAME><suffix> 设置时取它（source 为变量名），否则取配置文件里的值（source 为 "config"）
+    std::string endpoint_override(const char* suffix, const std::string& configured, std::string& source) const;
+    std::string config_url_;
+    std::string config_rest_url_;
+
+    // 对当前连接（TLS 或明文）执行 fn，两者同一时刻只有一个存在
+    template <typename Fn>
+    void with_stream(Fn&& fn) {
+        if (ws_) fn(*ws_);
+        else fn(*plain_ws_);
+    }
+    void close_socket();
+
+    // 连接流程：resolve -> TCP -> TLS -> WebSocket -> 订阅 -> 读循环。
+    // 以下函数都在 strand_ 上执行；session 为发起时的连接编号，与 session_ 不符说明连接已作废
+    void connect();
+    void on_resolve(uint64_t session, beast::error_code ec, tcp::resolver::results_type results);
+    void on_connect(uint64_t session, beast::error_code ec);
+    void on_ssl_handshake(uint64_t session, beast::error_code ec);
+    void on_handshake(uint64_t session, beast::error_code ec);
+    void do_read(uint64_t session);
+    void on_read(uint64_t session, beast::error_code ec);
+    void do_write();
+    void on_write(uint64_t session, beast::error_code ec);
+    // 流上每个异步操作的回调一开始调用；全部返回后执行等待中的 connect
+    void stream_op_done();
+    void load_rest_target();
+    void start_ping_timer(uint64_t session);
+    // 读超时检查：超过 read_timeout_ns_ 没有收到任何帧（含 pong）就断开重连
+    void start_read_watchdog(uint64_t session);
+    // 作废当前连接，按退避延迟重连
+    void fail(uint64_t session, beast::error_code ec, const char* what);
+    // 第 attempt 次重连前的等待：min * 2^attempt 封顶 max，再在 [d/2, d] 内随机，避免多个连接同时重连
+    std::chrono::milliseconds backoff_delay();
 
-    net::io_context ioc_;
+    net::strand<net::io_context::executor_type> strand_;
     ssl::context ctx_{ssl::context::tlsv12_client};
-    std::unique_ptr<websocket::stream<beast::ssl_stream<tcp::socket>>> ws_;
-    std::thread thread_;
-    std::thread ping_thread_;
-    bool running_ = true;
+    tcp::resolver resolver_;
+    Endpoint endpoint_;
+    RestTarget rest_target_;
+    std::unique_ptr<WsStream> ws_;
+    std::unique_ptr<PlainWsStream> plain_ws_;
+    beast::flat_buffer buffer_;
+    std::deque<std::string> write_queue_;  // 写操作进行中时队首被它引用，只在 on_write 里弹出
+    bool writing_ = false;
+    int stream_ops_ = 0;            // 当前流上尚未返回的异步操作数（connect / 握手 / 读 / 写）
+    bool connect_waiting_ = false;  // connect 在等这些操作返回
+    net::steady_timer ping_timer_;
+    net::steady_timer reconnect_timer_;
+    net::steady_timer read_timer_;
+    // AGG_RECONNECT_MIN_MS / AGG_RECONNECT_MAX_MS；连接上收到第一帧后 attempt 清零
+    std::chrono::milliseconds reconnect_min_{500};
+    std::chrono::milliseconds reconnect_max_{30000};
+    int reconnect_attempt_ = 0;
+    std::minstd_rand jitter_{std::random_device{}()};
+    uint64_t session_ = 0;
+    int64_t connected_ns_ = 0;  // 本次连接握手完成的时间（mono_ns），读超时从这里起算
+    bool running_ = false;
+    std::unique_ptr<CaptureWriter> capture_;  // AGG_CAPTURE_DIR 设置时录制收到的每一帧
 };
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "connector.h"
+#include "depth_index.h"
+#include "flat_book.h"
+
+// 合并引擎本身：合并簿的数据结构和按价位变化增量维护它的函数。
+// 不依赖 gRPC，Aggregator 和 tests/ 共用
+
+// 合并簿中的一个价位：按交易所分别记录数量，total 为各交易所之和
+struct ConsolidatedLevel {
+    Quantity qty[kVenueCount] = {};
+    Quantity total = 0;
+    uint32_t venue_mask = 0;
+};
+
+using ConsolidatedBids = FlatBook<ConsolidatedLevel, true>;
+using ConsolidatedAsks = FlatBook<ConsolidatedLevel, false>;
+
+constexpr int kTopLevels = 100;  // 推送给客户端的最大档数
+
+// 推送出去的一档（整数价格/数量），用于生成增量。
+// venue_mask / venue_qty 只在 venue_breakdown 订阅中填写
+struct TopLevel {
+    PriceTicks price;
+    Quantity qty;
+    uint32_t venue_mask = 0;
+    Quantity venue_qty[kVenueCount] = {};
+};
+
+// 可成交视图里一边与原始合并簿不同的部分：比 price 更优的价位已被对冲掉，
+// partial 时 price 这一档只剩 level 里的数量（含各交易所分布）
+struct NettedSide {
+    PriceTicks price = 0;
+    bool partial = false;
+    TopLevel level;
+};
+
+// 合并簿交叉或锁定（最优买价 >= 最优卖价）时，从两边最优价开始按数量互相对冲，
+// 直到不再交叉，得到可成交（tradable）视图。只记录与原始簿不同的首部，代价与交叉区大小成正比。
+// 档内对冲掉的数量先从最近一次更新最早的交易所扣（其报价最可能已失效）
+struct Netting {
+    bool crossed = false;  // 为 false 时可成交视图与原始簿相同
+    NettedSide bids;       // bids.price 为保留的最高买价（全部对冲掉时为最小值）
+    NettedSide asks;       // asks.price 为保留的最低卖价（全部对冲掉时为最大值）
+    Quantity netted = 0;   // 每边对冲掉的总量
+};
+
+// 单个交易对的合并簿，各交易对互不加锁
+struct ConsolidatedBook {
+    ConsolidatedBids bids;
+    ConsolidatedAsks asks;
+    VenueStamp venues[kVenueCount];  // 各交易所最近一批变化的时间和序号
+    // 不参与合并的交易所位图（还没收到数据、断线或过期）：这些交易所的数量已从各档减去，变化丢弃，
+    // 恢复后按其本地簿整本加回。开始时全部排除。只由合并线程写，指标线程只读
+    std::atomic<uint32_t> excluded{(1u << kVenueCount) - 1};
+    // 其中因价格离其他交易所太远（合并簿窗口放不下，见 apply_changes）而被排除的，只由合并线程读写
+    uint32_t out_of_range = 0;
+    Netting netting;  // 每次合并后重算，受 mutex 保护
+    std::atomic<uint64_t> crossed_merges{0};  // 合并后交叉或锁定的次数
+    // 原始合并簿两边的前缀和索引：每次改档都 touch，用到时（有档位订阅的合并、冲击成本查询）
+    // 才从改动过的最优价位往外 refresh。受 mutex 保护
+    DepthSide bid_depth{true};
+    DepthSide ask_depth{false};
+    std::mutex mutex;
+};
+
+// 只调整本次变化涉及的价位，数量为整数，total 直接按差值增减；改过的价位记进前缀和索引。
+// 新价位离合并簿现有挂单超过 FlatBook::kMaxSpan 时停下返回 false（前面的变化已应用），
+// 调用方应把该交易所整体排除（exclude_venue），而不是让合并线程抛异常
+bool apply_changes(ConsolidatedBook& book, Venue venue, const std::vector<LevelChange>& changes);
+// 把一个交易所从合并簿中整体减去 / 按其当前本地簿整体加回（丢掉它还没交出的变化）。
+// 其本地簿与合并簿放不到同一个窗口里时不加回，返回 false。scratch 为调用方复用的暂存
+void exclude_venue(ConsolidatedBook& book, Venue venue, std::vector<LevelChange>& scratch);
+bool include_venue(ConsolidatedBook& book, Connector& connector, size_t inst, std::vector<LevelChange>& scratch);
+// 按交叉区重算 book.netting
+void net_crossed(ConsolidatedBook& book);
+// 把两边前缀和索引更新到当前合并簿（持有 book.mutex）
+void refresh_depth(ConsolidatedBook& book);
+// 前缀和索引上的可成交视图：交叉时跳过对冲掉的档，部分对冲的一档用剩余数量。索引需已 refresh
+DepthView tradable_depth(const ConsolidatedBook& book, bool is_bid);
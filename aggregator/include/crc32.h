@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// CRC-32（IEEE 802.3 / zlib 多项式 0xEDB88320），OKX / Bitget 深度校验和用。
+// SSE4.2 的 crc32 指令算的是 Castagnoli 多项式，结果不同，不能用；这里用 slicing-by-8 查表，
+// 每次处理 8 字节，表在编译期生成（8 KB）
+namespace crc32_ieee {
+
+namespace detail {
+constexpr std::array<std::array<uint32_t, 256>, 8> make_tables() {
+    std::array<std::array<uint32_t, 256>, 8> t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        t[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+        for (int s = 1; s < 8; ++s) t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xFF];
+    }
+    return t;
+}
+inline constexpr auto kTables = make_tables();
+}  // namespace detail
+
+// 与 zlib crc32(crc, buf, len) 相同：crc 为之前各段的结果，首段传 0
+inline uint32_t update(uint32_t crc, const char* data, size_t len) {
+    const auto& t = detail::kTables;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    crc = ~crc;
+    while (len >= 8) {
+        uint32_t lo, hi;
+        std::memcpy(&lo, p, 4);  // 小端
+        std::memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline uint32_t compute(const char* data, size_t len) { return update(0, data, len); }
+
+}  // namespace crc32_ieee
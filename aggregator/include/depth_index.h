@@ -0,0 +1,160 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "fixed_point.h"
+
+// 按数量或名义金额从最优价往外吃单的结果
+struct Sweep {
+    bool filled = false;   // 深度足够；否则 qty / notional 为整边
+    size_t levels = 0;     // 吃到的档数，含部分成交的最后一档
+    double qty = 0.0;      // 基础币
+    double notional = 0.0; // 计价币
+    PriceTicks worst = 0;  // 最后吃到的价位，levels 为 0 时无意义
+};
+
+// 合并簿一边的前缀和索引，按最优价在前排列：各档价格、数量，以及到该档为止（含）的累计数量和累计名义金额
+// （计价币）。名义金额档位、价格档位、冲击成本都在上面二分查找，不再逐档累加。
+// 合并时只用 touch 记下改动过的最优价位，之前的前缀不受影响；refresh 从该价位起往外重算，
+// 代价与该价位之后的档数成正比，盘口深处的变化几乎不花时间
+class DepthSide {
+public:
+    explicit DepthSide(bool is_bid) : is_bid_(is_bid) {}
+
+    size_t size() const { return price_.size(); }
+    PriceTicks price(size_t i) const { return price_[i]; }
+    Quantity qty(size_t i) const { return qty_[i]; }
+    Quantity cum_qty(size_t i) const { return cum_qty_[i]; }
+    double cum_notional(size_t i) const { return cum_notional_[i]; }
+    double to_price(PriceTicks price) const { return ticks_to_price(price, tick_units_); }
+    double notional(PriceTicks price, Quantity qty) const {
+        return to_price(price) * quantity_to_double(qty);
+    }
+
+    void set_tick_units(int64_t tick_units) { tick_units_ = tick_units; }
+
+    // price 这一档有变化（新增、改量或删除）
+    void touch(PriceTicks price) {
+        if (!dirty_ || (is_bid_ ? price > dirty_from_ : price < dirty_from_)) dirty_from_ = price;
+        dirty_ = true;
+    }
+    // 还有 touch 过但没有 refresh 的价位
+    bool dirty() const { return dirty_; }
+
+    // 保留比 touch 过的最优价位更优的前缀，从该价位起按 book（FlatBook，档内 total 为总量）往外重算
+    template <typename Book>
+    void refresh(const Book& book) {
+        if (!dirty_) return;
+        const size_t keep = first_at_or_worse(dirty_from_);
+        price_.resize(keep);
+        qty_.resize(keep);
+        cum_qty_.resize(keep);
+        cum_notional_.resize(keep);
+        for (auto it = book.from(dirty_from_); it != book.end(); ++it) {
+            const auto [price, lvl] = *it;
+            push_back(price, lvl.total);
+        }
+        dirty_ = false;
+    }
+
+    // 按最优价在前的顺序追加一档
+    void push_back(PriceTicks price, Quantity qty) {
+        const bool first = price_.empty();
+        price_.push_back(price);
+        qty_.push_back(qty);
+        cum_qty_.push_back((first ? 0 : cum_qty_.back()) + qty);
+        cum_notional_.push_back((first ? 0.0 : cum_notional_.back()) + notional(price, qty));
+    }
+
+    // 第一个价格不优于 limit 的档（买边 <= limit，卖边 >= limit），没有返回 size()
+    size_t first_at_or_worse(PriceTicks limit) const {
+        auto it = is_bid_ ? std::lower_bound(price_.begin(), price_.end(), limit, std::greater<PriceTicks>())
+                          : std::lower_bound(price_.begin(), price_.end(), limit);
+        return it - price_.begin();
+    }
+    // from 档之后第一个累计名义金额 >= target 的档，没有返回 size()
+    size_t reach_notional(double target, size_t from = 0) const {
+        return std::lower_bound(cum_notional_.begin() + from, cum_notional_.end(), target) -
+               cum_notional_.begin();
+    }
+    // from 档之后第一个累计数量 >= target 的档，没有返回 size()
+    size_t reach_qty(Quantity target, size_t from = 0) const {
+        return std::lower_bound(cum_qty_.begin() + from, cum_qty_.end(), target) - cum_qty_.begin();
+    }
+
+private:
+    bool is_bid_;
+    int64_t tick_units_ = kDecimalScale;
+    bool dirty_ = false;
+    PriceTicks dirty_from_ = 0;  // touch 过的最优价位
+    std::vector<PriceTicks> price_;
+    std::vector<Quantity> qty_;
+    std::vector<Quantity> cum_qty_;
+    std::vector<double> cum_notional_;
+};
+
+// 一边的视图：去掉 first 之前的档，first 档的数量换成 first_qty（可成交视图里部分对冲的一档）。
+// 视图内的累计值 = 原始前缀和减一个常数偏移，查找仍是二分
+class DepthView {
+public:
+    DepthView(const DepthSide& side, size_t first, Quantity first_qty)
+        : side_(side), first_(std::min(first, side.size())) {
+        if (first_ < side.size()) {
+            first_qty_ = first_qty;
+            qty_offset_ = side.cum_qty(first_) - first_qty;
+            notional_offset_ = side.cum_notional(first_) - side.notional(side.price(first_), first_qty);
+        }
+    }
+
+    size_t size() const { return side_.size() - first_; }
+    bool empty() const { return size() == 0; }
+    PriceTicks price(size_t i) const { return side_.price(first_ + i); }
+    Quantity qty(size_t i) const { return i == 0 ? first_qty_ : side_.qty(first_ + i); }
+    Quantity cum_qty(size_t i) const { return side_.cum_qty(first_ + i) - qty_offset_; }
+    double cum_notional(size_t i) const { return side_.cum_notional(first_ + i) - notional_offset_; }
+
+    size_t first_at_or_worse(PriceTicks limit) const {
+        return std::max(side_.first_at_or_worse(limit), first_) - first_;
+    }
+    size_t reach_notional(double target) const {
+        return side_.reach_notional(target + notional_offset_, first_) - first_;
+    }
+    size_t reach_qty(Quantity target) const {
+        return side_.reach_qty(target + qty_offset_, first_) - first_;
+    }
+
+    // 吃掉 target 数量：二分到累计数量首次达到 target 的档，最后一档只算用到的部分
+    Sweep sweep_qty(Quantity target) const {
+        const size_t k = reach_qty(target);
+        if (k == size()) return whole();
+        const Quantity before = k ? cum_qty(k - 1) : 0;
+        Sweep s{true, k + 1, quantity_to_double(target), 0.0, price(k)};
+        s.notional = (k ? cum_notional(k - 1) : 0.0) + side_.notional(price(k), target - before);
+        return s;
+    }
+    // 吃掉 target 名义金额，最后一档按价格折算成数量
+    Sweep sweep_notional(double target) const {
+        const size_t k = reach_notional(target);
+        if (k == size()) return whole();
+        const double before = k ? cum_notional(k - 1) : 0.0;
+        Sweep s{true, k + 1, 0.0, target, price(k)};
+        s.qty = (k ? quantity_to_double(cum_qty(k - 1)) : 0.0) + (target - before) / side_.to_price(price(k));
+        return s;
+    }
+
+private:
+    Sweep whole() const {
+        if (empty()) return {};
+        const size_t n = size();
+        return {false, n, quantity_to_double(cum_qty(n - 1)), cum_notional(n - 1), price(n - 1)};
+    }
+
+    const DepthSide& side_;
+    size_t first_;
+    Quantity first_qty_ = 0;
+    Quantity qty_offset_ = 0;
+    double notional_offset_ = 0.0;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// 深度消息的快速扫描：直接在收到的帧上定位字段、逐档取出价格/数量的 string_view，
+// 不建 DOM、不分配内存。只覆盖各交易所深度推送的固定格式（字符串不含转义），
+// 遇到任何意外格式都返回 false，由调用方退回 nlohmann::json 解析。
+namespace depth_parser {
+
+inline size_t skip_ws(std::string_view s, size_t i) {
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\n' || s[i] == '\r')) ++i;
+    return i;
+}
+
+// 定位 "key": 之后第一个非空白字符的位置，找不到返回 npos
+inline size_t find_value(std::string_view msg, std::string_view key) {
+    size_t pos = 0;
+    while (true) {
+        pos = msg.find(key, pos);
+        if (pos == std::string_view::npos) return pos;
+        size_t end = pos + key.size();
+        if (pos > 0 && msg[pos - 1] == '"' && end < msg.size() && msg[end] == '"') {
+            size_t i = skip_ws(msg, end + 1);
+            if (i < msg.size() && msg[i] == ':') return skip_ws(msg, i + 1);
+        }
+        pos = end;
+    }
+}
+
+// "key":"value" -> value
+inline bool find_string(std::string_view msg, std::string_view key, std::string_view& out) {
+    size_t i = find_value(msg, key);
+    if (i == std::string_view::npos || i >= msg.size() || msg[i] != '"') return false;
+    size_t end = msg.find('"', i + 1);
+    if (end == std::string_view::npos) return false;
+    out = msg.substr(i + 1, end - i - 1);
+    return true;
+}
+
+// "key":123 或 "key":"123" -> 非负整数（交易所的时间戳、序号两种写法都有）
+inline bool find_uint(std::string_view msg, std::string_view key, uint64_t& out) {
+    size_t i = find_value(msg, key);
+    if (i == std::string_view::npos || i >= msg.size()) return false;
+    if (msg[i] == '"') ++i;
+    uint64_t v = 0;
+    size_t start = i;
+    while (i < msg.size() && msg[i] >= '0' && msg[i] <= '9') v = v * 10 + (msg[i++] - '0');
+    if (i == start) return false;
+    out = v;
+    return true;
+}
+
+// "key":-123 或 "key":"-123" -> 有符号整数（OKX / Bitget 的 checksum）
+inline bool find_int(std::string_view msg, std::string_view key, int64_t& out) {
+    size_t i = find_value(msg, key);
+    if (i == std::string_view::npos || i >= msg.size()) return false;
+    if (msg[i] == '"') ++i;
+    const bool negative = i < msg.size() && msg[i] == '-';
+    uint64_t v = 0;
+    if (negative) ++i;
+    size_t start = i;
+    while (i < msg.size() && msg[i] >= '0' && msg[i] <= '9') v = v * 10 + (msg[i++] - '0');
+    if (i == start) return false;
+    out = negative ? -static_cast<int64_t>(v) : static_cast<int64_t>(v);
+    return true;
+}
+
+// "key":[...] -> 包含两端方括号的整个数组
+inline bool find_array(std::string_view msg, std::string_view key, std::string_view& out) {
+    size_t i = find_value(msg, key);
+    if (i == std::string_view::npos || i >= msg.size() || msg[i] != '[') return false;
+    int depth = 0;
+    for (size_t j = i; j < msg.size(); ++j) {
+        char c = msg[j];
+        if (c == '"') {
+            j = msg.find('"', j + 1);
+            if (j == std::string_view::npos) return false;
+        } else if (c == '[') {
+            ++depth;
+        } else if (c == ']' && --depth == 0) {
+            out = msg.substr(i, j - i + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// 遍历 [["price","qty",...],...]，对每档调用 fn(price, qty)，fn 返回 false 时中止
+template <typename Fn>
+bool for_each_level(std::string_view levels, Fn&& fn) {
+    size_t i = skip_ws(levels, 0);
+    if (i >= levels.size() || levels[i] != '[') return false;
+    i = skip_ws(levels, i + 1);
+    if (i < levels.size() && levels[i] == ']') return true;
+
+    while (i < levels.size()) {
+        if (levels[i] != '[') return false;
+        std::string_view fields[2];
+        int n = 0;
+        i = skip_ws(levels, i + 1);
+        while (i < levels.size() && levels[i] != ']') {
+            if (levels[i] != '"') return false;
+            size_t end = levels.find('"', i + 1);
+            if (end == std::string_view::npos) return false;
+            if (n < 2) fields[n] = levels.substr(i + 1, end - i - 1);
+            ++n;
+            i = skip_ws(levels, end + 1);
+            if (i < levels.size() && levels[i] == ',') i = skip_ws(levels, i + 1);
+        }
+        if (n < 2 || i >= levels.size()) return false;
+        if (!fn(fields[0], fields[1])) return false;
+
+        i = skip_ws(levels, i + 1);
+        if (i < levels.size() && levels[i] == ',') {
+            i = skip_ws(levels, i + 1);
+        } else {
+            return i < levels.size() && levels[i] == ']';
+        }
+    }
+    return false;
+}
+
+}  // namespace depth_parser
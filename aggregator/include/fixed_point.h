@@ -0,0 +1,82 @@
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+
+// 定点数表示：价格按 tick 编号（price = ticks * tick_size），数量按 1e-8 缩放。
+// 解析时一次转换为整数，合并、比较全部走整数，只在生成 proto 时转回 double。
+using PriceTicks = int64_t;
+using Quantity = int64_t;
+
+constexpr int kDecimals = 8;                 // 价格原始值和数量都先解析成 1e-8 单位
+constexpr int64_t kDecimalScale = 100000000;
+
+// 十进制字符串 -> 定点整数（decimals 位小数，多余位截断）。格式不合法、没有数字或超出 int64 返回 false
+inline bool parse_decimal(std::string_view s, int decimals, int64_t& out) {
+    static constexpr int64_t kPow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000,
+                                         10000000, 100000000, 1000000000};
+    const char* p = s.data();
+    const char* end = p + s.size();
+    bool negative = false;
+    if (p != end && *p == '-') {
+        negative = true;
+        ++p;
+    }
+    if (p == end) return false;
+
+    int64_t value = 0;
+    bool has_digit = false;
+    if (*p != '.') {
+        auto [ptr, ec] = std::from_chars(p, end, value);
+        if (ec != std::errc() || value < 0) return false;
+        p = ptr;
+        has_digit = true;
+    }
+    int64_t frac = 0;
+    int digits = 0;
+    if (p != end && *p == '.') {
+        ++p;
+        for (; p != end && *p >= '0' && *p <= '9'; ++p) {
+            has_digit = true;
+            if (digits < decimals) {
+                frac = frac * 10 + (*p - '0');
+                ++digits;
+            }
+        }
+    }
+    if (p != end || !has_digit) return false;
+    const int64_t frac_part = frac * kPow10[decimals - digits];
+    if (value > (std::numeric_limits<int64_t>::max() - frac_part) / kPow10[decimals]) return false;
+    value = value * kPow10[decimals] + frac_part;
+    out = negative ? -value : value;
+    return true;
+}
+
+inline Quantity parse_quantity(std::string_view s) {
+    int64_t q = 0;
+    if (!parse_decimal(s, kDecimals, q)) throw std::invalid_argument("bad quantity");
+    return q;
+}
+
+inline double quantity_to_double(Quantity q) {
+    return static_cast<double>(q) / kDecimalScale;
+}
+
+// tick_size -> 1e-8 整数单位。不是 1e-8 的正整数倍（包括小于 5e-9、舍入后为 0 的）返回 0，
+// 否则原始价位按 tick 取整（connector 里除以它）会除零或错位
+inline int64_t tick_size_units(double tick_size) {
+    if (!(tick_size > 0) || tick_size > 1e9) return 0;
+    const double scaled = tick_size * kDecimalScale;
+    const int64_t units = std::llround(scaled);
+    if (units == 0 || std::fabs(scaled - static_cast<double>(units)) > 1e-9 * static_cast<double>(units)) return 0;
+    return units;
+}
+
+// tick 编号 -> 价格：先在整数上乘出 1e-8 单位再换算一次，不经过 double 的 tick_size 累积误差
+inline double ticks_to_price(PriceTicks ticks, int64_t tick_units) {
+    return static_cast<double>(ticks * tick_units) / kDecimalScale;
+}
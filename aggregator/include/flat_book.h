@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "fixed_point.h"
+
+// 稠密 tick 数组订单簿：价位按 tick 编号直接落在连续数组里，
+// 占用情况记在位图中。查找/更新/删除 O(1)，top-N 遍历是连续内存上的位扫描。
+// 窗口只覆盖当前有挂单的价格区间（两侧留余量），价格漂出窗口时整体搬迁一次。
+// IsBid = true 时从高价往低价遍历，否则从低价往高价。
+template <typename Level, bool IsBid>
+class FlatBook {
+public:
+    static constexpr size_t kMinCapacity = 1024;
+    static constexpr PriceTicks kMaxSpan = PriceTicks(1) << 20;  // 防止异常价格撑爆内存
+
+    class const_iterator {
+    public:
+        std::pair<PriceTicks, const Level&> operator*() const {
+            return {book_->base_ + idx_, book_->slots_[idx_]};
+        }
+        const_iterator& operator++() {
+            idx_ = IsBid ? book_->prev_set(idx_ - 1) : book_->next_set(idx_ + 1);
+            return *this;
+        }
+        bool operator==(const const_iterator& o) const { return idx_ == o.idx_; }
+        bool operator!=(const const_iterator& o) const { return idx_ != o.idx_; }
+
+    private:
+        friend class FlatBook;
+        const_iterator(const FlatBook* book, int64_t idx) : book_(book), idx_(idx) {}
+        const FlatBook* book_;
+        int64_t idx_;  // -1 表示 end
+    };
+
+    const_iterator begin() const { return {this, count_ ? (IsBid ? hi_ : lo_) : -1}; }
+    const_iterator end() const { return {this, -1}; }
+    // 从 price 这一档（没有挂单时为其后第一档）开始，按同样方向遍历
+    const_iterator from(PriceTicks price) const {
+        if (count_ == 0) return end();
+        const int64_t idx = price - base_;
+        if (IsBid) return {this, idx < lo_ ? -1 : prev_set(std::min(idx, hi_))};
+        return {this, idx > hi_ ? -1 : next_set(std::max(idx, lo_))};
+    }
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    // 最优价（调用前需确认非空）
+    PriceTicks best_price() const { return base_ + (IsBid ? hi_ : lo_); }
+    // 最差价（调用前需确认非空）
+    PriceTicks worst_price() const { return base_ + (IsBid ? lo_ : hi_); }
+
+    Level* find(PriceTicks price) {
+        int64_t idx = price - base_;
+        if (idx < 0 || idx >= capacity() || !test(idx)) return nullptr;
+        return &slots_[idx];
+    }
+    const Level* find(PriceTicks price) const {
+        return const_cast<FlatBook*>(this)->find(price);
+    }
+
+    // 再放入 [lo, hi] 内的价位后，窗口跨度是否仍在 kMaxSpan 以内
+    bool fits(PriceTicks lo, PriceTicks hi) const {
+        if (count_) {
+            lo = std::min(lo, base_ + lo_);
+            hi = std::max(hi, base_ + hi_);
+        }
+        return hi - lo + 1 <= kMaxSpan;
+    }
+
+    // 不存在时插入默认值；离现有挂单太远（跨度超过 kMaxSpan）时抛 length_error
+    Level& operator[](PriceTicks price) {
+        Level* level = find_or_insert(price);
+        if (!level) throw std::length_error("price out of book range");
+        return *level;
+    }
+
+    // 同 operator[]，但放不下时不抛异常，返回 nullptr，簿不变
+    Level* find_or_insert(PriceTicks price) {
+        int64_t idx = price - base_;
+        if (idx < 0 || idx >= capacity()) {
+            if (!fits(price, price)) return nullptr;
+            relocate(price);
+            idx = price - base_;
+        }
+        if (!test(idx)) {
+            bits_[idx >> 6] |= uint64_t(1) << (idx & 63);
+            if (count_ == 0) {
+                lo_ = hi_ = idx;
+            } else {
+                if (idx < lo_) lo_ = idx;
+                if (idx > hi_) hi_ = idx;
+            }
+            ++count_;
+        }
+        return &slots_[idx];
+    }
+
+    bool erase(PriceTicks price) {
+        int64_t idx = price - base_;
+        if (idx < 0 || idx >= capacity() || !test(idx)) return false;
+        bits_[idx >> 6] &= ~(uint64_t(1) << (idx & 63));
+        slots_[idx] = Level{};
+        if (--count_ == 0) return true;
+        if (idx == lo_) lo_ = next_set(idx + 1);
+        if (idx == hi_) hi_ = prev_set(idx - 1);
+        return true;
+    }
+
+    void clear() {
+        for (auto it = begin(); it != end(); ++it) slots_[it.idx_] = Level{};
+        std::fill(bits_.begin(), bits_.end(), 0);
+        count_ = 0;
+    }
+
+private:
+    int64_t capacity() const { return static_cast<int64_t>(slots_.size()); }
+    bool test(int64_t idx) const { return (bits_[idx >> 6] >> (idx & 63)) & 1; }
+
+    // [idx, hi_] 中第一个有挂单的下标，没有返回 -1
+    int64_t next_set(int64_t idx) const {
+        if (count_ == 0 || idx > hi_) return -1;
+        int64_t w = idx >> 6;
+        uint64_t word = bits_[w] & (~uint64_t(0) << (idx & 63));
+        while (word == 0) {
+            if (++w > (hi_ >> 6)) return -1;
+            word = bits_[w];
+        }
+        return (w << 6) + __builtin_ctzll(word);
+    }
+
+    // [lo_, idx] 中最后一个有挂单的下标，没有返回 -1
+    int64_t prev_set(int64_t idx) const {
+        if (count_ == 0 || idx < lo_) return -1;
+        int64_t w = idx >> 6;
+        uint64_t word = bits_[w] & (~uint64_t(0) >> (63 - (idx & 63)));
+        while (word == 0) {
+            if (--w < (lo_ >> 6)) return -1;
+            word = bits_[w];
+        }
+        return (w << 6) + 63 - __builtin_clzll(word);
+    }
+
+    // 重新分配窗口，使其覆盖现有挂单和 price，两侧各留约一半余量。调用方已用 fits 检查过跨度
+    void relocate(PriceTicks price) {
+        PriceTicks lo = price, hi = price;
+        if (count_) {
+            lo = std::min(lo, base_ + lo_);
+            hi = std::max(hi, base_ + hi_);
+        }
+        PriceTicks span = hi - lo + 1;
+
+        size_t cap = kMinCapacity;
+        while (cap < static_cast<size_t>(span) * 2) cap <<= 1;
+        PriceTicks new_base = lo - static_cast<PriceTicks>(cap - span) / 2;
+
+        std::vector<Level> slots(cap);
+        std::vector<uint64_t> bits(cap / 64, 0);
+        int64_t new_lo = 0, new_hi = 0;
+        if (count_) {
+            for (int64_t idx = lo_; idx != -1; idx = next_set(idx + 1)) {
+                int64_t n = base_ + idx - new_base;
+                slots[n] = std::move(slots_[idx]);
+                bits[n >> 6] |= uint64_t(1) << (n & 63);
+            }
+            new_lo = base_ + lo_ - new_base;
+            new_hi = base_ + hi_ - new_base;
+        }
+        slots_.swap(slots);
+        bits_.swap(bits);
+        base_ = new_base;
+        lo_ = new_lo;
+        hi_ = new_hi;
+    }
+
+    std::vector<Level> slots_;
+    std::vector<uint64_t> bits_;
+    PriceTicks base_{0};  // slots_[0] 对应的 tick
+    int64_t lo_{0};       // 有挂单的最低下标（count_ > 0 时有效）
+    int64_t hi_{0};       // 有挂单的最高下标
+    size_t count_{0};
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// 所有 connector 共用的 io_context 池：每个 io_context 一个线程，
+// connector 按轮询分配到其中一个，线程数与交易所/交易对数量无关。
+class IoPool {
+public:
+    // size 为 0 时取 CPU 核数
+    explicit IoPool(size_t size);
+    ~IoPool();
+
+    IoPool(const IoPool&) = delete;
+    IoPool& operator=(const IoPool&) = delete;
+
+    boost::asio::io_context& next();
+    size_t size() const { return contexts_.size(); }
+
+    void start();
+    // 停止所有 io_context 并等待线程退出，之后不会再执行任何回调
+    void stop();
+
+private:
+    using WorkGuard = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
+
+    std::vector<std::unique_ptr<boost::asio::io_context>> contexts_;
+    std::vector<WorkGuard> guards_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_{0};
+};
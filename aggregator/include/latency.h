@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "clock.h"
+#include "connector.h"
+
+// HDR 风格的对数-线性直方图：每个 2 的幂区间分 16 格，相对误差约 6%，覆盖 1ns ~ 约 18 分钟。
+// 计数为 relaxed 原子量，多个线程可以同时 record，读取时不保证是同一时刻的快照
+class LatencyHistogram {
+public:
+    static constexpr int kSubBits = 4;
+    static constexpr int kSub = 1 << kSubBits;
+    static constexpr int kMaxBits = 40;
+    static constexpr int kBuckets = (kMaxBits - kSubBits + 1) * kSub;
+
+    void record(int64_t ns);
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum_ns() const { return sum_ns_.load(std::memory_order_relaxed); }
+    uint64_t max_ns() const { return max_ns_.load(std::memory_order_relaxed); }
+    // q 为 0~1，返回所在格的上界（纳秒）；没有样本时返回 0
+    int64_t percentile(double q) const;
+
+private:
+    static int bucket(uint64_t v);
+    static uint64_t bucket_upper(int idx);
+
+    std::array<std::atomic<uint64_t>, kBuckets> counts_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_ns_{0};
+    std::atomic<uint64_t> max_ns_{0};
+};
+
+// 一次更新从收到 WebSocket 帧到 gRPC 写完经过的各段：
+//   parse    收到帧 -> 解析完、变化交出（按交易所）
+//   queue    交出 -> 合并线程开始处理（按交易所，含合并窗口的等待）
+//   merge    合并进合并簿
+//   publish  各 feed 取前 N 档、比对、序列化并入队
+//   write    入队 -> 该订阅者的 Write 完成（含排队）
+//   total    收到帧 -> Write 完成
+struct LatencyMetrics {
+    LatencyHistogram parse[kVenueCount];
+    LatencyHistogram queue[kVenueCount];
+    LatencyHistogram merge;
+    LatencyHistogram publish;
+    LatencyHistogram write;
+    LatencyHistogram total;
+
+    // Prometheus 文本格式（summary，单位秒）
+    std::string prometheus() const;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "connector.h"
+
+// 合并调度：connector 只标记“某交易所的某交易对有新变化”，由单独的合并线程
+// 每个时间窗（window 为 0 时即合并线程空闲时）对每个脏交易对做一次合并和推送。
+// 几个交易所几乎同时推送时只合并一次，代价是最多一个窗口的额外延迟。
+class MergeScheduler {
+public:
+    // 合并 inst 号交易对，venues 为有待合并变化的交易所位图，定时检查时为 0
+    using MergeFn = std::function<void(size_t inst, uint32_t venues)>;
+
+    // 每个交易对的累计指标
+    struct Stats {
+        uint64_t notifications = 0;   // mark_dirty 次数
+        uint64_t merges = 0;          // 实际合并次数
+        uint64_t delay_sum_ns = 0;    // 首次标记到开始合并的等待时间
+        uint64_t delay_max_ns = 0;
+    };
+
+    // check_interval 不为 0 时，每隔这么久对每个交易对调用一次 merge(inst, 0)
+    MergeScheduler(const std::vector<Instrument>& instruments, std::chrono::microseconds window,
+                   MergeFn merge, std::chrono::milliseconds check_interval = std::chrono::milliseconds(0));
+    ~MergeScheduler();
+
+    MergeScheduler(const MergeScheduler&) = delete;
+    MergeScheduler& operator=(const MergeScheduler&) = delete;
+
+    void start();
+    // 等合并线程退出，之后不会再调用 merge
+    void stop();
+
+    // connector 线程调用，只置位，不做合并；只用原子操作，不与合并线程争锁
+    void mark_dirty(size_t inst, Venue venue);
+
+    Stats stats(size_t inst) const;
+
+private:
+    struct Pending {
+        std::atomic<uint32_t> venues{0};
+        std::atomic<uint64_t> notifications{0};
+        std::atomic<int64_t> first_dirty_ns{0};  // steady_clock 纳秒，仅用于窗口和指标，允许略有偏差
+    };
+
+    void run();
+    void log_stats();
+
+    const std::vector<Instrument>& instruments_;
+    const std::chrono::microseconds window_;
+    MergeFn merge_;
+    const std::chrono::milliseconds check_interval_;
+
+    std::vector<Pending> pending_;      // 按交易对下标
+    std::atomic<size_t> dirty_{0};      // 从无到有被标记的次数，合并线程据此判断是否有活
+    std::mutex mutex_;                  // 只用于合并线程睡眠/唤醒和 stop_
+    std::condition_variable cv_;
+    bool stop_ = false;
+
+    mutable std::mutex stats_mutex_;
+    std::vector<Stats> stats_;
+
+    std::thread thread_;
+};
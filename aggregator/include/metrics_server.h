@@ -0,0 +1,29 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <functional>
+#include <string>
+#include <thread>
+
+// 只监听 127.0.0.1 的极简 HTTP 服务：任何 GET 都返回 render() 生成的 Prometheus 文本。
+// 自带一个 io_context 和线程，不占用行情 IO 线程
+class MetricsServer {
+public:
+    MetricsServer(unsigned short port, std::function<std::string()> render);
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    void start();
+    void stop();
+
+private:
+    void do_accept();
+
+    boost::asio::io_context ioc_{1};
+    boost::asio::ip::tcp::acceptor acceptor_;
+    std::function<std::string()> render_;
+    std::thread thread_;
+};
@@ -7,15 +7,32 @@
 class OKXConnector : public Connector {
 public:
     // OKXConnector(Aggregator* agg) : Connector(agg, "OKX") {}
-    explicit OKXConnector(Aggregator* aggregator);
+    OKXConnector(BookListener* aggregator, net::io_context& ioc, const std::vector<Instrument>& instruments);
 protected:
     std::string host() const override { return "ws.okx.com"; }
     std::string port() const override { return "8443"; }
     std::string path() const override { return "/ws/v5/public"; }
-    std::string subscribe_message() const override {
-        return R"({"op":"subscribe","args":[{"channel":"books5","instId":"BTC-USDT"}]})";
+    std::vector<std::string> subscribe_messages() const override {
+        std::string args;
+        for (const auto& s : subscribed_symbols()) {
+            if (!args.empty()) args += ',';
+            args += book_arg(s);
+        }
+        return {R"({"op":"subscribe","args":[)" + args + "]}"};
         // return R"({"op":"subscribe","args":[{"channel":"books50","instId":"BTC-USDT"}]})";
     }
 
-    void parse_message(const std::string& msg) override;
+    void parse_message(std::string_view msg) override;
+private:
+    bool parse_fast(std::string_view msg);
+
+    // 全深度用 books 频道（先推 snapshot 再推 update），否则用 books5 分档快照
+    std::string book_arg(const std::string& inst_id) const {
+        return std::string(R"({"channel":")") + (full_depth_ ? "books" : "books5") + R"(","instId":")" + inst_id + R"("})";
+    }
+    // books 频道：update 的 prevSeqId 必须等于上一条的 seqId，应用后前 25 档的校验和必须一致，
+    // 否则退订再订阅该交易对取新快照。返回 false 表示档位格式不对
+    bool on_books(size_t inst, std::string_view action, std::string_view data, std::string_view bids,
+                  std::string_view asks);
+    void resubscribe(size_t inst);
 };
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// 订阅的节流（min_interval）：距上次推送不到间隔的变化先压下，记为待发；
+// 到期后由下一次合并，或合并线程的定时检查（簿没有新变化时）补发，簿安静下来也不会丢掉最后的状态。
+// 不加锁，由 feed 所在的锁保护
+class PublishThrottle {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit PublishThrottle(std::chrono::milliseconds min_interval) : interval_(min_interval) {}
+
+    // 合并后调用：现在能推送返回 true，origin_ns 换成间隔内被压下的变化里最早一帧的收到时间
+    // （端到端延迟从它算起），待发标记清掉；还在间隔内返回 false，记下待发
+    bool admit(Clock::time_point now, int64_t& origin_ns) {
+        if (held_origin_ns_ > 0 && (origin_ns == 0 || held_origin_ns_ < origin_ns)) origin_ns = held_origin_ns_;
+        if (sent_ && now - last_sent_ < interval_) {
+            pending_ = true;
+            held_origin_ns_ = origin_ns;
+            return false;
+        }
+        pending_ = false;
+        held_origin_ns_ = 0;
+        return true;
+    }
+    // 确实推送了一条消息
+    void sent(Clock::time_point now) {
+        sent_ = true;
+        last_sent_ = now;
+    }
+
+    bool pending() const { return pending_; }
+    // 待发的变化可以补发了
+    bool due(Clock::time_point now) const { return pending_ && now - last_sent_ >= interval_; }
+
+private:
+    const std::chrono::milliseconds interval_;
+    bool sent_ = false;
+    bool pending_ = false;
+    Clock::time_point last_sent_{};
+    int64_t held_origin_ns_ = 0;  // 被压下的变化里最早一帧的收到时间，0 表示不计延迟
+};
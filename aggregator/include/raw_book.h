@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "fixed_point.h"
+
+// 推送里价格 / 数量的原文，定长不分配；超长时 len 记为 kTooLong，该档不参与校验和
+struct RawText {
+    static constexpr uint8_t kCapacity = 23;
+    static constexpr uint8_t kTooLong = 0xFF;
+    uint8_t len = 0;
+    char data[kCapacity] = {};
+
+    void assign(std::string_view s) {
+        if (s.size() > kCapacity) {
+            len = kTooLong;
+            return;
+        }
+        len = static_cast<uint8_t>(s.size());
+        std::memcpy(data, s.data(), s.size());
+    }
+    bool valid() const { return len != kTooLong; }
+    std::string_view view() const { return {data, len}; }
+};
+
+// 增量频道的一档原始价位：数量和推送原文
+struct RawLevel {
+    Quantity qty = 0;
+    RawText price;
+    RawText size;
+};
+
+// 增量频道一边的原始价位，按交易所原始价格（1e-8 单位）排好序的定长记录数组。
+// 从最差价排到最优价，最优价在末尾：推送的变化大多在盘口附近，插入 / 删除只移动末尾少量记录。
+// 原文内联在记录里，容量在 clear() 时预留并一直复用，稳态下不分配内存。
+// IsBid = true 时按价格升序，否则降序
+template <bool IsBid>
+class RawSide {
+public:
+    static constexpr size_t kReserve = 1024;
+
+    struct Entry {
+        int64_t raw;
+        RawLevel level;
+    };
+    using const_iterator = typename std::vector<Entry>::const_iterator;
+    using const_reverse_iterator = typename std::vector<Entry>::const_reverse_iterator;
+
+    // 从最差价到最优价
+    const_iterator begin() const { return entries_.begin(); }
+    const_iterator end() const { return entries_.end(); }
+    // 从最优价到最差价
+    const_reverse_iterator rbegin() const { return entries_.rbegin(); }
+    const_reverse_iterator rend() const { return entries_.rend(); }
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+
+    RawLevel* find(int64_t raw) {
+        auto it = lower_bound(raw);
+        return it != entries_.end() && it->raw == raw ? &it->level : nullptr;
+    }
+
+    // 不存在时按序插入默认值
+    RawLevel& operator[](int64_t raw) {
+        auto it = lower_bound(raw);
+        if (it == entries_.end() || it->raw != raw) it = entries_.insert(it, Entry{raw, RawLevel{}});
+        return it->level;
+    }
+
+    bool erase(int64_t raw) {
+        auto it = lower_bound(raw);
+        if (it == entries_.end() || it->raw != raw) return false;
+        entries_.erase(it);
+        return true;
+    }
+
+    // 快照用：先不管顺序逐档追加，全部追加完再 sort()。快照从最优价开始给，逐档有序插入会每次搬动整个数组
+    RawLevel& append(int64_t raw) {
+        entries_.push_back(Entry{raw, RawLevel{}});
+        return entries_.back().level;
+    }
+
+    // 排好 append 进来的记录；同一价格出现多次时只保留一条
+    void sort() {
+        auto worse_entry = [](const Entry& a, const Entry& b) { return worse(a.raw, b.raw); };
+        // 快照通常从最优价开始有序给出，倒过来即可
+        if (!std::is_sorted(entries_.begin(), entries_.end(), worse_entry)) {
+            std::reverse(entries_.begin(), entries_.end());
+            if (!std::is_sorted(entries_.begin(), entries_.end(), worse_entry)) {
+                std::stable_sort(entries_.begin(), entries_.end(), worse_entry);
+            }
+        }
+        auto out = entries_.begin();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (out != entries_.begin() && (out - 1)->raw == it->raw) *(out - 1) = *it;
+            else *out++ = *it;
+        }
+        entries_.erase(out, entries_.end());
+    }
+
+    void clear() {
+        entries_.clear();
+        entries_.reserve(kReserve);
+    }
+
+private:
+    // a 比 b 离盘口远
+    static bool worse(int64_t a, int64_t b) { return IsBid ? a < b : a > b; }
+
+    // 第一个不比 raw 差的记录
+    typename std::vector<Entry>::iterator lower_bound(int64_t raw) {
+        return std::lower_bound(entries_.begin(), entries_.end(), raw,
+                                [](const Entry& e, int64_t r) { return worse(e.raw, r); });
+    }
+
+    std::vector<Entry> entries_;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "capture.h"
+#include "connector.h"
+
+// 回放 CaptureWriter 录下的文件：按收到时间归并所有文件，把每帧交给对应交易所
+// connector 的 parse_message，后续合并/推送路径与实盘完全相同。
+// 回放期间这些 connector 不连网，只由回放线程调用。
+class ReplayConnector {
+public:
+    // path 为单个 .cap 文件或包含 .cap 文件的目录；speed 为 1 按原速，2 为两倍速，0 为不限速
+    ReplayConnector(std::string path, double speed, Connector* const (&targets)[kVenueCount]);
+    ~ReplayConnector();
+
+    ReplayConnector(const ReplayConnector&) = delete;
+    ReplayConnector& operator=(const ReplayConnector&) = delete;
+
+    void start();
+    void stop();
+    bool finished() const { return finished_; }
+
+private:
+    void run();
+
+    const std::string path_;
+    const double speed_;
+    Connector* targets_[kVenueCount];
+    std::vector<std::unique_ptr<CaptureReader>> readers_;
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> finished_{false};
+};
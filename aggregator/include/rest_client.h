@@ -0,0 +1,21 @@
+#pragma once
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/beast/core/error.hpp>
+#include <functional>
+#include <string>
+
+// 一次性的 HTTP(S) GET：连接、发请求、读完整响应后关闭。
+// 所有 IO 在调用方给的 executor（connector 的 strand）上执行，done 也在上面回调。
+// 只有网络错误才置 ec，HTTP 状态码由调用方检查
+struct RestTarget {
+    std::string host;
+    std::string port;
+    bool tls = true;
+};
+
+using RestCallback = std::function<void(boost::beast::error_code ec, unsigned status, std::string body)>;
+
+void http_get(boost::asio::any_io_executor executor, boost::asio::ssl::context& ctx,
+              const RestTarget& target, const std::string& path, RestCallback done);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// 单生产者单消费者的定长环形队列，无锁、不分配内存。
+// push 只能在一个线程调用，pop 只能在另一个线程调用；满了 push 返回 false，空了 pop 返回 false。
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool push(T&& value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == Capacity) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == Capacity) return false;
+        }
+        slots_[tail & (Capacity - 1)] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& out) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) return false;
+        }
+        out = std::move(slots_[head & (Capacity - 1)]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // 生产者和消费者各自写的下标分在不同缓存行，避免伪共享
+    alignas(64) std::atomic<size_t> head_{0};  // 消费者写
+    size_t tail_cache_ = 0;                    // 消费者看到的 tail_
+    alignas(64) std::atomic<size_t> tail_{0};  // 生产者写
+    size_t head_cache_ = 0;                    // 生产者看到的 head_
+    alignas(64) std::array<T, Capacity> slots_{};
+};
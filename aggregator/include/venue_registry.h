@@ -0,0 +1,25 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "connector.h"
+
+// 启动配置：交易对和启用的交易所。
+// AGG_CONFIG=venues.json 时从文件读取（格式见 venues.example.json），否则用 AGG_SYMBOLS 和全部四个交易所。
+// 文件里给出的是默认值，同名环境变量（AGG_SYMBOLS、AGG_<VENUE>_URL、AGG_FULL_DEPTH 等）设置时仍优先
+struct AggregatorConfig {
+    std::vector<Instrument> instruments;  // 下标即交易对编号
+    std::vector<VenueConfig> venues;      // 只含启用的交易所，按配置顺序
+};
+
+AggregatorConfig load_config();
+
+// "BTC-USDT" + tick -> Instrument。格式不对、tick 不是 1e-8 的正整数倍时抛 invalid_argument，
+// 提示里带上 source（配置来源）
+Instrument make_instrument(const std::string& pair, double tick_size, const std::string& source);
+
+// 按 config.venue 创建对应协议的 connector 并应用配置，尚未 start
+std::unique_ptr<Connector> make_connector(const VenueConfig& config, BookListener* aggregator,
+                                          net::io_context& ioc, const std::vector<Instrument>& instruments);
@@ -1,29 +1,94 @@
 #include "aggregator.h"
-#include "binance_connector.h"
-#include "okx_connector.h"
-#include "bitget_connector.h"
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <iomanip>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
 
-Aggregator::Aggregator() {
-    std::cout << "Aggregator constructed, creating connectors..." << std::endl;
-    binance_ = std::make_unique<BinanceConnector>(this);
-    okx_ = std::make_unique<OKXConnector>(this);
-    bitget_ = std::make_unique<BitgetConnector>(this);
-    bybit_ = std::make_unique<BybitConnector>(this);
-    std::cout << "Connectors created" << std::endl;
+Aggregator::Aggregator() : Aggregator(load_config()) {}
+
+Aggregator::Aggregator(AggregatorConfig config) : instruments_(std::move(config.instruments)) {
+    for (size_t i = 0; i < instruments_.size(); ++i) {
+        books_.push_back(std::make_unique<ConsolidatedBook>());
+        books_.back()->bid_depth.set_tick_units(instruments_[i].tick_units);
+        books_.back()->ask_depth.set_tick_units(instruments_[i].tick_units);
+    }
+    // AGG_SNAPSHOT_INTERVAL_MS：增量订阅插入完整快照的间隔
+    std::chrono::milliseconds snapshot_interval{5000};
+    const char* snapshot_ms = std::getenv("AGG_SNAPSHOT_INTERVAL_MS");
+    if (snapshot_ms) snapshot_interval = std::chrono::milliseconds(std::strtol(snapshot_ms, nullptr, 10));
+    service_.set_instruments(&instruments_, snapshot_interval);
+    service_.set_books(&books_);
+    service_.set_latency(&latency_);
+
+    // AGG_IO_THREADS：io 线程数，默认 CPU 核数
+    const char* io_threads = std::getenv("AGG_IO_THREADS");
+    io_pool_ = std::make_unique<IoPool>(io_threads ? std::strtoul(io_threads, nullptr, 10) : 0);
+
+    std::cout << "Aggregator constructed, creating connectors for " << instruments_.size()
+              << " symbols..." << std::endl;
+    for (const VenueConfig& vc : config.venues) {
+        connectors_.push_back(make_connector(vc, this, io_pool_->next(), instruments_));
+        by_venue_[vc.venue] = connectors_.back().get();
+    }
+    std::cout << "Connectors created: " << connectors_.size() << std::endl;
+
+    const char* verify = std::getenv("AGG_VERIFY_MERGE");
+    verify_merge_ = verify && std::string(verify) == "1";
+
+    // AGG_MERGE_WINDOW_US：合并时间窗，0 表示合并线程空闲即合并
+    const char* window_us = std::getenv("AGG_MERGE_WINDOW_US");
+    std::chrono::microseconds window{window_us ? std::strtol(window_us, nullptr, 10) : 0};
+    // 过期检查间隔：没有任何新消息时也能及时排除停止推送的交易所
+    merge_scheduler_ = std::make_unique<MergeScheduler>(
+        instruments_, window, [this](size_t inst, uint32_t venues) { merge(inst, venues); },
+        std::chrono::milliseconds(100));
+    merge_scheduler_->start();
+
+    // AGG_REPLAY：回放录制文件而不连交易所；AGG_REPLAY_SPEED：1 原速（默认），0 不限速
+    const char* replay = std::getenv("AGG_REPLAY");
+    if (replay && *replay) {
+        const char* speed = std::getenv("AGG_REPLAY_SPEED");
+        replay_ = std::make_unique<ReplayConnector>(replay, speed ? std::strtod(speed, nullptr) : 1.0,
+                                                    by_venue_);
+    }
 }
 
-Aggregator::~Aggregator() = default;
+Aggregator::~Aggregator() {
+    // 先停回放、IO 线程和合并线程，之后 connector / service 析构时不会再有回调在跑
+    if (replay_) replay_->stop();
+    io_pool_->stop();
+    merge_scheduler_->stop();
+    if (metrics_server_) metrics_server_->stop();
+}
 
 void Aggregator::run_server() {
-    std::cout << "Starting connectors..." << std::endl;
-    binance_->start();  //level = 5; tz = 0.01 snap
-    okx_->start();   // level = 5; tz = 0.1; snap
-    bitget_->start();   // level = 39; tz = 0.01 snap
-    bybit_->start(); //level = 50; tz = 0.1; update new
-    std::cout << "Connectors started" << std::endl;
+    // AGG_METRICS_PORT：本机 Prometheus 指标端口，默认 9464，0 表示不开
+    const char* metrics_port = std::getenv("AGG_METRICS_PORT");
+    unsigned long port = metrics_port ? std::strtoul(metrics_port, nullptr, 10) : 9464;
+    if (port > 0) {
+        try {
+            metrics_server_ = std::make_unique<MetricsServer>(
+                static_cast<unsigned short>(port), [this] { return render_metrics(); });
+            metrics_server_->start();
+        } catch (const std::exception& e) {
+            std::cerr << "[Metrics] Failed to listen on 127.0.0.1:" << port << ": " << e.what() << std::endl;
+            metrics_server_.reset();
+        }
+    }
+
+    if (replay_) {
+        replay_->start();
+    } else {
+        std::cout << "Starting connectors..." << std::endl;
+        io_pool_->start();
+        for (auto& c : connectors_) c->start();
+        std::cout << "Connectors started" << std::endl;
+    }
 
     grpc::ServerBuilder builder;
     builder.AddListeningPort("0.0.0.0:50051", grpc::InsecureServerCredentials());
@@ -34,111 +99,953 @@ void Aggregator::run_server() {
     grpc_server_->Wait();
 }
 
-void Aggregator::on_book_updated(Connector* connector) {
+void Aggregator::on_book_updated(Connector* connector, size_t inst) {
     // std::cout << "[Aggregator] on_book_updated called from " << connector->name_ << std::endl;
-    merge_books();
+    connector->publish_changes(inst);
+    merge_scheduler_->mark_dirty(inst, connector->venue_);
 }
 
-void Aggregator::merge_books() {
-    std::lock_guard<std::mutex> lock(consolidated_mutex_);
-    consolidated_bids_.clear();
-    consolidated_asks_.clear();
-
-    auto merge = [](auto& target, const auto& source) {
-        for (const auto& [price, qty] : source) {
-            target[price] += qty;
-        }
-    };
-
-    merge(consolidated_bids_, binance_->get_bids_snapshot());
-    merge(consolidated_asks_, binance_->get_asks_snapshot());
+void Aggregator::on_feed_down(Connector* connector) {
+    for (size_t i = 0; i < instruments_.size(); ++i) {
+        merge_scheduler_->mark_dirty(i, connector->venue_);
+    }
+}
 
-    // 如果启用其他 connector，取消注释并使用 snapshot
-    merge(consolidated_bids_, okx_->get_bids_snapshot());
-    merge(consolidated_asks_, okx_->get_asks_snapshot());
-    merge(consolidated_bids_, bitget_->get_bids_snapshot());
-    merge(consolidated_asks_, bitget_->get_asks_snapshot());
-    merge(consolidated_bids_, bybit_->get_bids_snapshot());
-    merge(consolidated_asks_, bybit_->get_asks_snapshot());
+void Aggregator::on_book_down(Connector* connector, size_t inst) {
+    // live_ns 已清零，合并时按过期排除
+    merge_scheduler_->mark_dirty(inst, connector->venue_);
+}
 
-    aggregator::BookUpdate update;
-    update.set_timestamp_ms(std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::system_clock::now().time_since_epoch()).count());
+void Aggregator::merge(size_t inst, uint32_t venues) {
+    ConsolidatedBook& book = *books_[inst];
+    const int64_t tick_units = instruments_[inst].tick_units;
 
-    // 填充 bids (top 100 for gRPC)
-    int count = 0;
-    for (const auto& [price, qty] : consolidated_bids_) {
-        if (count++ >= 100) break;
-        auto* lvl = update.add_bids();
-        lvl->set_price(price);
-        lvl->set_quantity(qty);
+    std::lock_guard<std::mutex> lock(book.mutex);
+    const int64_t merge_start = mono_ns();
+    int64_t origin_ns = 0;  // 本次合并的变化中最早一帧的收到时间
+    bool changed = false;
+    // 先按各交易所的最近消息时间调整排除集合
+    uint32_t excluded = book.excluded.load(std::memory_order_relaxed);
+    for (const auto& c : connectors_) {
+        const Venue v = c->venue_;
+        const uint32_t bit = 1u << v;
+        const bool live = c->live(inst, merge_start);
+        if (!live) book.out_of_range &= ~bit;
+        if (live == !(excluded & bit)) continue;
+        if (live) {
+            // 价格离合并簿里其他交易所太远时继续排除，每次合并重试（只检查两端），回到范围内再加回
+            if (!include_venue(book, *c, inst, venue_levels_)) {
+                if (!(book.out_of_range & bit)) {
+                    book.out_of_range |= bit;
+                    exclusions_[v].fetch_add(1, std::memory_order_relaxed);
+                    std::cerr << "[Aggregator] " << venue_label(v) << " " << instruments_[inst].symbol
+                              << " prices too far from the other venues, kept out of the merge" << std::endl;
+                }
+                continue;
+            }
+            book.out_of_range &= ~bit;
+            excluded &= ~bit;
+            std::cout << "[Aggregator] " << venue_label(v) << " " << instruments_[inst].symbol
+                      << " joined the merge" << std::endl;
+        } else {
+            exclude_venue(book, v, venue_levels_);
+            excluded |= bit;
+            exclusions_[v].fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "[Aggregator] " << venue_label(v) << " " << instruments_[inst].symbol
+                      << " stale or disconnected, left the merge" << std::endl;
+        }
+        changed = true;
+    }
+    // 窗口内同一交易所的多批变化按到达顺序依次应用
+    for (const auto& c : connectors_) {
+        const Venue v = c->venue_;
+        if (!(venues & (1u << v))) continue;
+        if (excluded & (1u << v)) {
+            c->drain_changes(inst, [](const ChangeBatch&) {});  // 恢复时整本加回，不需要这些变化
+            continue;
+        }
+        changed = true;
+        bool in_range = true;
+        c->drain_changes(inst, [&](const ChangeBatch& batch) {
+            if (!in_range) return;
+            book.venues[v] = batch.stamp;
+            if (batch.recv_ns > 0) {
+                latency_.parse[v].record(batch.parsed_ns - batch.recv_ns);
+                latency_.queue[v].record(merge_start - batch.parsed_ns);
+                if (origin_ns == 0 || batch.recv_ns < origin_ns) origin_ns = batch.recv_ns;
+            }
+            in_range = apply_changes(book, v, batch.changes);
+        });
+        if (!in_range) {
+            // 新价位离其他交易所太远，合并簿窗口放不下：整体排除，已应用的部分一并减掉
+            exclude_venue(book, v, venue_levels_);
+            excluded |= 1u << v;
+            book.out_of_range |= 1u << v;
+            exclusions_[v].fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "[Aggregator] " << venue_label(v) << " " << instruments_[inst].symbol
+                      << " prices too far from the other venues, left the merge" << std::endl;
+        }
+    }
+    book.excluded.store(excluded, std::memory_order_relaxed);
+    if (!changed) {
+        // 定时检查：簿安静下来时，把节流间隔内压下的最后一次变化补发出去。
+        // 档位订阅刚加入时索引可能还没建，先补上（没有改动时 refresh 直接返回）
+        if (service_.wants_depth(inst)) refresh_depth(book);
+        service_.flush(inst, book);
+        return;
     }
+    net_crossed(book);
+    if (book.netting.crossed) book.crossed_merges.fetch_add(1, std::memory_order_relaxed);
+    // 有档位订阅时每次合并都要用索引；否则只记改动，留给查询时再 refresh
+    if (service_.wants_depth(inst)) refresh_depth(book);
+    const int64_t merge_end = mono_ns();
+    latency_.merge.record(merge_end - merge_start);
 
-    // 填充 asks (top 100 for gRPC)
-    count = 0;
-    for (const auto& [price, qty] : consolidated_asks_) {
-        if (count++ >= 100) break;
-        auto* lvl = update.add_asks();
-        lvl->set_price(price);
-        lvl->set_quantity(qty);
+    if (verify_merge_) {
+        verify_consolidated(inst);
     }
 
     if(0){
         // <--- 新增：打印完整合并深度（所有层级，无 top 限制）
         std::cout << "\n>>> 合并后 Consolidated Book (Full Depth) <<<\n";
         std::cout << std::fixed << std::setprecision(2);  // 价格2位
-        std::cout << "Bids (买盘 - 高到低, 共 " << consolidated_bids_.size() << " 层):\n";
+        std::cout << "Bids (买盘 - 高到低, 共 " << book.bids.size() << " 层):\n";
         int idx = 1;
-        for (const auto& [p, q] : consolidated_bids_) {
+        for (const auto& [p, q] : book.bids) {
             std::cout << std::setw(3) << idx++ << ": " << std::setw(12);
-            printf("bid: %10.1f,",p);
+            printf("bid: %10.1f,",ticks_to_price(p, tick_units));
             std::cout << " @ " << std::setprecision(10);
-            printf("%.8f\n",q);
+            printf("%.8f\n",quantity_to_double(q.total));
         }
 
-        std::cout << "\nAsks (卖盘 - 低到高, 共 " << consolidated_asks_.size() << " 层):\n";
+        std::cout << "\nAsks (卖盘 - 低到高, 共 " << book.asks.size() << " 层):\n";
         idx = 1;
-        for (const auto& [p, q] : consolidated_asks_) {
+        for (const auto& [p, q] : book.asks) {
             std::cout << std::setw(3) << idx++ << ": " << std::setw(12);
-            printf("ask: %10.1f,",p);
+            printf("ask: %10.1f,",ticks_to_price(p, tick_units));
             std::cout<< " @ " << std::setprecision(10);
-            printf("%.8f\n",q);
+            printf("%.8f\n",quantity_to_double(q.total));
         }
         std::cout << ">>> End of Full Depth <<<\n\n";
     }
-    service_.notify_all(update);
+    const int64_t publish_start = mono_ns();
+    service_.publish(inst, book, origin_ns);
+    latency_.publish.record(mono_ns() - publish_start);
+}
+
+std::string Aggregator::render_metrics() const {
+    std::string out = latency_.prometheus();
+    out += "# HELP agg_merge_notifications_total Venue updates handed to the merge thread.\n"
+           "# TYPE agg_merge_notifications_total counter\n";
+    std::string merges = "# HELP agg_merges_total Merges run (one publish each).\n"
+                         "# TYPE agg_merges_total counter\n";
+    for (size_t i = 0; i < instruments_.size(); ++i) {
+        MergeScheduler::Stats s = merge_scheduler_->stats(i);
+        const std::string label = "{symbol=\"" + instruments_[i].symbol + "\"} ";
+        out += "agg_merge_notifications_total" + label + std::to_string(s.notifications) + "\n";
+        merges += "agg_merges_total" + label + std::to_string(s.merges) + "\n";
+    }
+    out += merges;
+    out += "# HELP agg_crossed_merges_total Merges that left the consolidated book crossed or locked (tradable subscriptions get it netted).\n"
+           "# TYPE agg_crossed_merges_total counter\n";
+    for (size_t i = 0; i < instruments_.size(); ++i) {
+        out += "agg_crossed_merges_total{symbol=\"" + instruments_[i].symbol + "\"} " +
+               std::to_string(books_[i]->crossed_merges.load(std::memory_order_relaxed)) + "\n";
+    }
+    out += "# HELP agg_venue_resyncs_total Order books dropped for a sequence gap or bad update and rebuilt from a new snapshot.\n"
+           "# TYPE agg_venue_resyncs_total counter\n";
+    for (const auto& c : connectors_) {
+        out += "agg_venue_resyncs_total{venue=\"" + std::string(venue_label(c->venue_)) + "\"} " +
+               std::to_string(c->resyncs()) + "\n";
+    }
+    out += "# HELP agg_venue_checksum_failures_total Resyncs caused by a depth checksum mismatch (OKX, Bitget).\n"
+           "# TYPE agg_venue_checksum_failures_total counter\n";
+    for (const auto& c : connectors_) {
+        out += "agg_venue_checksum_failures_total{venue=\"" + std::string(venue_label(c->venue_)) + "\"} " +
+               std::to_string(c->checksum_failures()) + "\n";
+    }
+
+    // 各交易所的活跃度：帧数（求 rate 即消息速率）、最近一帧距今、读超时、重连、被排除次数
+    const int64_t now = mono_ns();
+    auto venue_metric = [&](const char* name, const char* type, const char* help, auto value) {
+        out += std::string("# HELP ") + name + " " + help + "\n# TYPE " + name + " " + type + "\n";
+        for (const auto& c : connectors_) {
+            out += std::string(name) + "{venue=\"" + venue_label(c->venue_) + "\"} " + value(*c) + "\n";
+        }
+    };
+    venue_metric("agg_venue_frames_total", "counter", "WebSocket frames received (incl. pongs).",
+                 [](const Connector& c) { return std::to_string(c.frames()); });
+    venue_metric("agg_venue_last_frame_age_seconds", "gauge", "Time since the last frame (-1 before the first).",
+                 [&](const Connector& c) {
+                     const int64_t t = c.last_frame_ns();
+                     return t ? std::to_string((now - t) / 1e9) : std::string("-1");
+                 });
+    venue_metric("agg_venue_read_timeouts_total", "counter", "Connections dropped after AGG_READ_TIMEOUT_MS without data.",
+                 [](const Connector& c) { return std::to_string(c.read_timeouts()); });
+    venue_metric("agg_venue_reconnects_total", "counter", "Reconnects scheduled (with jittered exponential backoff).",
+                 [](const Connector& c) { return std::to_string(c.reconnects()); });
+    venue_metric("agg_venue_exclusions_total", "counter", "Times a venue book was dropped from the merge as stale or disconnected.",
+                 [&](const Connector& c) { return std::to_string(exclusions_[c.venue_].load(std::memory_order_relaxed)); });
+    out += "# HELP agg_venue_excluded 1 while the venue is excluded from the symbol's consolidated book.\n"
+           "# TYPE agg_venue_excluded gauge\n";
+    for (size_t i = 0; i < instruments_.size(); ++i) {
+        const uint32_t excluded = books_[i]->excluded.load(std::memory_order_relaxed);
+        for (const auto& c : connectors_) {
+            out += "agg_venue_excluded{venue=\"" + std::string(venue_label(c->venue_)) + "\",symbol=\"" +
+                   instruments_[i].symbol + "\"} " + ((excluded >> c->venue_) & 1 ? "1" : "0") + "\n";
+        }
+    }
+
+    // 订阅积压：合计含已关闭的订阅，按 peer 的只列当前还开着的
+    std::map<std::string, SubscriberStats> by_peer;
+    const SubscriberStats total = service_.subscriber_stats(by_peer);
+    auto subscriber_metric = [&](const std::string& total_name, const std::string& peer_name, const char* help,
+                                 uint64_t SubscriberStats::*field) {
+        out += "# HELP " + total_name + " " + help + " All subscriptions, closed ones included.\n# TYPE " +
+               total_name + " counter\n" + total_name + " " + std::to_string(total.*field) + "\n";
+        out += "# HELP " + peer_name + " " + help + " Open subscriptions, summed per peer.\n# TYPE " + peer_name +
+               " counter\n";
+        for (const auto& [peer, stats] : by_peer) {
+            out += peer_name + "{peer=\"" + peer + "\"} " + std::to_string(stats.*field) + "\n";
+        }
+    };
+    subscriber_metric("agg_conflated_total", "agg_subscriber_conflated_total",
+                      "Updates overwritten in a lagging subscriber's queue (replaced by a snapshot for deltas).",
+                      &SubscriberStats::conflated);
+    subscriber_metric("agg_dropped_total", "agg_subscriber_dropped_total",
+                      "Updates still queued when a subscription closed.", &SubscriberStats::dropped);
+    return out;
+}
+
+aggregator::BookUpdate Aggregator::build_update(size_t inst) const {
+    const ConsolidatedBook& book = *books_[inst];
+    const int64_t tick_units = instruments_[inst].tick_units;
+    aggregator::BookUpdate update;
+    update.set_symbol(instruments_[inst].symbol);
+    update.set_timestamp_ms(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+
+    // 填充 bids (top 100 for gRPC)
+    int count = 0;
+    for (const auto& [price, lvl] : book.bids) {
+        if (count++ >= kTopLevels) break;
+        auto* out = update.add_bids();
+        out->set_price(ticks_to_price(price, tick_units));
+        out->set_quantity(quantity_to_double(lvl.total));
+    }
+
+    // 填充 asks (top 100 for gRPC)
+    count = 0;
+    for (const auto& [price, lvl] : book.asks) {
+        if (count++ >= kTopLevels) break;
+        auto* out = update.add_asks();
+        out->set_price(ticks_to_price(price, tick_units));
+        out->set_quantity(quantity_to_double(lvl.total));
+    }
+    return update;
+}
+
+// 调试用：取各 connector 的完整快照做一次全量合并，与增量结果比对。
+// 快照与其未合并的变化在同一把 book_mutex_ 下取出，避免比对时的竞态。
+void Aggregator::verify_consolidated(size_t inst) {
+    ConsolidatedBook& book = *books_[inst];
+    const int64_t tick_units = instruments_[inst].tick_units;
+    BidBook full_bids;
+    AskBook full_asks;
+    auto merge = [](auto& target, const auto& source) {
+        for (const auto& [price, qty] : source) {
+            target[price] += qty;
+        }
+    };
+    const uint32_t excluded = book.excluded.load(std::memory_order_relaxed);
+    for (const auto& c : connectors_) {
+        if (excluded & (1u << c->venue_)) continue;
+        // 持有 book_mutex_ 时 connector 不会改簿，已交出和未交出的变化都取完后两者一致
+        std::lock_guard<std::mutex> book_lock(c->book_mutex_);
+        VenueBook& vb = c->books_[inst];
+        c->drain_changes(inst, [&](const ChangeBatch& batch) {
+            apply_changes(book, c->venue_, batch.changes);
+        });
+        apply_changes(book, c->venue_, vb.changes);
+        vb.changes.clear();
+        merge(full_bids, vb.bids);
+        merge(full_asks, vb.asks);
+    }
+
+    aggregator::BookUpdate expected;
+    int count = 0;
+    for (const auto& [price, qty] : full_bids) {
+        if (count++ >= kTopLevels) break;
+        auto* lvl = expected.add_bids();
+        lvl->set_price(ticks_to_price(price, tick_units));
+        lvl->set_quantity(quantity_to_double(qty));
+    }
+    count = 0;
+    for (const auto& [price, qty] : full_asks) {
+        if (count++ >= kTopLevels) break;
+        auto* lvl = expected.add_asks();
+        lvl->set_price(ticks_to_price(price, tick_units));
+        lvl->set_quantity(quantity_to_double(qty));
+    }
+
+    auto same = [](const auto& a, const auto& b) {
+        if (a.size() != b.size()) return false;
+        for (int i = 0; i < a.size(); ++i) {
+            if (a[i].price() != b[i].price() || a[i].quantity() != b[i].quantity()) return false;
+        }
+        return true;
+    };
+    aggregator::BookUpdate current = build_update(inst);
+    if (!same(current.bids(), expected.bids()) || !same(current.asks(), expected.asks())) {
+        std::cerr << "[Aggregator] Incremental merge MISMATCH vs full merge" << std::endl;
+    }
 }
 
 // AggregatorServiceImpl 实现
-grpc::Status AggregatorServiceImpl::SubscribeBook(grpc::ServerContext* context,
-                                                 const aggregator::SubscribeRequest*,
-                                                 grpc::ServerWriter<aggregator::BookUpdate>* writer) {
-    add_subscriber(writer);
-    while (!context->IsCancelled()) std::this_thread::sleep_for(std::chrono::seconds(1));
-    remove_subscriber(writer);
+namespace {
+// 请求参数不合法时直接结束的流
+class RejectWriter final : public grpc::ServerWriteReactor<grpc::ByteBuffer> {
+public:
+    explicit RejectWriter(grpc::Status status) { Finish(std::move(status)); }
+    void OnDone() override { delete this; }
+};
+
+// raw 方法的请求反序列化。Deserialize 会清空传入的 buffer，先拷一份（只增加 slice 引用计数）
+template <typename Request>
+bool parse_request(const grpc::ByteBuffer* raw, Request& req) {
+    grpc::ByteBuffer copy(*raw);
+    return grpc::SerializationTraits<Request>::Deserialize(&copy, &req).ok();
+}
+
+// 与 gRPC 写 proto 消息时的序列化路径相同，只是提前到这里做一次
+template <typename Message>
+EncodedUpdate encode_message(const Message& msg, int64_t origin_ns, int64_t publish_ns) {
+    auto encoded = std::make_shared<EncodedMessage>();
+    bool own_buffer = false;
+    grpc::Status status = grpc::SerializationTraits<Message>::Serialize(msg, &encoded->buffer, &own_buffer);
+    if (!status.ok()) {
+        throw std::runtime_error(msg.GetTypeName() + " serialize failed: " + status.error_message());
+    }
+    encoded->origin_ns = origin_ns;
+    encoded->publish_ns = publish_ns;
+    return encoded;
+}
+
+int64_t unix_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 档位请求里的阈值个数上限
+constexpr int kMaxBands = 32;
+}  // namespace
+
+grpc::Status AggregatorServiceImpl::find_instrument(const std::string& symbol, size_t& instrument) const {
+    instrument = 0;
+    if (symbol.empty()) return grpc::Status::OK;
+    auto it = std::find_if(instruments_->begin(), instruments_->end(),
+                           [&](const Instrument& inst) { return inst.symbol == symbol; });
+    if (it == instruments_->end()) {
+        return grpc::Status(grpc::StatusCode::NOT_FOUND, "unknown symbol: " + symbol);
+    }
+    instrument = it - instruments_->begin();
     return grpc::Status::OK;
 }
 
-void AggregatorServiceImpl::add_subscriber(grpc::ServerWriter<aggregator::BookUpdate>* w) {
+grpc::ServerWriteReactor<grpc::ByteBuffer>* AggregatorServiceImpl::SubscribeBook(
+        grpc::CallbackServerContext* context, const grpc::ByteBuffer* raw) {
+    aggregator::SubscribeRequest req;
+    if (!parse_request(raw, req)) {
+        return new RejectWriter(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                                             "malformed SubscribeRequest"));
+    }
+    const aggregator::SubscribeRequest* request = &req;
+
+    // symbol 为空时默认第一个交易对，兼容旧客户端
+    FeedOptions options;
+    grpc::Status status = find_instrument(request->symbol(), options.instrument);
+    if (!status.ok()) return new RejectWriter(status);
+    // max_depth 为 0 或超过上限时按 kTopLevels
+    if (request->max_depth() > 0 && request->max_depth() < static_cast<uint32_t>(kTopLevels)) {
+        options.depth = static_cast<int>(request->max_depth());
+    }
+    options.deltas = request->deltas();
+    options.on_change_only = request->on_change_only();
+    options.venue_breakdown = request->venue_breakdown();
+    options.tradable = request->tradable();
+    options.min_interval = std::chrono::milliseconds(request->min_interval_ms());
+
+    auto* writer = new BookWriter(this, context->peer(), options.deltas);  // OnDone 中释放
+    add_subscriber(writer, options);
+    return writer;
+}
+
+grpc::ServerWriteReactor<grpc::ByteBuffer>* AggregatorServiceImpl::SubscribeVolumeBands(
+        grpc::CallbackServerContext* context, const grpc::ByteBuffer* raw) {
+    aggregator::VolumeBandsRequest req;
+    if (!parse_request(raw, req)) {
+        return new RejectWriter(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                                             "malformed VolumeBandsRequest"));
+    }
+    BandOptions options;
+    grpc::Status status = find_instrument(req.symbol(), options.instrument);
+    if (!status.ok()) return new RejectWriter(status);
+    if (req.notionals_size() > kMaxBands) {
+        return new RejectWriter(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "too many notionals"));
+    }
+    for (double notional : req.notionals()) {
+        if (!(notional > 0) || notional > 1e15) {
+            return new RejectWriter(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                                                 "notionals must be positive"));
+        }
+    }
+    options.thresholds.assign(req.notionals().begin(), req.notionals().end());
+    if (options.thresholds.empty()) options.thresholds = {1e4, 1e5, 1e6, 5e6, 1e7, 2.5e7, 5e7};
+    options.min_interval = std::chrono::milliseconds(req.min_interval_ms());
+
+    auto* writer = new BookWriter(this, context->peer(), false);  // OnDone 中释放
+    add_subscriber(writer, options);
+    return writer;
+}
+
+grpc::ServerWriteReactor<grpc::ByteBuffer>* AggregatorServiceImpl::SubscribePriceBands(
+        grpc::CallbackServerContext* context, const grpc::ByteBuffer* raw) {
+    aggregator::PriceBandsRequest req;
+    if (!parse_request(raw, req)) {
+        return new RejectWriter(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                                             "malformed PriceBandsRequest"));
+    }
+    BandOptions options;
+    options.price_bands = true;
+    grpc::Status status = find_instrument(req.symbol(), options.instrument);
+    if (!status.ok()) return new RejectWriter(status);
+    if (req.bps_size() > kMaxBands) {
+        return new RejectWriter(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "too many bps"));
+    }
+    for (uint32_t bps : req.bps()) {
+        if (bps == 0 || bps > 10000) {
+            return new RejectWriter(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                                                 "bps must be within 1..10000"));
+        }
+    }
+    options.thresholds.assign(req.bps().begin(), req.bps().end());
+    if (options.thresholds.empty()) options.thresholds = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+    options.min_interval = std::chrono::milliseconds(req.min_interval_ms());
+
+    auto* writer = new BookWriter(this, context->peer(), false);  // OnDone 中释放
+    add_subscriber(writer, options);
+    return writer;
+}
+
+grpc::ServerUnaryReactor* AggregatorServiceImpl::QueryImpact(
+        grpc::CallbackServerContext* context, const aggregator::ImpactRequest* request,
+        aggregator::ImpactResponse* response) {
+    auto* reactor = context->DefaultReactor();
+    size_t inst = 0;
+    grpc::Status status = find_instrument(request->symbol(), inst);
+    if (!status.ok()) {
+        reactor->Finish(status);
+        return reactor;
+    }
+    // quantity 与 notional 恰好给一个
+    const bool by_qty = request->quantity() > 0;
+    const bool by_notional = request->notional() > 0;
+    const Quantity qty = by_qty && request->quantity() < 1e10
+                             ? static_cast<Quantity>(std::llround(request->quantity() * kDecimalScale))
+                             : 0;
+    if (by_qty == by_notional || (by_qty && qty <= 0) || !(request->notional() < 1e15)) {
+        reactor->Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                                     "exactly one of quantity / notional must be positive"));
+        return reactor;
+    }
+
+    const Instrument& instrument = (*instruments_)[inst];
+    ConsolidatedBook& book = *(*books_)[inst];
+    Sweep sweep;
+    PriceTicks best = 0;
+    {
+        std::lock_guard<std::mutex> lock(book.mutex);
+        refresh_depth(book);
+        // 买入吃卖盘，卖出吃买盘
+        const DepthView side = tradable_depth(book, !request->buy());
+        if (!side.empty()) best = side.price(0);
+        sweep = by_qty ? side.sweep_qty(qty) : side.sweep_notional(request->notional());
+    }
+
+    response->set_symbol(instrument.symbol);
+    response->set_timestamp_ms(unix_ms());
+    response->set_filled(sweep.filled);
+    response->set_quantity(sweep.qty);
+    response->set_notional(sweep.notional);
+    response->set_levels(static_cast<uint32_t>(sweep.levels));
+    if (sweep.levels > 0) {
+        response->set_average_price(sweep.notional / sweep.qty);
+        response->set_worst_price(ticks_to_price(sweep.worst, instrument.tick_units));
+        response->set_best_price(ticks_to_price(best, instrument.tick_units));
+    }
+    reactor->Finish(grpc::Status::OK);
+    return reactor;
+}
+
+void AggregatorServiceImpl::set_instruments(const std::vector<Instrument>* instruments,
+                                            std::chrono::milliseconds snapshot_interval) {
+    std::lock_guard<std::mutex> lock(subscribers_mutex_);
+    instruments_ = instruments;
+    snapshot_interval_ = snapshot_interval;
+    feeds_.resize(instruments->size());
+    band_feeds_.resize(instruments->size());
+    band_users_ = std::make_unique<std::atomic<int>[]>(instruments->size());
+}
+
+void AggregatorServiceImpl::add_subscriber(BookWriter* w, const FeedOptions& options) {
     std::lock_guard<std::mutex> lock(subscribers_mutex_);
-    subscribers_.push_back(w);
+    auto& feeds = feeds_[options.instrument];
+    auto it = std::find_if(feeds.begin(), feeds.end(),
+                           [&](const auto& f) { return f->options() == options; });
+    if (it == feeds.end()) {
+        feeds.push_back(std::make_unique<BookFeed>(options, (*instruments_)[options.instrument],
+                                                   snapshot_interval_));
+        it = feeds.end() - 1;
+    }
+    BookFeed* feed = it->get();
+    feed->writers().push_back(w);
+    w->set_feed(feed);
+    // 与 publish 同一把锁，保证快照之后的增量序号连续
+    // 补发的快照不计延迟：复制一份不带打点的（ByteBuffer 复制只增加 slice 引用计数）
+    if (auto snapshot = feed->snapshot()) {
+        w->push(std::make_shared<EncodedMessage>(EncodedMessage{snapshot->buffer, 0, 0}));
+    }
+}
+
+void AggregatorServiceImpl::add_subscriber(BookWriter* w, const BandOptions& options) {
+    std::lock_guard<std::mutex> lock(subscribers_mutex_);
+    auto& feeds = band_feeds_[options.instrument];
+    auto it = std::find_if(feeds.begin(), feeds.end(),
+                           [&](const auto& f) { return f->options() == options; });
+    if (it == feeds.end()) {
+        feeds.push_back(std::make_unique<BandFeed>(options, (*instruments_)[options.instrument]));
+        band_users_[options.instrument].fetch_add(1, std::memory_order_relaxed);
+        it = feeds.end() - 1;
+    }
+    BandFeed* feed = it->get();
+    feed->writers().push_back(w);
+    w->set_band_feed(feed);
+    if (auto last = feed->snapshot()) {
+        w->push(std::make_shared<EncodedMessage>(EncodedMessage{last->buffer, 0, 0}));
+    }
+}
+
+void AggregatorServiceImpl::remove_subscriber(BookWriter* w) {
+    std::lock_guard<std::mutex> lock(subscribers_mutex_);
+    const SubscriberStats stats = w->stats();
+    closed_stats_.conflated += stats.conflated;
+    closed_stats_.dropped += stats.dropped;
+    if (BandFeed* feed = w->band_feed()) {
+        auto& writers = feed->writers();
+        writers.erase(std::remove(writers.begin(), writers.end(), w), writers.end());
+        if (writers.empty()) {
+            const size_t inst = feed->options().instrument;
+            auto& feeds = band_feeds_[inst];
+            feeds.erase(std::remove_if(feeds.begin(), feeds.end(),
+                                       [&](const auto& f) { return f.get() == feed; }),
+                        feeds.end());
+            band_users_[inst].fetch_sub(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+    BookFeed* feed = w->feed();
+    auto& writers = feed->writers();
+    writers.erase(std::remove(writers.begin(), writers.end(), w), writers.end());
+    if (writers.empty()) {
+        auto& feeds = feeds_[feed->options().instrument];
+        feeds.erase(std::remove_if(feeds.begin(), feeds.end(),
+                                   [&](const auto& f) { return f.get() == feed; }),
+                    feeds.end());
+    }
 }
 
-void AggregatorServiceImpl::remove_subscriber(grpc::ServerWriter<aggregator::BookUpdate>* w) {
+SubscriberStats AggregatorServiceImpl::subscriber_stats(std::map<std::string, SubscriberStats>& by_peer) const {
     std::lock_guard<std::mutex> lock(subscribers_mutex_);
-    subscribers_.erase(std::remove(subscribers_.begin(), subscribers_.end(), w), subscribers_.end());
+    SubscriberStats total = closed_stats_;
+    auto add = [&](const std::vector<BookWriter*>& writers) {
+        for (BookWriter* w : writers) {
+            const SubscriberStats stats = w->stats();
+            SubscriberStats& peer = by_peer[w->peer()];
+            peer.conflated += stats.conflated;
+            peer.dropped += stats.dropped;
+            total.conflated += stats.conflated;
+            total.dropped += stats.dropped;
+        }
+    };
+    for (const auto& feeds : feeds_) {
+        for (const auto& feed : feeds) add(feed->writers());
+    }
+    for (const auto& feeds : band_feeds_) {
+        for (const auto& feed : feeds) add(feed->writers());
+    }
+    return total;
 }
 
-void AggregatorServiceImpl::notify_all(const aggregator::BookUpdate& update) {
-    // std::cout << "notify_all called! Pushing update with " 
-    //           << update.bids_size() << " bids / " << update.asks_size() << " asks to " 
-    //           << subscribers_.size() << " subscribers" << std::endl;
+void AggregatorServiceImpl::publish(size_t instrument, const ConsolidatedBook& book, int64_t origin_ns) {
+    // 只入队，不在行情线程里做任何阻塞写
+    std::lock_guard<std::mutex> lock(subscribers_mutex_);
+    for (auto& feed : feeds_[instrument]) {
+        feed->publish(book, origin_ns);
+    }
+    // 档位订阅刚加入、本次合并还没 refresh 索引时，等下一次合并
+    if (book.bid_depth.dirty() || book.ask_depth.dirty()) return;
+    for (auto& feed : band_feeds_[instrument]) {
+        feed->publish(book, origin_ns);
+    }
+}
 
+void AggregatorServiceImpl::flush(size_t instrument, const ConsolidatedBook& book) {
+    const auto now = PublishThrottle::Clock::now();
     std::lock_guard<std::mutex> lock(subscribers_mutex_);
-    for (auto it = subscribers_.begin(); it != subscribers_.end(); ) {
-        if (!(*it)->Write(update)) it = subscribers_.erase(it);
-        else ++it;
+    for (auto& feed : feeds_[instrument]) {
+        if (feed->due(now)) feed->publish(book, 0);
+    }
+    // 索引还没 refresh 时档位 feed 保持待发，留到下一次检查（与 publish 相同）
+    if (book.bid_depth.dirty() || book.ask_depth.dirty()) return;
+    for (auto& feed : band_feeds_[instrument]) {
+        if (feed->due(now)) feed->publish(book, 0);
+    }
+}
+
+// BandFeed 实现
+void BandFeed::publish(const ConsolidatedBook& book, int64_t origin_ns) {
+    auto now = std::chrono::steady_clock::now();
+    // 节流：间隔内的变化记为待发，到期后由下一次合并或定时检查补发
+    if (!throttle_.admit(now, origin_ns)) return;
+
+    compute(book);
+    if (published_ && cur_ == bands_ && std::equal(std::begin(cur_best_), std::end(cur_best_), std::begin(best_))) {
+        return;
+    }
+    bands_.swap(cur_);
+    std::copy(std::begin(cur_best_), std::end(cur_best_), std::begin(best_));
+    ++sequence_;
+    published_ = true;
+    throttle_.sent(now);
+    last_ = encode(origin_ns);
+    for (BookWriter* w : writers_) w->push(last_);
+}
+
+// 每个档位在可成交视图的前缀和上二分一次，与档数无关
+void BandFeed::compute(const ConsolidatedBook& book) {
+    const DepthView bids = tradable_depth(book, true);
+    const DepthView asks = tradable_depth(book, false);
+    cur_.assign(options_.thresholds.size(), BandLevel{});
+    cur_best_[0] = cur_best_[1] = 0;
+
+    if (!options_.price_bands) {
+        for (size_t k = 0; k < options_.thresholds.size(); ++k) {
+            const size_t b = bids.reach_notional(options_.thresholds[k]);
+            const size_t a = asks.reach_notional(options_.thresholds[k]);
+            if (b < bids.size()) cur_[k].bid_price = bids.price(b);
+            if (a < asks.size()) cur_[k].ask_price = asks.price(a);
+        }
+        return;
+    }
+
+    if (bids.empty() || asks.empty()) {
+        cur_.clear();
+        return;
+    }
+    cur_best_[0] = bids.price(0);
+    cur_best_[1] = asks.price(0);
+    // 在 tick 上计算目标价：mid = (买一 + 卖一) / 2，容差吸收浮点误差
+    const double mid = (cur_best_[0] + cur_best_[1]) / 2.0;
+    for (size_t k = 0; k < options_.thresholds.size(); ++k) {
+        const double offset = mid * options_.thresholds[k] / 10000.0;
+        const auto bid_limit = static_cast<PriceTicks>(std::floor(mid - offset + 1e-6));
+        const auto ask_limit = static_cast<PriceTicks>(std::ceil(mid + offset - 1e-6));
+        const size_t b = bids.first_at_or_worse(bid_limit);
+        const size_t a = asks.first_at_or_worse(ask_limit);
+        if (b < bids.size()) {
+            cur_[k].bid_price = bids.price(b);
+            cur_[k].bid_qty = bids.qty(b);
+        }
+        if (a < asks.size()) {
+            cur_[k].ask_price = asks.price(a);
+            cur_[k].ask_qty = asks.qty(a);
+        }
+    }
+}
+
+EncodedUpdate BandFeed::encode(int64_t origin_ns) const {
+    const int64_t tick = instrument_.tick_units;
+    auto price = [tick](PriceTicks p) { return p ? ticks_to_price(p, tick) : 0.0; };
+    if (!options_.price_bands) {
+        aggregator::VolumeBandsUpdate msg;
+        msg.set_symbol(instrument_.symbol);
+        msg.set_timestamp_ms(unix_ms());
+        msg.set_sequence(sequence_);
+        for (size_t k = 0; k < bands_.size(); ++k) {
+            auto* out = msg.add_bands();
+            out->set_notional(options_.thresholds[k]);
+            out->set_bid_price(price(bands_[k].bid_price));
+            out->set_ask_price(price(bands_[k].ask_price));
+        }
+        return encode_message(msg, origin_ns, mono_ns());
     }
-    // std::cout<<"test3"<<std::endl;
+    aggregator::PriceBandsUpdate msg;
+    msg.set_symbol(instrument_.symbol);
+    msg.set_timestamp_ms(unix_ms());
+    msg.set_sequence(sequence_);
+    msg.set_best_bid(price(best_[0]));
+    msg.set_best_ask(price(best_[1]));
+    for (size_t k = 0; k < bands_.size(); ++k) {
+        auto* out = msg.add_bands();
+        out->set_bps(static_cast<uint32_t>(options_.thresholds[k]));
+        out->set_bid_price(price(bands_[k].bid_price));
+        out->set_bid_quantity(quantity_to_double(bands_[k].bid_qty));
+        out->set_ask_price(price(bands_[k].ask_price));
+        out->set_ask_quantity(quantity_to_double(bands_[k].ask_qty));
+    }
+    return encode_message(msg, origin_ns, mono_ns());
+}
+
+// BookFeed 实现
+void BookFeed::publish(const ConsolidatedBook& book, int64_t origin_ns) {
+    EncodedUpdate msg = next(book, origin_ns);
+    if (!msg) return;
+    for (BookWriter* w : writers_) {
+        if (!w->push(msg)) w->resync(snapshot());
+    }
+}
+
+EncodedUpdate BookFeed::next(const ConsolidatedBook& book, int64_t origin_ns) {
+    auto now = std::chrono::steady_clock::now();
+    // 节流：间隔内的变化记为待发，到期后由下一次合并或定时检查（簿没有新变化时）一起推送
+    if (!throttle_.admit(now, origin_ns)) return nullptr;
+
+    // tradable 订阅跳过对冲掉的价位，部分对冲的一档用剩余数量
+    const bool net = options_.tradable && book.netting.crossed;
+    auto collect = [&](const auto& side, const NettedSide& netted, bool is_bid, std::vector<TopLevel>& out) {
+        out.clear();
+        for (const auto& [price, lvl] : side) {
+            if (static_cast<int>(out.size()) >= options_.depth) break;
+            if (net && (is_bid ? price > netted.price : price < netted.price)) continue;
+            if (net && price == netted.price && netted.partial) {
+                out.push_back(netted.level);
+                if (!options_.venue_breakdown) out.back() = TopLevel{price, netted.level.qty};
+                continue;
+            }
+            out.push_back({price, lvl.total});
+            if (options_.venue_breakdown) {
+                out.back().venue_mask = lvl.venue_mask;
+                std::copy(std::begin(lvl.qty), std::end(lvl.qty), std::begin(out.back().venue_qty));
+            }
+        }
+    };
+    collect(book.bids, book.netting.bids, true, cur_bids_);
+    collect(book.asks, book.netting.asks, false, cur_asks_);
+
+    // 与上次推送的前 depth 档比对；两边都按最优价在前排序，归并一遍找出新增/修改/移出的价位
+    aggregator::BookUpdate delta;
+    // venue_breakdown 时总量不变、只是各交易所之间的分布变了也算变化
+    auto same = [&](const TopLevel& a, const TopLevel& b) {
+        if (a.qty != b.qty) return false;
+        return !options_.venue_breakdown ||
+               (a.venue_mask == b.venue_mask &&
+                std::equal(std::begin(a.venue_qty), std::end(a.venue_qty), std::begin(b.venue_qty)));
+    };
+    auto diff = [&](const std::vector<TopLevel>& last, const std::vector<TopLevel>& cur, bool is_bid) {
+        auto better = [is_bid](PriceTicks a, PriceTicks b) { return is_bid ? a > b : a < b; };
+        size_t i = 0, j = 0;
+        while (i < last.size() || j < cur.size()) {
+            if (j == cur.size() || (i < last.size() && better(last[i].price, cur[j].price))) {
+                add_level(delta, is_bid, TopLevel{last[i++].price, 0});
+            } else if (i == last.size() || better(cur[j].price, last[i].price)) {
+                add_level(delta, is_bid, cur[j]);
+                ++j;
+            } else {
+                if (!same(last[i], cur[j])) add_level(delta, is_bid, cur[j]);
+                ++i;
+                ++j;
+            }
+        }
+    };
+    diff(top_bids_, cur_bids_, true);
+    diff(top_asks_, cur_asks_, false);
+    const bool changed = delta.bids_size() > 0 || delta.asks_size() > 0;
+
+    if (published_ && !changed && (options_.on_change_only || options_.deltas)) return nullptr;
+
+    // 前 depth 档有变化才推进序号；增量流首次推送和到了快照间隔时发完整快照
+    if (changed) ++sequence_;
+    top_bids_.swap(cur_bids_);
+    top_asks_.swap(cur_asks_);
+    snapshot_.reset();
+    throttle_.sent(now);
+    published_ = true;
+    origin_ns_ = origin_ns;
+    publish_ns_ = mono_ns();
+    std::copy(std::begin(book.venues), std::end(book.venues), std::begin(venues_));
+
+    if (!options_.deltas || now - last_snapshot_ >= snapshot_interval_) {
+        if (options_.deltas) last_snapshot_ = now;
+        return snapshot();
+    }
+    delta.set_symbol(instrument_.symbol);
+    delta.set_timestamp_ms(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    delta.set_sequence(sequence_);
+    fill_venues(delta);
+    return encode(delta);
+}
+
+EncodedUpdate BookFeed::snapshot() {
+    if (!published_) return nullptr;
+    if (!snapshot_) {
+        aggregator::BookUpdate msg;
+        msg.set_symbol(instrument_.symbol);
+        msg.set_timestamp_ms(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        msg.set_sequence(sequence_);
+        msg.set_snapshot(true);
+        fill(msg, top_bids_, top_asks_);
+        fill_venues(msg);
+        snapshot_ = encode(msg);
+    }
+    return snapshot_;
+}
+
+EncodedUpdate BookFeed::encode(const aggregator::BookUpdate& msg) const {
+    return encode_message(msg, origin_ns_, publish_ns_);
+}
+
+void BookFeed::fill(aggregator::BookUpdate& msg, const std::vector<TopLevel>& bids,
+                    const std::vector<TopLevel>& asks) const {
+    for (const auto& lvl : bids) add_level(msg, true, lvl);
+    for (const auto& lvl : asks) add_level(msg, false, lvl);
+}
+
+void BookFeed::add_level(aggregator::BookUpdate& msg, bool is_bid, const TopLevel& lvl) const {
+    auto* out = is_bid ? msg.add_bids() : msg.add_asks();
+    out->set_price(ticks_to_price(lvl.price, instrument_.tick_units));
+    out->set_quantity(quantity_to_double(lvl.qty));
+    if (options_.venue_breakdown && lvl.venue_mask) {
+        out->set_venue_mask(lvl.venue_mask);
+        for (int v = 0; v < kVenueCount; ++v) {
+            if (lvl.venue_mask & (1u << v)) out->add_venue_quantities(quantity_to_double(lvl.venue_qty[v]));
+        }
+    }
+}
+
+void BookFeed::fill_venues(aggregator::BookUpdate& msg) const {
+    for (int v = 0; v < kVenueCount; ++v) {
+        const VenueStamp& s = venues_[v];
+        if (s.recv_unix_ns == 0) continue;
+        auto* out = msg.add_venues();
+        out->set_venue(venue_label(v));
+        out->set_event_time_ms(s.event_ms);
+        out->set_receive_time_ns(s.recv_unix_ns);
+        out->set_sequence(s.sequence);
+    }
+}
+
+// BookWriter 实现：StartWrite/Finish 都在锁外调用，避免与内联执行的回调互锁
+bool BookWriter::push(const EncodedUpdate& msg) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closing_) return true;
+        if (writing_) {
+            if (queue_.size() >= kQueueCapacity) {
+                if (deltas_) return false;
+                queue_.pop_front();
+                ++conflated_;
+            }
+            queue_.push_back(msg);
+            return true;
+        }
+        writing_ = true;
+        in_flight_ = msg;
+    }
+    StartWrite(&in_flight_->buffer);
+    return true;
+}
+
+void BookWriter::resync(const EncodedUpdate& snapshot) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closing_) return;
+        conflated_ += queue_.size();
+        queue_.clear();
+        // push 返回 false 之后在途的写可能已经完成
+        if (writing_) {
+            queue_.push_back(snapshot);
+            return;
+        }
+        writing_ = true;
+        in_flight_ = snapshot;
+    }
+    StartWrite(&in_flight_->buffer);
+}
+
+void BookWriter::OnWriteDone(bool ok) {
+    bool start = false;
+    bool finish = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ok) {
+            ++delivered_;
+            LatencyMetrics* latency = service_->latency();
+            if (latency && in_flight_ && in_flight_->origin_ns > 0) {
+                const int64_t now = mono_ns();
+                latency->write.record(now - in_flight_->publish_ns);
+                latency->total.record(now - in_flight_->origin_ns);
+            }
+        } else {
+            closing_ = true;
+        }
+
+        if (closing_) {
+            writing_ = false;
+            in_flight_.reset();
+            dropped_ += queue_.size();
+            queue_.clear();
+            finish = !finished_;
+            finished_ = true;
+        } else if (!queue_.empty()) {
+            in_flight_ = std::move(queue_.front());
+            queue_.pop_front();
+            start = true;
+        } else {
+            writing_ = false;
+            in_flight_.reset();
+        }
+    }
+    if (start) StartWrite(&in_flight_->buffer);
+    else if (finish) Finish(grpc::Status::OK);
+}
+
+void BookWriter::OnCancel() {
+    bool finish = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+        // 有写在途时等 OnWriteDone 再 Finish
+        if (!writing_ && !finished_) {
+            dropped_ += queue_.size();
+            queue_.clear();
+            finished_ = true;
+            finish = true;
+        }
+    }
+    if (finish) Finish(grpc::Status::CANCELLED);
+}
+
+SubscriberStats BookWriter::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {conflated_, dropped_};
+}
 
+void BookWriter::OnDone() {
+    service_->remove_subscriber(this);
+    std::cout << "[Aggregator] Subscriber " << peer_ << " closed: delivered "
+              << delivered_ << ", conflated " << conflated_
+              << ", dropped " << dropped_ << std::endl;
+    delete this;
 }
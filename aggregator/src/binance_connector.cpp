@@ -2,33 +2,38 @@
 #include <nlohmann/json.hpp>
 #include <iostream>
 #include <iomanip>
+#include <cctype>
+#include <algorithm>
 
-#include "aggregator.h"
+#include "depth_parser.h"
 
 using json = nlohmann::json;
 using namespace std;
 
-BinanceConnector::BinanceConnector(Aggregator* aggregator)
-    : Connector(aggregator, "Binance",0.1) {}
+BinanceConnector::BinanceConnector(BookListener* aggregator, net::io_context& ioc, const std::vector<Instrument>& instruments)
+    : Connector(aggregator, ioc, "Binance", kBinance, instruments) {
+    for (const auto& inst : instruments) {
+        std::string s = inst.base + inst.quote;
+        for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        venue_symbols_.push_back(s);  // btcusdt
+    }
+    sync_.resize(instruments.size());
+}
 
-void BinanceConnector::parse_message(const std::string& msg) {
+void BinanceConnector::parse_message(std::string_view msg) {
     // <--- 新增：过滤 pong 响应（常见格式）
-    std::string trimmed = msg;
-    // 去除空白字符
-    trimmed.erase(std::remove_if(trimmed.begin(), trimmed.end(), ::isspace), trimmed.end());
-
-    if (trimmed == "pong" ||
-        trimmed == "{\"pong\":true}" ||
-        trimmed == "{\"event\":\"pong\"}" ||
-        trimmed.rfind("pong", 0) == 0) {  // 以 "pong" 开头兜底
+    if (is_pong(msg)) {
         std::cout << "[" << name_ << "] Ignored pong response" << std::endl;
         return;  // 直接返回，不解析
     }
+    if (fast_parse_ && parse_fast(msg)) {
+        return;
+    }
     
     try {
         // std::cout << "[Binance Debug] Raw message: " << msg << std::endl;  // 可选：调试时打开
         
-        json j = json::parse(msg);
+        json j = json::parse(msg.begin(), msg.end());
 
         // 订阅成功响应（{"result":null,"id":1} 或类似）
         if (j.contains("id") && (j.contains("result") && j["result"].is_null())) {
@@ -36,29 +41,53 @@ void BinanceConnector::parse_message(const std::string& msg) {
             return;
         }
 
+        if (!j.contains("stream") || !j.contains("data")) {
+            return;
+        }
+        // stream 形如 btcusdt@depth20@100ms
+        const std::string& stream = j["stream"].get_ref<const std::string&>();
+        size_t inst = 0;
+        if (!find_instrument(std::string_view(stream).substr(0, stream.find('@')), inst)) {
+            return;
+        }
+        const auto& data = j["data"];
+
+        // 全深度：REST 快照帧和 depthUpdate 增量。档位数组转回文本，与快速路径共用同步逻辑
+        if (stream.size() > 5 && stream.compare(stream.size() - 5, 5, "@rest") == 0) {
+            if (!on_snapshot(inst, msg, data.at("bids").dump(), data.at("asks").dump())) {
+                std::cerr << "[Binance] Bad depth snapshot for " << stream << std::endl;
+            }
+            return;
+        }
+        if (data.value("e", "") == "depthUpdate") {
+            on_diff(inst, msg, data.at("U").get<uint64_t>(), data.at("u").get<uint64_t>(),
+                    data.at("b").dump(), data.at("a").dump());
+            return;
+        }
+
         // 深度快照消息（每次都是完整 top N 档）
-        if (j.contains("bids") && j.contains("asks") && j.contains("lastUpdateId")) {
+        if (data.contains("bids") && data.contains("asks") && data.contains("lastUpdateId")) {
             {
-                std::lock_guard<std::mutex> lock(book_mutex_);
-                local_bids_.clear();
-                local_asks_.clear();
+                snapshot_bids_.clear();
+                snapshot_asks_.clear();
                 // std::cout<<"test4"<<std::endl;
                 // std::cout<<"[Binance Debug] "<<j["bids"][0]<<j["asks"][0]<<endl;
-                for (const auto& level : j["bids"]) {
-                    double raw_price = std::stod(level[0].get<std::string>());
-                    double price = standardize_price(raw_price, tick_size_,true);
-                    double qty = std::stod(level[1].get<std::string>());
+                for (const auto& level : data["bids"]) {
+                    PriceTicks price = to_ticks(inst, level[0].get_ref<const std::string&>(), true);
+                    Quantity qty = parse_quantity(level[1].get_ref<const std::string&>());
                     // printf("raw: %10.2f, bid: %10.2f,%.8f\n",raw_price,price,qty);
                     // printf("bid: %10.1f,%.8f\n",price,qty);
-                    if (qty > 0.0) local_bids_[price] += qty;
+                    if (qty > 0) snapshot_bids_.add(price, qty);
                 }
-                for (const auto& level : j["asks"]) {
-                    double raw_price = std::stod(level[0].get<std::string>());
-                    double price = standardize_price(raw_price, tick_size_,false);
-                    double qty = std::stod(level[1].get<std::string>());
+                for (const auto& level : data["asks"]) {
+                    PriceTicks price = to_ticks(inst, level[0].get_ref<const std::string&>(), false);
+                    Quantity qty = parse_quantity(level[1].get_ref<const std::string&>());
                     // printf("raw: %10.2f, ask: %10.2f,%.8f\n",raw_price,price,qty);
-                    if (qty > 0.0) local_asks_[price] += qty;
+                    if (qty > 0) snapshot_asks_.add(price, qty);
                 }
+                std::lock_guard<std::mutex> lock(book_mutex_);
+                set_stamp(inst, msg, "E", "lastUpdateId");
+                replace_book(inst);
                 // std::cout<<"[Binance Debug]\t";
                 // auto it = local_asks_.begin();
                 // std::cout<<it->first<<","<<it->second<<";";
@@ -66,7 +95,7 @@ void BinanceConnector::parse_message(const std::string& msg) {
                 // std::cout<<it->first<<","<<it->second<<std::endl;
             }
             if (aggregator_) {
-                aggregator_->on_book_updated(this);
+                aggregator_->on_book_updated(this, inst);
             }
             // std::cout<<"test5"<<std::endl;
             // print_book();  // <--- 实时打印 Binance 更新
@@ -75,3 +104,144 @@ void BinanceConnector::parse_message(const std::string& msg) {
         std::cerr << "[Binance] Parse error: " << e.what() << std::endl;
     }
 }
+
+// 深度快照的快速路径：levels 直接从读缓冲区写进快照暂存簿
+bool BinanceConnector::parse_fast(std::string_view msg) {
+    std::string_view stream, bids, asks;
+    if (!depth_parser::find_string(msg, "stream", stream)) {
+        return false;
+    }
+    // 全深度：增量流和包装过的 REST 快照
+    const std::string_view kind = stream.substr(std::min(stream.find('@'), stream.size()));
+    if (kind == "@rest" || msg.find("\"depthUpdate\"") != std::string_view::npos) {
+        size_t inst = 0;
+        if (!find_instrument(stream.substr(0, stream.find('@')), inst)) {
+            return true;
+        }
+        if (kind == "@rest") {
+            return depth_parser::find_array(msg, "bids", bids) &&
+                   depth_parser::find_array(msg, "asks", asks) &&
+                   on_snapshot(inst, msg, bids, asks);
+        }
+        uint64_t first_id = 0, last_id = 0;
+        return depth_parser::find_uint(msg, "U", first_id) && depth_parser::find_uint(msg, "u", last_id) &&
+               depth_parser::find_array(msg, "b", bids) && depth_parser::find_array(msg, "a", asks) &&
+               on_diff(inst, msg, first_id, last_id, bids, asks);
+    }
+
+    if (msg.find("\"lastUpdateId\"") == std::string_view::npos ||
+        !depth_parser::find_array(msg, "bids", bids) ||
+        !depth_parser::find_array(msg, "asks", asks)) {
+        return false;
+    }
+    size_t inst = 0;
+    if (!find_instrument(stream.substr(0, stream.find('@')), inst)) {
+        return true;
+    }
+    snapshot_bids_.clear();
+    snapshot_asks_.clear();
+    if (!fill_snapshot_side(inst, bids, true, true) || !fill_snapshot_side(inst, asks, false, true)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(book_mutex_);
+        set_stamp(inst, msg, "E", "lastUpdateId");
+        replace_book(inst);
+    }
+    if (aggregator_) {
+        aggregator_->on_book_updated(this, inst);
+    }
+    return true;
+}
+
+void BinanceConnector::on_session_start() {
+    // 新连接上全部重新拉快照，旧连接在途的请求作废
+    ++sync_generation_;
+    sync_.assign(books_.size(), DiffSync{});
+}
+
+bool BinanceConnector::on_snapshot(size_t inst, std::string_view msg, std::string_view bids,
+                                   std::string_view asks) {
+    uint64_t last_update_id = 0;
+    if (!depth_parser::find_uint(msg, "lastUpdateId", last_update_id) ||
+        !apply_book_snapshot(inst, msg, "", "lastUpdateId", bids, asks)) {
+        return false;
+    }
+    const VenueBook& vb = books_[inst];
+    if (aggregator_) {
+        aggregator_->on_book_updated(this, inst);
+    }
+
+    std::vector<std::string> buffered;
+    buffered.swap(sync_[inst].buffered);
+    std::cout << "[Binance] " << instruments_[inst].symbol << " synced at lastUpdateId " << last_update_id
+              << " (" << vb.raw_bids.size() << " bids, " << vb.raw_asks.size() << " asks, "
+              << buffered.size() << " buffered updates)" << std::endl;
+    // 缓存的增量按到达顺序重放，u <= lastUpdateId 的在 on_diff 里跳过
+    for (const std::string& m : buffered) {
+        parse_message(m);
+    }
+    return true;
+}
+
+bool BinanceConnector::on_diff(size_t inst, std::string_view msg, uint64_t first_id, uint64_t last_id,
+                               std::string_view bids, std::string_view asks) {
+    VenueBook& vb = books_[inst];
+    DiffSync& sync = sync_[inst];
+    if (vb.synced && last_id <= vb.last_seq) {
+        return true;  // 快照已包含
+    }
+    if (vb.synced && first_id > vb.last_seq + 1) {
+        mark_gap(inst, vb.last_seq + 1, first_id);
+    }
+    if (!vb.synced) {
+        // 快照迟迟不到时缓存会过旧，清掉重新开始
+        if (sync.buffered.size() >= kMaxBuffered) sync.buffered.clear();
+        sync.buffered.emplace_back(msg);
+        request_snapshot(inst);
+        return true;
+    }
+
+    if (!apply_book_update(inst, msg, "E", "u", bids, asks)) {
+        // 应用了一半的增量无法回退，按断档处理（不退回 json 路径重放）
+        mark_unsynced(inst, "bad level in depth update");
+        request_snapshot(inst);
+        return true;
+    }
+    if (aggregator_) {
+        aggregator_->on_book_updated(this, inst);
+    }
+    return true;
+}
+
+void BinanceConnector::request_snapshot(size_t inst) {
+    DiffSync& sync = sync_[inst];
+    // 回放时快照来自录制下来的 @rest 帧，不发请求
+    if (!running() || sync.pending) return;
+    const auto now = std::chrono::steady_clock::now();
+    if (now < sync.next_request) return;  // 下一条增量到达时再试
+    sync.pending = true;
+    sync.next_request = now + kSnapshotRetry;
+
+    const Instrument& instrument = instruments_[inst];
+    const std::string path = "/api/v3/depth?symbol=" + instrument.base + instrument.quote +
+                             "&limit=" + std::to_string(kSnapshotLimit);
+    std::cout << "[Binance] Fetching depth snapshot " << path << std::endl;
+    const uint64_t generation = sync_generation_;
+    http_get(path, [this, inst, generation](beast::error_code ec, unsigned status, std::string body) {
+        if (generation != sync_generation_) return;
+        sync_[inst].pending = false;
+        if (ec || status != 200) {
+            std::cerr << "[Binance] Depth snapshot for " << instruments_[inst].symbol << " failed: "
+                      << (ec ? ec.message() : "HTTP " + std::to_string(status) + " " + body.substr(0, 200))
+                      << std::endl;
+            return;
+        }
+        try {
+            handle_frame(R"({"stream":")" + venue_symbols_[inst] + R"(@rest","data":)" + body + "}");
+        } catch (const std::exception& e) {
+            std::cerr << "[Binance] Depth snapshot for " << instruments_[inst].symbol
+                      << " rejected: " << e.what() << std::endl;
+        }
+    });
+}
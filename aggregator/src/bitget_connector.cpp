@@ -3,36 +3,50 @@
 #include <iostream>
 #include <iomanip>
 
-#include "aggregator.h"
+#include "depth_parser.h"
 
 using json = nlohmann::json;
 using namespace std;
 
-BitgetConnector::BitgetConnector(Aggregator* aggregator)
-    : Connector(aggregator, "Bitget",0.1) {}
+BitgetConnector::BitgetConnector(BookListener* aggregator, net::io_context& ioc, const std::vector<Instrument>& instruments)
+    : Connector(aggregator, ioc, "Bitget", kBitget, instruments) {
+    for (const auto& inst : instruments) {
+        venue_symbols_.push_back(inst.base + inst.quote);  // BTCUSDT
+    }
+}
 
-void BitgetConnector::parse_message(const std::string& msg) {
+void BitgetConnector::parse_message(std::string_view msg) {
     // 过滤常见 pong 响应（纯文本或 JSON），避免解析错误
-    std::string trimmed = msg;
-    // 去除空格/换行
-    trimmed.erase(std::remove_if(trimmed.begin(), trimmed.end(), ::isspace), trimmed.end());
-
-    if (trimmed == "pong" || 
-        trimmed == "{\"pong\":true}" || 
-        trimmed == "{\"event\":\"pong\"}" ||  // 某些交易所格式
-        trimmed.find("pong") != std::string::npos) {
+    if (is_pong(msg)) {
         // 可选：std::cout << "[" << name_ << "] Received pong" << std::endl;
         return;
     }
-    
+    if (fast_parse_ && parse_fast(msg)) {
+        return;
+    }
     try {
 
         // std::cout << "[Bitget Debug] Raw message: " << msg << std::endl; 
-        json j = json::parse(msg);
+        json j = json::parse(msg.begin(), msg.end());
         
-        // 订阅响应
-        if (j.contains("code") && j["code"] == "0") {
-           std::cout << "[Bitget] Subscription SUCCESS (books50)" << std::endl;
+        // 订阅响应：{"event":"subscribe","arg":{...}}，带回所订的频道（books 或 books50，见 book_arg）
+        if (j.contains("event") && j["event"] == "subscribe") {
+            const json arg = j.value("arg", json::object());
+            std::cout << "[Bitget] Subscription SUCCESS (" << arg.value("channel", "?") << " "
+                      << arg.value("instId", "?") << ")" << std::endl;
+            return;
+        }
+
+        // books 增量频道
+        if (full_depth_ && j.contains("action") && j.contains("data") && j["data"].is_array() &&
+            !j["data"].empty()) {
+            const auto& data = j["data"][0];
+            size_t inst = 0;
+            if (j.contains("arg") && find_instrument(j["arg"]["instId"].get_ref<const std::string&>(), inst) &&
+                data.contains("bids") && data.contains("asks")) {
+                on_books(inst, j["action"].get_ref<const std::string&>(), data.dump(), data["bids"].dump(),
+                         data["asks"].dump());
+            }
             return;
         }
 
@@ -40,39 +54,42 @@ void BitgetConnector::parse_message(const std::string& msg) {
         if (j.contains("action") && j["action"] == "snapshot" &&
             j.contains("data") && j["data"].is_array() && !j["data"].empty()) {
             const auto& data = j["data"][0];
+            size_t inst = 0;
+            if (!j.contains("arg") ||
+                !find_instrument(j["arg"]["instId"].get_ref<const std::string&>(), inst)) {
+                return;
+            }
 
             if (data.contains("bids") && data.contains("asks")) {
                 {
-                    std::lock_guard<std::mutex> lock(book_mutex_);
-                    local_bids_.clear();
-                    local_asks_.clear();
+                    snapshot_bids_.clear();
+                    snapshot_asks_.clear();
                     // std::cout<<"[Bitget Debug]"<<data["bids"][0]<<data["asks"][0]<<endl;
                     for (const auto& level : data["bids"]) {
-                        double raw_price = std::stod(level[0].get<std::string>());
-                        double price = standardize_price(raw_price, tick_size_,true);
-                        double qty = std::stod(level[1].get<std::string>());
+                        PriceTicks price = to_ticks(inst, level[0].get_ref<const std::string&>(), true);
+                        Quantity qty = parse_quantity(level[1].get_ref<const std::string&>());
                         // printf("raw: %10.2f, bid: %10.2f,%.8f\n",raw_price,price,qty);
-                        if (qty > 0.0) local_bids_[price] += qty;
+                        if (qty > 0) snapshot_bids_.add(price, qty);
                     }
                     for (const auto& level : data["asks"]) {
-                        double raw_price = std::stod(level[0].get<std::string>());
-                        double price = standardize_price(raw_price, tick_size_,false);
-                        double qty = std::stod(level[1].get<std::string>());
+                        PriceTicks price = to_ticks(inst, level[0].get_ref<const std::string&>(), false);
+                        Quantity qty = parse_quantity(level[1].get_ref<const std::string&>());
                         // printf("raw: %10.2f, ask: %10.2f,%.8f\n",raw_price,price,qty);
-                        if (qty > 0.0) local_asks_[price] += qty;
+                        if (qty > 0) snapshot_asks_.add(price, qty);
                     }
+                    std::lock_guard<std::mutex> lock(book_mutex_);
+                    set_stamp(inst, msg, "ts", "seq");
+                    replace_book(inst);
                     if(0){
                         std::cout<<"[Bitget Debug]\t";
-                        auto it = local_asks_.begin();
-                        std::cout<<it->first<<","<<it->second<<";";
-                        it = local_bids_.begin();
-                        std::cout<<it->first<<","<<it->second<<std::endl;
+                        std::cout<<books_[inst].asks.best_price()<<";";
+                        std::cout<<books_[inst].bids.best_price()<<std::endl;
                     }
                 }
                 // lock结束
 
                 if (aggregator_) {
-                    aggregator_->on_book_updated(this);
+                    aggregator_->on_book_updated(this, inst);
                 }
                 // std::cout<<"[Bitget]";
                 //  print_book();
@@ -82,4 +99,86 @@ void BitgetConnector::parse_message(const std::string& msg) {
         std::cerr << "[Bitget] Parse error: " << e.what() << std::endl;
     }
    
-}
\ No newline at end of file
+}
+
+// books / books50 推送的快速路径；books50 下非 snapshot 的推送与 json 路径一样直接忽略
+bool BitgetConnector::parse_fast(std::string_view msg) {
+    std::string_view action, inst_id, data, bids, asks;
+    if (!depth_parser::find_string(msg, "action", action)) {
+        return false;
+    }
+    if (!full_depth_ && action != "snapshot") {
+        return true;
+    }
+    size_t inst = 0;
+    if (!depth_parser::find_string(msg, "instId", inst_id)) {
+        return false;
+    }
+    if (!find_instrument(inst_id, inst)) {
+        return true;
+    }
+    if (!depth_parser::find_array(msg, "data", data) ||
+        !depth_parser::find_array(data, "bids", bids) ||
+        !depth_parser::find_array(data, "asks", asks)) {
+        return false;
+    }
+    if (full_depth_) {
+        return on_books(inst, action, data, bids, asks);
+    }
+    snapshot_bids_.clear();
+    snapshot_asks_.clear();
+    if (!fill_snapshot_side(inst, bids, true, true) || !fill_snapshot_side(inst, asks, false, true)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(book_mutex_);
+        set_stamp(inst, data, "ts", "seq");
+        replace_book(inst);
+    }
+    if (aggregator_) {
+        aggregator_->on_book_updated(this, inst);
+    }
+    return true;
+}
+
+bool BitgetConnector::on_books(size_t inst, std::string_view action, std::string_view data,
+                               std::string_view bids, std::string_view asks) {
+    VenueBook& vb = books_[inst];
+    if (action == "snapshot") {
+        if (!apply_book_snapshot(inst, data, "ts", "seq", bids, asks)) {
+            return false;
+        }
+    } else {
+        if (!vb.synced) {
+            return true;  // 等重新订阅后的快照
+        }
+        uint64_t seq = 0;
+        if (!depth_parser::find_uint(data, "seq", seq) || seq <= vb.last_seq) {
+            mark_gap(inst, vb.last_seq + 1, seq);
+            resubscribe(inst);
+            return true;
+        }
+        if (!apply_book_update(inst, data, "ts", "seq", bids, asks)) {
+            // 应用了一半的增量无法回退，按断档处理
+            mark_unsynced(inst, "bad level in books update");
+            resubscribe(inst);
+            return true;
+        }
+    }
+    if (!checksum_ok(inst, data)) {
+        // 已退出合并（见 mark_unsynced），不再通知，等重新订阅后的快照
+        resubscribe(inst);
+        return true;
+    }
+    if (aggregator_) {
+        aggregator_->on_book_updated(this, inst);
+    }
+    return true;
+}
+
+void BitgetConnector::resubscribe(size_t inst) {
+    if (!running()) return;  // 回放时只能等录制里的下一份快照
+    const std::string arg = book_arg(venue_symbols_[inst]);
+    send(R"({"op":"unsubscribe","args":[)" + arg + "]}");
+    send(R"({"op":"subscribe","args":[)" + arg + "]}");
+}
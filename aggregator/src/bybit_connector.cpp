@@ -4,114 +4,116 @@
 #include <iostream>
 #include <iomanip>
 
-#include "aggregator.h"  // 确保 aggregator_ 是完整类型
+#include "depth_parser.h"
 
 using json = nlohmann::json;
 using namespace std;
 
-BybitConnector::BybitConnector(Aggregator* aggregator)
-    : Connector(aggregator, "Bybit",0.1) {}
+BybitConnector::BybitConnector(BookListener* aggregator, net::io_context& ioc, const std::vector<Instrument>& instruments)
+    : Connector(aggregator, ioc, "Bybit", kBybit, instruments) {
+    for (const auto& inst : instruments) {
+        venue_symbols_.push_back(inst.base + inst.quote);  // BTCUSDT
+    }
+}
 
-void BybitConnector::parse_message(const std::string& msg) {
+void BybitConnector::parse_message(std::string_view msg) {
     // <--- 新增：过滤 pong 响应（常见格式）
-    std::string trimmed = msg;
-    // 去除空白字符
-    trimmed.erase(std::remove_if(trimmed.begin(), trimmed.end(), ::isspace), trimmed.end());
-
-    if (trimmed == "pong" ||
-        trimmed == "{\"pong\":true}" ||
-        trimmed == "{\"event\":\"pong\"}" ||
-        trimmed.rfind("pong", 0) == 0) {  // 以 "pong" 开头兜底
+    if (is_pong(msg)) {
         std::cout << "[" << name_ << "] Ignored pong response" << std::endl;
         return;  // 直接返回，不解析
     }
+    if (fast_parse_ && parse_fast(msg)) {
+        return;
+    }
     try {
         // 可选调试打印（高频时建议注释，避免阻塞）
         // std::cout << "[Bybit] raw message received: " << msg << std::endl;
         
-        json j = json::parse(msg);
+        json j = json::parse(msg.begin(), msg.end());
 
         // 订阅成功响应
         if (j.contains("success") && j["success"] == true) {
-            std::cout << "[Bybit] Subscription SUCCESS (orderbook.50.BTCUSDT)" << std::endl;
+            std::cout << "[Bybit] Subscription SUCCESS (orderbook.50)" << std::endl;
             return;
         }
 
-        // 只处理 topic 为 orderbook.50.BTCUSDT 的消息
-        if (!j.contains("topic") || j["topic"] != "orderbook.50.BTCUSDT") {
+        // 只处理已订阅交易对的 orderbook.50.<symbol> 消息
+        if (!j.contains("topic")) {
             return;
         }
-        {
-            std::lock_guard<std::mutex> lock(book_mutex_);
-
-            const auto& data = j["data"];
-
-            // snapshot：完整快照，清空并重建本地订单簿
-            if (j["type"] == "snapshot") {
-                local_bids_.clear();
-                local_asks_.clear();
-                // std::cout << "[Bybit Debug]"<<data["b"][0]<<data["a"][0]<<std::endl;
-                // bids
-                for (const auto& level : data["b"]) {
-                    double raw_price = std::stod(level[0].get<std::string>());
-                    double price = standardize_price(raw_price, tick_size_,true);
-                    double qty   = std::stod(level[1].get<std::string>());
-                    if (qty > 0.0) {
-                        local_bids_[price] = qty;
-                    }
-                }
-                // asks
-                for (const auto& level : data["a"]) {
-                    double raw_price = std::stod(level[0].get<std::string>());
-                    double price = standardize_price(raw_price, tick_size_,false);
-                    double qty   = std::stod(level[1].get<std::string>());
-                    if (qty > 0.0) {
-                        local_asks_[price] = qty;
-                    }
-                }
-            }
-            // delta：增量更新（支持删除 qty="0"、更新、添加）
-            else if (j["type"] == "delta") {
-                // delete / update bids
-                // std::cout << "[Bybit Debug]"<<j["b"][0]<<j["a"][0]<<std::endl;
-                for (const auto& level : data["b"]) {
-                    double price = std::stod(level[0].get<std::string>());
-                    double qty   = std::stod(level[1].get<std::string>());
-                    // printf("raw: %10.2f, bid: %10.2f,%.8f\n",raw_price,price,qty);
-                    // printf("bid: %10.2f,%.8f\n",price,qty);
-                    if (qty == 0.0) {
-                        local_bids_.erase(price);
-                    } else {
-                        local_bids_[price] = qty;
-                    }
-                }
-                // delete / update asks
-                for (const auto& level : data["a"]) {
-                    double price = std::stod(level[0].get<std::string>());
-                    double qty   = std::stod(level[1].get<std::string>());
-                    // printf("ask: %10.2f,%.8f\n",price,qty);
-                    if (qty == 0.0) {
-                        local_asks_.erase(price);
-                    } else {
-                        local_asks_[price] = qty;
-                    }
-                }
-                //打印local_asks_第一个值
-                // std::cout<<"[Bybit Debug]\t";
-                // auto it = local_asks_.begin();
-                // std::cout<<it->first<<","<<it->second<<";";
-                // it = local_bids_.begin();
-                // std::cout<<it->first<<","<<it->second<<std::endl;
-                
-            }
-        }
-        // 每次有效更新后通知聚合器（可加 print_book() 如果需要打印）
-        if (aggregator_) {
-            aggregator_->on_book_updated(this);
+        std::string_view topic = j["topic"].get_ref<const std::string&>();
+        size_t inst = 0;
+        if (topic.substr(0, 13) != "orderbook.50." || !find_instrument(topic.substr(13), inst)) {
+            return;
         }
-        // print_book();  // <--- 如需实时打印 Bybit 订单簿，取消注释
+        // 与快速路径一样按原始价位维护（多个原始价位可能落在同一个 tick 上）
+        const auto& data = j["data"];
+        on_orderbook(inst, j.value("type", std::string()), msg, data["b"].dump(), data["a"].dump());
+        // print_book(inst);  // <--- 如需实时打印 Bybit 订单簿，取消注释
 
     } catch (const std::exception& e) {
         std::cerr << "[Bybit] Parse error: " << e.what() << std::endl;
     }
-}
\ No newline at end of file
+}
+
+// orderbook 推送的快速路径：snapshot 重建原始价格簿后整体替换，delta 按原始价位写本地簿
+bool BybitConnector::parse_fast(std::string_view msg) {
+    std::string_view topic, type, bids, asks;
+    if (!depth_parser::find_string(msg, "topic", topic)) {
+        return false;
+    }
+    size_t inst = 0;
+    if (topic.substr(0, 13) != "orderbook.50." || !find_instrument(topic.substr(13), inst)) {
+        return true;
+    }
+    if (!depth_parser::find_string(msg, "type", type) ||
+        !depth_parser::find_array(msg, "b", bids) ||
+        !depth_parser::find_array(msg, "a", asks)) {
+        return false;
+    }
+    // 档位由同一个解析器处理，这里失败 json 路径也会失败，不再退回
+    on_orderbook(inst, type, msg, bids, asks);
+    return true;
+}
+
+void BybitConnector::on_orderbook(size_t inst, std::string_view type, std::string_view msg, std::string_view bids,
+                                  std::string_view asks) {
+    VenueBook& vb = books_[inst];
+    if (type == "snapshot") {
+        if (!apply_book_snapshot(inst, msg, "ts", "u", bids, asks)) {
+            // 原始价格簿已清掉，只能等新快照
+            mark_unsynced(inst, "bad level in orderbook snapshot");
+            resubscribe(inst);
+            return;
+        }
+    } else if (type == "delta") {
+        if (!vb.synced) {
+            return;  // 等重新订阅后的快照
+        }
+        // u 不要求连续，但必须递增；回退或重复说明中间漏了或乱了序
+        uint64_t u = 0;
+        if (!depth_parser::find_uint(msg, "u", u) || u <= vb.last_seq) {
+            mark_unsynced(inst, "sequence gap: u " + std::to_string(u) + " after " + std::to_string(vb.last_seq));
+            resubscribe(inst);
+            return;
+        }
+        if (!apply_book_update(inst, msg, "ts", "u", bids, asks)) {
+            // 应用了一半的增量无法回退，按断档处理
+            mark_unsynced(inst, "bad level in orderbook delta");
+            resubscribe(inst);
+            return;
+        }
+    } else {
+        return;
+    }
+    if (aggregator_) {
+        aggregator_->on_book_updated(this, inst);
+    }
+}
+
+void BybitConnector::resubscribe(size_t inst) {
+    if (!running()) return;  // 回放时只能等录制里的下一份快照
+    const std::string arg = "\"orderbook.50." + venue_symbols_[inst] + '"';
+    send(R"({"op":"unsubscribe","args":[)" + arg + "]}");
+    send(R"({"op":"subscribe","args":[)" + arg + "]}");
+}
@@ -0,0 +1,133 @@
+#include "capture.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+constexpr size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+}
+
+CaptureWriter::CaptureWriter(std::string dir, std::string prefix, size_t file_bytes)
+    : dir_(std::move(dir)), prefix_(std::move(prefix)), file_bytes_(file_bytes),
+      started_(std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::system_clock::now().time_since_epoch()).count()) {}
+
+CaptureWriter::~CaptureWriter() {
+    close_current();
+}
+
+void CaptureWriter::append(uint8_t venue, int64_t recv_ns, std::string_view frame) {
+    if (failed_ || frame.empty()) return;  // 长度 0 留作结束标记
+    // 记录本身 + 结尾的空记录头，保证读者总能看到结束标记
+    const size_t need = sizeof(CaptureRecord) + align8(frame.size()) + sizeof(CaptureRecord);
+    if (!map_ || pos_ + need > size_) {
+        close_current();
+        if (!open_next(sizeof(CaptureFileHeader) + need)) {
+            failed_ = true;
+            return;
+        }
+    }
+    CaptureRecord rec{};
+    rec.recv_ns = recv_ns;
+    rec.length = static_cast<uint32_t>(frame.size());
+    rec.venue = venue;
+    std::memcpy(map_ + pos_ + sizeof(rec), frame.data(), frame.size());
+    std::memcpy(map_ + pos_, &rec, sizeof(rec));
+    pos_ += sizeof(rec) + align8(frame.size());
+    ++frames_;
+}
+
+bool CaptureWriter::open_next(size_t min_bytes) {
+    std::string path = dir_ + "/" + prefix_ + "-" + std::to_string(started_) + "-" +
+                       std::to_string(index_++) + ".cap";
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        std::cerr << "[Capture] open " << path << " failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    size_ = std::max(file_bytes_, min_bytes);
+    if (::ftruncate(fd_, static_cast<off_t>(size_)) != 0) {
+        std::cerr << "[Capture] ftruncate " << path << " failed: " << std::strerror(errno) << std::endl;
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    void* p = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED) {
+        std::cerr << "[Capture] mmap " << path << " failed: " << std::strerror(errno) << std::endl;
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    map_ = static_cast<char*>(p);
+    CaptureFileHeader header{};
+    std::memcpy(header.magic, kCaptureMagic, sizeof(header.magic));
+    header.version = kCaptureVersion;
+    header.header_size = sizeof(header);
+    std::memcpy(map_, &header, sizeof(header));
+    pos_ = sizeof(header);
+    std::cout << "[Capture] Writing " << path << std::endl;
+    return true;
+}
+
+void CaptureWriter::close_current() {
+    if (!map_) return;
+    ::munmap(map_, size_);
+    map_ = nullptr;
+    // 去掉预分配的空尾巴
+    if (::ftruncate(fd_, static_cast<off_t>(pos_)) != 0) {
+        std::cerr << "[Capture] ftruncate failed: " << std::strerror(errno) << std::endl;
+    }
+    ::close(fd_);
+    fd_ = -1;
+}
+
+CaptureReader::CaptureReader(const std::string& path) : path_(path) {
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) throw std::runtime_error("open " + path + ": " + std::strerror(errno));
+    struct stat st {};
+    if (::fstat(fd_, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CaptureFileHeader)) {
+        ::close(fd_);
+        throw std::runtime_error("not a capture file: " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (p == MAP_FAILED) {
+        ::close(fd_);
+        throw std::runtime_error("mmap " + path + ": " + std::strerror(errno));
+    }
+    map_ = static_cast<const char*>(p);
+    ::madvise(p, size_, MADV_SEQUENTIAL);
+
+    CaptureFileHeader header;
+    std::memcpy(&header, map_, sizeof(header));
+    if (std::memcmp(header.magic, kCaptureMagic, sizeof(header.magic)) != 0 ||
+        header.version != kCaptureVersion) {
+        ::munmap(p, size_);
+        ::close(fd_);
+        throw std::runtime_error("not a capture file: " + path);
+    }
+    pos_ = header.header_size;
+}
+
+CaptureReader::~CaptureReader() {
+    if (map_) ::munmap(const_cast<char*>(map_), size_);
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool CaptureReader::next(CaptureRecord& record, std::string_view& payload) {
+    if (pos_ + sizeof(CaptureRecord) > size_) return false;
+    std::memcpy(&record, map_ + pos_, sizeof(record));
+    // length 为 0 是结束标记；越界说明文件在写入中途被截断
+    if (record.length == 0 || pos_ + sizeof(record) + record.length > size_) return false;
+    payload = std::string_view(map_ + pos_ + sizeof(record), record.length);
+    pos_ += sizeof(record) + align8(record.length);
+    return true;
+}
@@ -1,52 +1,433 @@
 #include "connector.h"
+#include "depth_parser.h"
+#include "crc32.h"
 #include <iostream>
 #include <chrono>
 #include <iomanip>  // <--- 新增：提供 std::put_time, std::setfill, std::setw, std::fixed, std::setprecision 等
 #include <ctime>    // <--- 新增：提供 std::localtime, std::tm 等
+#include <cctype>
+#include <cstdlib>
+#include <algorithm>
 
-Connector::Connector(Aggregator* aggregator, const std::string& name, double tick_size)
-    : aggregator_(aggregator), name_(name),tick_size_(tick_size)
+Connector::Connector(BookListener* aggregator, net::io_context& ioc, const std::string& name, Venue venue,
+                     const std::vector<Instrument>& instruments)
+    : aggregator_(aggregator), name_(name), venue_(venue), instruments_(instruments),
+      strand_(net::make_strand(ioc)), resolver_(strand_),
+      ping_timer_(strand_), reconnect_timer_(strand_), read_timer_(strand_)
 {
-    ctx_.set_verify_mode(ssl::verify_peer);
+    books_.resize(instruments.size());
+    subscribed_.assign(instruments.size(), true);
+    for (size_t i = 0; i < instruments.size(); ++i) {
+        books_[i].tick_units = instruments[i].tick_units;
+    }
+
+    // AGG_TLS_VERIFY=0：不校验证书，用于自签名证书的本地 mock
+    const char* verify = std::getenv("AGG_TLS_VERIFY");
+    ctx_.set_verify_mode(verify && std::string(verify) == "0" ? ssl::verify_none : ssl::verify_peer);
     ctx_.set_default_verify_paths();
+
+    const char* fast = std::getenv("AGG_FAST_PARSE");
+    fast_parse_ = !(fast && std::string(fast) == "0");
+    const char* full_depth = std::getenv("AGG_FULL_DEPTH");
+    full_depth_ = !(full_depth && std::string(full_depth) == "0");
+    const char* checksum = std::getenv("AGG_VERIFY_CHECKSUM");
+    verify_checksums_ = !(checksum && std::string(checksum) == "0");
+
+    // AGG_STALE_MS / AGG_READ_TIMEOUT_MS：过期排除和读超时阈值；AGG_RECONNECT_MIN_MS / MAX_MS：重连退避范围
+    if (const char* stale = std::getenv("AGG_STALE_MS")) stale_ns_ = std::strtoll(stale, nullptr, 10) * 1000000;
+    if (const char* timeout = std::getenv("AGG_READ_TIMEOUT_MS")) {
+        read_timeout_ns_ = std::strtoll(timeout, nullptr, 10) * 1000000;
+    }
+    if (const char* min_ms = std::getenv("AGG_RECONNECT_MIN_MS")) {
+        reconnect_min_ = std::chrono::milliseconds(std::max(1L, std::strtol(min_ms, nullptr, 10)));
+    }
+    if (const char* max_ms = std::getenv("AGG_RECONNECT_MAX_MS")) {
+        reconnect_max_ = std::chrono::milliseconds(std::strtol(max_ms, nullptr, 10));
+    }
+    reconnect_max_ = std::max(reconnect_max_, reconnect_min_);
+
+    // AGG_CAPTURE_DIR：录制目录；AGG_CAPTURE_FILE_MB：单个文件大小，写满轮转
+    const char* capture_dir = std::getenv("AGG_CAPTURE_DIR");
+    if (capture_dir && *capture_dir) {
+        const char* file_mb = std::getenv("AGG_CAPTURE_FILE_MB");
+        size_t mb = file_mb ? std::strtoul(file_mb, nullptr, 10) : 256;
+        capture_ = std::make_unique<CaptureWriter>(capture_dir, name_, std::max<size_t>(mb, 1) << 20);
+    }
 }
 
 Connector::~Connector() {
+    // 此时 io 线程已停止，未执行的回调随 io_context 一起丢弃
     std::cout << "[" << name_ << "] Destructor called, shutting down..." << std::endl;
-    running_ = false;
-
-    // 安全关闭 WebSocket
-    if (ws_) {
-        beast::error_code ec;
-        ws_->close(websocket::close_code::going_away, ec);
-        if (ec) {
-            std::cerr << "[" << name_ << "] Destructor close error: " << ec.message() << std::endl;
+    close_socket();
+}
+
+void Connector::start() {
+    std::cout << "[" << name_ << "] Starting connector..." << std::endl;
+    load_endpoint();
+    load_rest_target();
+    net::post(strand_, [this]() {
+        running_ = true;
+        connect();
+    });
+}
+
+void Connector::configure(const VenueConfig& config) {
+    config_url_ = config.url;
+    config_rest_url_ = config.rest_url;
+    if (config.full_depth >= 0 && !std::getenv("AGG_FULL_DEPTH")) {
+        full_depth_ = config.full_depth == 1;
+    }
+    if (config.stale_ms >= 0 && !std::getenv("AGG_STALE_MS")) stale_ns_ = config.stale_ms * 1000000;
+    if (config.read_timeout_ms >= 0 && !std::getenv("AGG_READ_TIMEOUT_MS")) {
+        read_timeout_ns_ = config.read_timeout_ms * 1000000;
+    }
+    if (!config.symbols.empty()) {
+        for (size_t i = 0; i < instruments_.size(); ++i) {
+            subscribed_[i] = std::find(config.symbols.begin(), config.symbols.end(), instruments_[i].symbol) !=
+                             config.symbols.end();
         }
     }
+}
+
+std::vector<std::string> Connector::subscribed_symbols() const {
+    std::vector<std::string> out;
+    for (size_t i = 0; i < venue_symbols_.size(); ++i) {
+        if (subscribed_[i]) out.push_back(venue_symbols_[i]);
+    }
+    return out;
+}
 
-    if (thread_.joinable()) {
-        thread_.join();
-        std::cout << "[" << name_ << "] Main thread joined" << std::endl;
+std::string Connector::endpoint_override(const char* suffix, const std::string& configured,
+                                         std::string& source) const {
+    std::string var = "AGG_" + name_ + suffix;
+    for (auto& c : var) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    const char* env = std::getenv(var.c_str());
+    if (env && *env) {
+        source = var;
+        return env;
     }
-    if (ping_thread_.joinable()) {
-        ping_thread_.join();
-        std::cout << "[" << name_ << "] Ping thread joined" << std::endl;
+    source = "config";
+    return configured;
+}
+
+void Connector::load_endpoint() {
+    endpoint_ = {host(), port(), path(), true};
+
+    std::string var;
+    const std::string spec = endpoint_override("_URL", config_url_, var);
+    if (spec.empty()) return;
+
+    // ws[s]://host[:port][/path]，省略 path 时沿用交易所默认路径
+    std::string_view url(spec);
+    if (url.substr(0, 6) == "wss://") {
+        url.remove_prefix(6);
+    } else if (url.substr(0, 5) == "ws://") {
+        url.remove_prefix(5);
+        endpoint_.tls = false;
+    } else {
+        throw std::invalid_argument(var + " must start with ws:// or wss://");
     }
+    size_t slash = url.find('/');
+    std::string_view authority = url.substr(0, slash);
+    if (slash != std::string_view::npos) endpoint_.path = std::string(url.substr(slash));
+    size_t colon = authority.rfind(':');
+    if (colon != std::string_view::npos) {
+        endpoint_.host = std::string(authority.substr(0, colon));
+        endpoint_.port = std::string(authority.substr(colon + 1));
+    } else {
+        endpoint_.host = std::string(authority);
+        endpoint_.port = endpoint_.tls ? "443" : "80";
+    }
+    std::cout << "[" << name_ << "] Endpoint overridden by " << var << ": "
+              << (endpoint_.tls ? "wss://" : "ws://") << endpoint_.host << ":" << endpoint_.port
+              << endpoint_.path << std::endl;
 }
 
-void Connector::start() {
-    std::cout << "[" << name_ << "] Starting connector..." << std::endl;
-    thread_ = std::thread(&Connector::run, this);
-    // ping_thread_ = std::thread(&Connector::ping_loop, this);
-    if (needs_ping()) {  // <--- 新增条件判断
-        ping_thread_ = std::thread(&Connector::ping_loop, this);
+void Connector::load_rest_target() {
+    rest_target_ = {rest_host(), rest_port(), true};
+    if (rest_target_.host.empty()) return;
+
+    std::string var;
+    const std::string spec = endpoint_override("_REST_URL", config_rest_url_, var);
+    if (spec.empty()) return;
+
+    // http[s]://host[:port]，路径由请求方给出
+    std::string_view url(spec);
+    if (url.substr(0, 8) == "https://") {
+        url.remove_prefix(8);
+    } else if (url.substr(0, 7) == "http://") {
+        url.remove_prefix(7);
+        rest_target_.tls = false;
+    } else {
+        throw std::invalid_argument(var + " must start with http:// or https://");
+    }
+    std::string_view authority = url.substr(0, url.find('/'));
+    size_t colon = authority.rfind(':');
+    rest_target_.host = std::string(authority.substr(0, colon));
+    rest_target_.port = colon != std::string_view::npos ? std::string(authority.substr(colon + 1))
+                                                        : (rest_target_.tls ? "443" : "80");
+    std::cout << "[" << name_ << "] REST endpoint overridden by " << var << ": "
+              << (rest_target_.tls ? "https://" : "http://") << rest_target_.host << ":"
+              << rest_target_.port << std::endl;
+}
+
+void Connector::http_get(const std::string& path, RestCallback done) {
+    ::http_get(strand_, ctx_, rest_target_, path, std::move(done));
+}
+
+void Connector::close_socket() {
+    beast::error_code ec;
+    if (ws_) beast::get_lowest_layer(*ws_).socket().close(ec);
+    if (plain_ws_) beast::get_lowest_layer(*plain_ws_).socket().close(ec);
+}
+
+bool Connector::is_pong(std::string_view msg) {
+    if (msg.size() > 32) return false;
+    char buf[32];
+    size_t n = 0;
+    for (char c : msg) {
+        if (!std::isspace(static_cast<unsigned char>(c))) buf[n++] = c;
+    }
+    std::string_view trimmed(buf, n);
+    return trimmed == "{\"pong\":true}" ||
+           trimmed == "{\"event\":\"pong\"}" ||
+           trimmed.substr(0, 4) == "pong";  // 以 "pong" 开头兜底
+}
+
+bool Connector::find_instrument(std::string_view venue_symbol, size_t& inst) const {
+    for (size_t i = 0; i < venue_symbols_.size(); ++i) {
+        if (venue_symbols_[i] == venue_symbol) {
+            inst = i;
+            return true;
+        }
     }
+    return false;
 }
 
-void Connector::print_book() const {
+void Connector::publish_changes(size_t inst) {
+    VenueBook& vb = books_[inst];
+    vb.handoff->live_ns.store(frame_recv_ns_, std::memory_order_relaxed);
     std::lock_guard<std::mutex> lock(book_mutex_);
+    if (vb.changes.empty()) return;
+    if (vb.changes_recv_ns == 0) vb.changes_recv_ns = frame_recv_ns_;
+    ChangeBatch batch{std::move(vb.changes), vb.changes_recv_ns, mono_ns(), vb.stamp};
+    if (!vb.handoff->ready.push(std::move(batch))) {
+        vb.changes = std::move(batch.changes);  // 队列满：留到下一条消息一起交
+        return;
+    }
+    vb.changes.clear();
+    vb.changes_recv_ns = 0;
+    vb.handoff->spare.pop(vb.changes);
+}
+
+void Connector::set_stamp(size_t inst, std::string_view msg, std::string_view time_key,
+                          std::string_view seq_key) {
+    uint64_t event_ms = 0, sequence = 0;
+    if (!time_key.empty()) depth_parser::find_uint(msg, time_key, event_ms);
+    depth_parser::find_uint(msg, seq_key, sequence);
+    books_[inst].stamp = {static_cast<int64_t>(event_ms), frame_recv_unix_ns_, sequence};
+}
+
+void Connector::set_level(size_t inst, bool is_bid, PriceTicks price, Quantity qty) {
+    VenueBook& vb = books_[inst];
+    // 最优价移动时移出 / 移回带内的价位也作为变化交出
+    auto apply = [&](auto& book) {
+        book.set(price, qty, [&](PriceTicks p, Quantity q) { vb.changes.push_back({is_bid, p, q}); });
+    };
+    if (is_bid) apply(vb.bids);
+    else apply(vb.asks);
+}
+
+void Connector::replace_book(size_t inst) {
+    VenueBook& vb = books_[inst];
+    // 新旧两本簿按价位比对，只记录真正变化的价位；旧簿换下来清空后留作下次暂存
+    auto diff = [&](auto& old_book, auto& new_book, bool is_bid) {
+        for (const auto& [price, qty] : old_book) {
+            if (!new_book.find(price)) vb.changes.push_back({is_bid, price, 0});
+        }
+        for (const auto& [price, qty] : new_book) {
+            const Quantity* old_qty = old_book.find(price);
+            if (!old_qty || *old_qty != qty) vb.changes.push_back({is_bid, price, qty});
+        }
+        old_book.swap(new_book);
+        new_book.clear();
+    };
+    diff(vb.bids, snapshot_bids_, true);
+    diff(vb.asks, snapshot_asks_, false);
+}
+
+bool Connector::fill_snapshot_side(size_t inst, std::string_view levels, bool is_bid, bool accumulate) {
+    return depth_parser::for_each_level(levels, [&](std::string_view p, std::string_view q) {
+        PriceTicks price;
+        Quantity qty;
+        if (!parse_level(inst, p, q, is_bid, price, qty)) return false;
+        if (qty > 0) {
+            auto put = [&](auto& staging) { staging.set(price, accumulate ? staging.get(price) + qty : qty); };
+            if (is_bid) put(snapshot_bids_);
+            else put(snapshot_asks_);
+        }
+        return true;
+    });
+}
+
+void Connector::clear_raw(size_t inst) {
+    VenueBook& vb = books_[inst];
+    vb.raw_bids.clear();
+    vb.raw_asks.clear();
+    snapshot_bids_.clear();
+    snapshot_asks_.clear();
+}
+
+bool Connector::add_raw_snapshot_level(size_t inst, bool is_bid, std::string_view p, std::string_view q) {
+    VenueBook& vb = books_[inst];
+    int64_t raw = 0;
+    Quantity qty = 0;
+    if (!parse_decimal(p, kDecimals, raw) || !parse_decimal(q, kDecimals, qty)) return false;
+    if (qty <= 0) return true;
+    RawLevel& level = is_bid ? vb.raw_bids.append(raw) : vb.raw_asks.append(raw);
+    level.qty = qty;
+    level.price.assign(p);
+    level.size.assign(q);
+    return true;
+}
+
+bool Connector::apply_raw_level(size_t inst, bool is_bid, std::string_view p, std::string_view q) {
+    VenueBook& vb = books_[inst];
+    int64_t raw = 0;
+    Quantity qty = 0;
+    if (!parse_decimal(p, kDecimals, raw) || !parse_decimal(q, kDecimals, qty)) return false;
+    const PriceTicks tick = is_bid ? raw / vb.tick_units : (raw + vb.tick_units - 1) / vb.tick_units;
+    auto apply = [&](auto& book, auto& raw_side) {
+        Quantity old = 0;
+        if (RawLevel* level = raw_side.find(raw)) {
+            old = level->qty;
+            if (qty > 0) {
+                level->qty = qty;
+                level->size.assign(q);
+            } else {
+                raw_side.erase(raw);
+            }
+        } else if (qty > 0) {
+            RawLevel& level = raw_side[raw];
+            level.qty = qty;
+            level.price.assign(p);
+            level.size.assign(q);
+        }
+        if (old == qty) return;
+        set_level(inst, is_bid, tick, std::max<Quantity>(0, book.get(tick) + qty - old));
+    };
+    if (is_bid) apply(vb.bids, vb.raw_bids);
+    else apply(vb.asks, vb.raw_asks);
+    return true;
+}
+
+bool Connector::fill_raw_snapshot_side(size_t inst, std::string_view levels, bool is_bid) {
+    return depth_parser::for_each_level(levels, [&](std::string_view p, std::string_view q) {
+        return add_raw_snapshot_level(inst, is_bid, p, q);
+    });
+}
+
+bool Connector::apply_raw_delta_side(size_t inst, std::string_view levels, bool is_bid) {
+    return depth_parser::for_each_level(levels, [&](std::string_view p, std::string_view q) {
+        return apply_raw_level(inst, is_bid, p, q);
+    });
+}
 
-    if (local_bids_.empty() && local_asks_.empty()) {
+bool Connector::apply_book_snapshot(size_t inst, std::string_view stamp_src, std::string_view time_key,
+                                    std::string_view seq_key, std::string_view bids, std::string_view asks) {
+    clear_raw(inst);
+    if (!fill_raw_snapshot_side(inst, bids, true) || !fill_raw_snapshot_side(inst, asks, false)) {
+        return false;
+    }
+    VenueBook& vb = books_[inst];
+    vb.raw_bids.sort();
+    vb.raw_asks.sort();
+    // 从最差价往最优价按 tick 累加进暂存簿：每档都不差于之前的，落到带外的价位依次追加到稀疏部分末尾
+    auto stage = [&](auto& staging, const auto& raw_side, bool is_bid) {
+        for (const auto& entry : raw_side) {
+            const PriceTicks tick =
+                is_bid ? entry.raw / vb.tick_units : (entry.raw + vb.tick_units - 1) / vb.tick_units;
+            staging.add(tick, entry.level.qty);
+        }
+    };
+    stage(snapshot_bids_, vb.raw_bids, true);
+    stage(snapshot_asks_, vb.raw_asks, false);
+    std::lock_guard<std::mutex> lock(book_mutex_);
+    set_stamp(inst, stamp_src, time_key, seq_key);
+    replace_book(inst);
+    vb.last_seq = vb.stamp.sequence;
+    vb.synced = true;
+    return true;
+}
+
+bool Connector::apply_book_update(size_t inst, std::string_view stamp_src, std::string_view time_key,
+                                  std::string_view seq_key, std::string_view bids, std::string_view asks) {
+    VenueBook& vb = books_[inst];
+    std::lock_guard<std::mutex> lock(book_mutex_);
+    set_stamp(inst, stamp_src, time_key, seq_key);
+    vb.last_seq = vb.stamp.sequence;
+    return apply_raw_delta_side(inst, bids, true) && apply_raw_delta_side(inst, asks, false);
+}
+
+bool Connector::verify_checksum(size_t inst, int64_t expected) {
+    const VenueBook& vb = books_[inst];
+    // 每档最多 "价:量:"。原文按定长整块拷贝、再按实际长度前移（变长 memcpy 会编译成启动开销大的 rep movs），
+    // 所以末尾多留一块的余量
+    char buf[kChecksumLevels * 2 * (2 * RawText::kCapacity + 2) + RawText::kCapacity];
+    size_t n = 0;
+    auto put = [&](const RawLevel& level) {
+        if (!level.price.valid() || !level.size.valid()) return false;
+        std::memcpy(buf + n, level.price.data, RawText::kCapacity);
+        n += level.price.len;
+        buf[n++] = ':';
+        std::memcpy(buf + n, level.size.data, RawText::kCapacity);
+        n += level.size.len;
+        buf[n++] = ':';
+        return true;
+    };
+    auto bid = vb.raw_bids.rbegin();
+    auto ask = vb.raw_asks.rbegin();
+    for (int i = 0; i < kChecksumLevels; ++i) {
+        if (bid != vb.raw_bids.rend() && !put((bid++)->level)) return true;
+        if (ask != vb.raw_asks.rend() && !put((ask++)->level)) return true;
+    }
+    if (n > 0) --n;  // 去掉末尾的 ':'
+    if (static_cast<int32_t>(crc32_ieee::compute(buf, n)) == static_cast<int32_t>(expected)) {
+        return true;
+    }
+    checksum_failures_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool Connector::checksum_ok(size_t inst, std::string_view msg) {
+    int64_t expected = 0;
+    if (!verify_checksums_ || !depth_parser::find_int(msg, "checksum", expected) ||
+        verify_checksum(inst, expected)) {
+        return true;
+    }
+    mark_unsynced(inst, "checksum mismatch");
+    return false;
+}
+
+void Connector::mark_unsynced(size_t inst, const std::string& why) {
+    books_[inst].synced = false;
+    // 与断线相同：清掉最近消息时间，合并端据此排除；新快照应用后 publish_changes 重新写入
+    books_[inst].handoff->live_ns.store(0, std::memory_order_relaxed);
+    if (aggregator_) aggregator_->on_book_down(this, inst);
+    resyncs_.fetch_add(1, std::memory_order_relaxed);
+    std::cerr << "[" << name_ << "] " << instruments_[inst].symbol << " " << why << ", resyncing" << std::endl;
+}
+
+void Connector::mark_gap(size_t inst, uint64_t expected, uint64_t got) {
+    mark_unsynced(inst, "sequence gap: expected " + std::to_string(expected) + ", got " + std::to_string(got));
+}
+
+void Connector::print_book(size_t inst) const {
+    std::lock_guard<std::mutex> lock(book_mutex_);
+    const VenueBook& vb = books_[inst];
+    const int64_t tick_units = vb.tick_units;
+
+    if (vb.bids.empty() && vb.asks.empty()) {
         return;
     }
 
@@ -58,140 +439,262 @@ void Connector::print_book() const {
 
     localtime_r(&timer, &bt);  // <--- 用线程安全的 localtime_r 替换 std::localtime
 
-    std::cout << "\n=== [" << name_ << "] BTCUSDT 订单簿更新 ===" 
+    std::cout << "\n=== [" << name_ << "] " << instruments_[inst].symbol << " 订单簿更新 ===" 
               << std::put_time(&bt, "%Y-%m-%d %H:%M:%S")  // 需要 <iomanip>
               << '.' << std::setfill('0') << std::setw(3) << ms.count() << " ===\n";
 
     std::cout << std::fixed << std::setprecision(2);
     std::cout << "Bids (买盘 Top 10):\n";
     int count = 0;
-    for (auto it = local_bids_.begin(); it != local_bids_.end() && count < 10; ++it, ++count) {
-        std::cout << "  Price: " << std::setw(12) << it->first
-                  << "  Qty: " << std::setw(12) << it->second << "\n";
+    for (const auto& [price, qty] : vb.bids) {
+        if (count++ >= 10) break;
+        std::cout << "  Price: " << std::setw(12) << ticks_to_price(price, tick_units)
+                  << "  Qty: " << std::setw(12) << quantity_to_double(qty) << "\n";
     }
 
     std::cout << "Asks (卖盘 Top 10):\n";
     count = 0;
-    for (const auto& [price, qty] : local_asks_) {
+    for (const auto& [price, qty] : vb.asks) {
         if (count++ >= 10) break;
-        std::cout << "  Price: " << std::setw(12) << price
-                  << "  Qty: " << std::setw(12) << qty << "\n";
+        std::cout << "  Price: " << std::setw(12) << ticks_to_price(price, tick_units)
+                  << "  Qty: " << std::setw(12) << quantity_to_double(qty) << "\n";
     }
     std::cout << "==============================================\n\n";
 }
 
-void Connector::run() {
-    while(running_){
-        try {
-            std::cout << "[" << name_ << "] Resolving host " << host() << ":" << port() << "..." << std::endl;
-            
-            tcp::resolver resolver(ioc_);
-            auto const results = resolver.resolve(host(), port());
+void Connector::connect() {
+    // 旧连接上的异步操作还没全部返回时不能替换流和读缓冲区，等最后一个回调返回后再连
+    if (stream_ops_ > 0) {
+        connect_waiting_ = true;
+        return;
+    }
+    const uint64_t session = ++session_;
+    std::cout << "[" << name_ << "] Resolving host " << endpoint_.host << ":" << endpoint_.port << "..." << std::endl;
+    resolver_.async_resolve(endpoint_.host, endpoint_.port,
+        [this, session](beast::error_code ec, tcp::resolver::results_type results) {
+            on_resolve(session, ec, std::move(results));
+        });
+}
 
-            if (results.empty()) {
-                std::cerr << "[" << name_ << "] Resolve failed: no endpoints" << std::endl;
-                return;
-            }
-            std::cout << "[" << name_ << "] Creating WebSocket stream..." << std::endl;
+void Connector::on_resolve(uint64_t session, beast::error_code ec, tcp::resolver::results_type results) {
+    if (session != session_) return;
+    if (ec) return fail(session, ec, "Resolve");
+    if (results.empty()) return fail(session, net::error::host_not_found, "Resolve");
 
-            ws_ = std::make_unique<websocket::stream<beast::ssl_stream<tcp::socket>>>(ioc_, ctx_);
-            if (!ws_) {
-                std::cerr << "[" << name_ << "] Failed to allocate WebSocket stream (nullptr)" << std::endl;
-                return;
-            }
-            
-            std::cout << "[" << name_ << "] Connecting TCP..." << std::endl;
-            net::connect(ws_->next_layer().next_layer(), results.begin(), results.end());
-
-            std::cout << "[" << name_ << "] Setting SNI..." << std::endl;
-            if (!SSL_set_tlsext_host_name(ws_->next_layer().native_handle(), host().c_str())) {
-                beast::error_code ec{static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()};
-                std::cerr << "[" << name_ << "] SNI failed: " << ec.message() << std::endl;
-                return;
-            }
-        
-            std::cout << "[" << name_ << "] SSL handshake..." << std::endl;
-            ws_->next_layer().handshake(ssl::stream_base::client);
-
-            std::cout << "[" << name_ << "] WebSocket handshake..." << std::endl;
-            ws_->handshake(host() + ":" + port(), path());
-
-            // std::cout << "WebSocket connected to " << host() << std::endl;
-            std::cout << "[" << name_ << "] WebSocket CONNECTED and subscribed" << std::endl;
-            ws_->write(net::buffer(subscribe_message()));
-            std::cout << "[" << name_ << "] Subscription sent: " << subscribe_message() << std::endl;
-            // std::cout << "Subscription sent: " << subscribe_message() << std::endl;
-
-            beast::flat_buffer buffer;
-            
-            while (running_) {
-                beast::error_code ec;
-                ws_->read(buffer, ec);
-
-                if (ec) {
-                    if (ec == websocket::error::closed ||
-                        ec == boost::asio::error::eof ||
-                        ec == boost::asio::error::operation_aborted) {
-                        std::cout << "[" << name_ << "] WebSocket closed normally: " << ec.message() << std::endl;
-                    } else {
-                        std::cerr << "[" << name_ << "] WebSocket read error: " << ec.message() 
-                                << " (code: " << ec.value() << ")" << std::endl;
-                    }
-                    break;
-                }
-
-                std::string msg = beast::buffers_to_string(buffer.data());
-                buffer.consume(buffer.size());
-
-                parse_message(msg);
-            }
-        // } catch (std::exception const& e) {
-        //     std::cerr << "Error: " << e.what() << std::endl;
-        } catch (const beast::error_code& ec) {
-            std::cerr << "[" << name_ << "] Beast error: " << ec.message() << std::endl;
-        } catch (const std::exception& e) {
-            std::cerr << "[" << name_ << "] Exception in run: " << e.what() << std::endl;
-        } catch (...) {
-            std::cerr << "[" << name_ << "] Unknown exception in run" << std::endl;
-        }
+    std::cout << "[" << name_ << "] Connecting TCP..." << std::endl;
+    if (endpoint_.tls) {
+        ws_ = std::make_unique<WsStream>(strand_, ctx_);
+        plain_ws_.reset();
+    } else {
+        plain_ws_ = std::make_unique<PlainWsStream>(strand_);
+        ws_.reset();
+    }
+    buffer_.clear();
+    with_stream([&](auto& ws) {
+        beast::get_lowest_layer(ws).expires_after(std::chrono::seconds(30));
+        ++stream_ops_;
+        beast::get_lowest_layer(ws).async_connect(results,
+            [this, session](beast::error_code ec, const tcp::endpoint&) { on_connect(session, ec); });
+    });
+}
 
-        // 重连前延迟（避免洪泛）
-        if (running_) {
-            std::cout << "[" << name_ << "] Reconnecting in 5 seconds..." << std::endl;
-            std::this_thread::sleep_for(std::chrono::seconds(5));
-        }
+void Connector::on_connect(uint64_t session, beast::error_code ec) {
+    stream_op_done();
+    if (session != session_) return;
+    if (ec) return fail(session, ec, "Connect");
+    if (!endpoint_.tls) return on_ssl_handshake(session, {});
 
-        // 安全清理旧 ws_
-        if (ws_) {
-            beast::error_code ec;
-            ws_->close(websocket::close_code::normal, ec);
-            ws_.reset();  // 释放
-        }
+    std::cout << "[" << name_ << "] Setting SNI..." << std::endl;
+    if (!SSL_set_tlsext_host_name(ws_->next_layer().native_handle(), endpoint_.host.c_str())) {
+        beast::error_code sni_ec{static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()};
+        return fail(session, sni_ec, "SNI");
     }
-    std::cout << "[" << name_ << "] Run loop exited" << std::endl;
-}
-
-void Connector::ping_loop() {
-    std::cout << "[" << name_ << "] Ping loop started" << std::endl;
-    while (running_) {
-        std::this_thread::sleep_for(std::chrono::seconds(15));
-        if (running_ && ws_) {
-            // beast::error_code ec;
-            boost::system::error_code ec;
-            // ws_->ping("", ec);  // <--- 加 error_code
-            // --- 修改处开始 ---
-            // 不要使用 ws_->ping("")，Bitget 往往需要文本消息
-            ws_->text(true); // 确保设置为文本模式
-            ws_->write(boost::asio::buffer(std::string("ping")), ec);
-            // --- 修改处结束 ---
-
-            if (ec) {
-                std::cerr << "[" << name_ << "] Ping failed: " << ec.message() << std::endl;
-            } else {
-                std::cout << "[" << name_ << "] Sent ping" << std::endl;
-            }
+
+    std::cout << "[" << name_ << "] SSL handshake..." << std::endl;
+    beast::get_lowest_layer(*ws_).expires_after(std::chrono::seconds(30));
+    ++stream_ops_;
+    ws_->next_layer().async_handshake(ssl::stream_base::client,
+        [this, session](beast::error_code ec) {
+            stream_op_done();
+            on_ssl_handshake(session, ec);
+        });
+}
+
+void Connector::on_ssl_handshake(uint64_t session, beast::error_code ec) {
+    if (session != session_) return;
+    if (ec) return fail(session, ec, "SSL handshake");
+
+    // 之后由 websocket 自己的超时设置接管
+    std::cout << "[" << name_ << "] WebSocket handshake..." << std::endl;
+    with_stream([&](auto& ws) {
+        beast::get_lowest_layer(ws).expires_never();
+        ws.set_option(websocket::stream_base::timeout::suggested(beast::role_type::client));
+        ++stream_ops_;
+        ws.async_handshake(endpoint_.host + ":" + endpoint_.port, endpoint_.path,
+            [this, session](beast::error_code ec) { on_handshake(session, ec); });
+    });
+}
+
+void Connector::on_handshake(uint64_t session, beast::error_code ec) {
+    stream_op_done();
+    if (session != session_) return;
+    if (ec) return fail(session, ec, "WebSocket handshake");
+
+    std::cout << "[" << name_ << "] WebSocket CONNECTED and subscribed" << std::endl;
+    with_stream([](auto& ws) { ws.text(true); });  // Bitget 等需要文本帧的 ping
+    // 新连接上的增量与旧簿衔接不上，等新快照；旧簿保留到新快照替换它
+    for (auto& vb : books_) vb.synced = false;
+    on_session_start();
+    for (std::string& sub : subscribe_messages()) {
+        std::cout << "[" << name_ << "] Subscription sent: " << sub << std::endl;
+        send(std::move(sub));
+    }
+    if (needs_ping()) {
+        start_ping_timer(session);
+    }
+    connected_ns_ = mono_ns();
+    if (read_timeout_ns_ > 0) start_read_watchdog(session);
+    do_read(session);
+}
+
+void Connector::do_read(uint64_t session) {
+    with_stream([&](auto& ws) {
+        ++stream_ops_;
+        ws.async_read(buffer_, [this, session](beast::error_code ec, size_t) { on_read(session, ec); });
+    });
+}
+
+void Connector::on_read(uint64_t session, beast::error_code ec) {
+    stream_op_done();
+    if (session != session_) return;
+    if (ec) {
+        if (ec == websocket::error::closed || ec == net::error::eof) {
+            std::cout << "[" << name_ << "] WebSocket closed normally: " << ec.message() << std::endl;
         }
+        return fail(session, ec, "WebSocket read");
     }
-    std::cout << "[" << name_ << "] Ping loop exited" << std::endl;
+
+    // flat_buffer 是连续内存，直接把帧交给解析，不再拷贝成 std::string
+    try {
+        auto data = buffer_.data();
+        handle_frame(std::string_view(static_cast<const char*>(data.data()), data.size()));
+    } catch (const std::exception& e) {
+        std::cerr << "[" << name_ << "] Exception in parse: " << e.what() << std::endl;
+        return fail(session, {}, "Parse");
+    }
+    buffer_.consume(buffer_.size());
+    reconnect_attempt_ = 0;  // 连接确实在收数据，下次断线从最短退避开始
+    do_read(session);
+}
+
+void Connector::handle_frame(std::string_view frame) {
+    frame_recv_ns_ = mono_ns();
+    frame_recv_unix_ns_ = unix_ns();
+    // 只有 strand 写，不需要原子加
+    frames_.store(frames_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    last_frame_ns_.store(frame_recv_ns_, std::memory_order_relaxed);
+    if (capture_) {
+        capture_->append(static_cast<uint8_t>(venue_), frame_recv_unix_ns_, frame);
+    }
+    parse_message(frame);
+}
+
+void Connector::send(std::string msg) {
+    write_queue_.push_back(std::move(msg));
+    if (!writing_) do_write();
+}
+
+void Connector::do_write() {
+    writing_ = true;
+    const uint64_t session = session_;
+    with_stream([&](auto& ws) {
+        ++stream_ops_;
+        ws.async_write(net::buffer(write_queue_.front()),
+            [this, session](beast::error_code ec, size_t) { on_write(session, ec); });
+    });
 }
 
+void Connector::on_write(uint64_t session, beast::error_code ec) {
+    stream_op_done();
+    // 连接已作废时也要在这里弹出：写操作返回之前队首一直被它引用
+    write_queue_.pop_front();
+    writing_ = false;
+    if (session != session_) return;
+    if (ec) return fail(session, ec, "Write");
+    if (!write_queue_.empty()) do_write();
+}
+
+void Connector::stream_op_done() {
+    if (--stream_ops_ == 0 && connect_waiting_) {
+        connect_waiting_ = false;
+        net::post(strand_, [this]() { connect(); });
+    }
+}
+
+void Connector::start_ping_timer(uint64_t session) {
+    // 至少每半个 AGG_STALE_MS ping 一次：连接上的交易对都安静时，靠 pong 让 live() 知道连接还活着
+    int64_t interval_ns = 15000 * 1000000LL;
+    if (stale_ns_ > 0) interval_ns = std::min(interval_ns, std::max<int64_t>(stale_ns_ / 2, 1000 * 1000000LL));
+    ping_timer_.expires_after(std::chrono::nanoseconds(interval_ns));
+    ping_timer_.async_wait([this, session](beast::error_code ec) {
+        if (ec || session != session_) return;
+        // 不要使用 ws_->ping("")，Bitget 往往需要文本消息
+        send("ping");
+        std::cout << "[" << name_ << "] Sent ping" << std::endl;
+        start_ping_timer(session);
+    });
+}
+
+void Connector::start_read_watchdog(uint64_t session) {
+    // 按阈值的四分之一检查一次，不在每帧上重设定时器
+    read_timer_.expires_after(std::chrono::nanoseconds(std::max<int64_t>(read_timeout_ns_ / 4, 1000000)));
+    read_timer_.async_wait([this, session](beast::error_code ec) {
+        if (ec || session != session_) return;
+        const int64_t idle = mono_ns() - std::max(last_frame_ns_.load(std::memory_order_relaxed), connected_ns_);
+        if (idle > read_timeout_ns_) {
+            read_timeouts_.fetch_add(1, std::memory_order_relaxed);
+            std::cerr << "[" << name_ << "] No data for " << idle / 1000000 << " ms" << std::endl;
+            return fail(session, beast::error::timeout, "Read timeout");
+        }
+        start_read_watchdog(session);
+    });
+}
+
+std::chrono::milliseconds Connector::backoff_delay() {
+    const int shift = std::min(reconnect_attempt_++, 20);
+    const auto cap = std::min(reconnect_max_, reconnect_min_ * (int64_t(1) << shift));
+    std::uniform_int_distribution<int64_t> jitter(cap.count() / 2, cap.count());
+    return std::chrono::milliseconds(jitter(jitter_));
+}
+
+void Connector::fail(uint64_t session, beast::error_code ec, const char* what) {
+    if (session != session_) return;
+    ++session_;  // 作废本连接所有未完成的回调
+
+    if (ec && ec != websocket::error::closed && ec != net::error::eof) {
+        std::cerr << "[" << name_ << "] " << what << " error: " << ec.message()
+                  << " (code: " << ec.value() << ")" << std::endl;
+    }
+    ping_timer_.cancel();
+    read_timer_.cancel();
+    // 正在写的那条仍被 async_write 引用，留给 on_write 弹出；其余未发出的丢弃
+    if (writing_) write_queue_.erase(write_queue_.begin() + 1, write_queue_.end());
+    else write_queue_.clear();
+    // 只关闭 socket，未完成的操作随之以错误返回；流对象和读缓冲区等它们全部返回后才在 connect 里替换
+    close_socket();
+
+    // 断线的本地簿立即退出合并，等新连接上的消息再加回来
+    for (auto& vb : books_) vb.handoff->live_ns.store(0, std::memory_order_relaxed);
+    aggregator_->on_feed_down(this);
+
+    // 重连前按指数退避延迟（避免洪泛）
+    if (!running_) return;
+    const auto delay = backoff_delay();
+    reconnects_.fetch_add(1, std::memory_order_relaxed);
+    std::cout << "[" << name_ << "] Reconnecting in " << delay.count() << " ms (attempt "
+              << reconnect_attempt_ << ")..." << std::endl;
+    reconnect_timer_.expires_after(delay);
+    reconnect_timer_.async_wait([this](beast::error_code ec) {
+        if (!ec && running_) connect();
+    });
+}
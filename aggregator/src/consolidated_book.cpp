@@ -0,0 +1,131 @@
+#include "consolidated_book.h"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+void exclude_venue(ConsolidatedBook& book, Venue venue, std::vector<LevelChange>& scratch) {
+    const uint32_t bit = 1u << venue;
+    scratch.clear();
+    for (const auto& [price, lvl] : book.bids) {
+        if (lvl.venue_mask & bit) scratch.push_back({true, price, 0});
+    }
+    for (const auto& [price, lvl] : book.asks) {
+        if (lvl.venue_mask & bit) scratch.push_back({false, price, 0});
+    }
+    apply_changes(book, venue, scratch);
+}
+
+bool include_venue(ConsolidatedBook& book, Connector& connector, size_t inst, std::vector<LevelChange>& scratch) {
+    // 持有 book_mutex_ 时本地簿不变：排除期间攒下的变化都已体现在本地簿里，丢掉后整本加回
+    std::lock_guard<std::mutex> book_lock(connector.book_mutex_);
+    VenueBook& vb = connector.books_[inst];
+    connector.drain_changes(inst, [](const ChangeBatch&) {});
+    vb.changes.clear();
+    vb.changes_recv_ns = 0;
+    // 本地簿每边只有带内的稠密部分，先按两端检查，放不下就整本不加
+    if ((!vb.bids.empty() && !book.bids.fits(vb.bids.worst_price(), vb.bids.best_price())) ||
+        (!vb.asks.empty() && !book.asks.fits(vb.asks.best_price(), vb.asks.worst_price()))) {
+        return false;
+    }
+    scratch.clear();
+    for (const auto& [price, qty] : vb.bids) scratch.push_back({true, price, qty});
+    for (const auto& [price, qty] : vb.asks) scratch.push_back({false, price, qty});
+    apply_changes(book, connector.venue_, scratch);
+    book.venues[connector.venue_] = vb.stamp;
+    return true;
+}
+
+void net_crossed(ConsolidatedBook& book) {
+    Netting& n = book.netting;
+    n = Netting{};
+    if (book.bids.empty() || book.asks.empty() || book.bids.best_price() < book.asks.best_price()) return;
+    n.crossed = true;
+
+    auto bid = book.bids.begin();
+    auto ask = book.asks.begin();
+    Quantity bid_left = (*bid).second.total;
+    Quantity ask_left = (*ask).second.total;
+    while ((*bid).first >= (*ask).first) {
+        const Quantity m = std::min(bid_left, ask_left);
+        bid_left -= m;
+        ask_left -= m;
+        n.netted += m;
+        if (bid_left == 0 && ++bid != book.bids.end()) bid_left = (*bid).second.total;
+        if (ask_left == 0 && ++ask != book.asks.end()) ask_left = (*ask).second.total;
+        if (bid == book.bids.end() || ask == book.asks.end()) break;
+    }
+
+    // 各交易所按最近一次更新从早到晚排序，档内对冲量按这个顺序扣
+    int order[kVenueCount];
+    for (int v = 0; v < kVenueCount; ++v) order[v] = v;
+    std::sort(std::begin(order), std::end(order), [&](int a, int b) {
+        return book.venues[a].recv_unix_ns < book.venues[b].recv_unix_ns;
+    });
+    auto finish = [&](auto it, auto end, Quantity left, NettedSide& side, PriceTicks none) {
+        if (it == end) {
+            side.price = none;
+            return;
+        }
+        const auto [price, lvl] = *it;
+        side.price = price;
+        side.partial = left != lvl.total;
+        if (!side.partial) return;
+        side.level = TopLevel{price, left, lvl.venue_mask};
+        std::copy(std::begin(lvl.qty), std::end(lvl.qty), std::begin(side.level.venue_qty));
+        Quantity consumed = lvl.total - left;
+        for (int v : order) {
+            Quantity& q = side.level.venue_qty[v];
+            const Quantity take = std::min(q, consumed);
+            q -= take;
+            consumed -= take;
+            if (q == 0) side.level.venue_mask &= ~(1u << v);
+        }
+    };
+    finish(bid, book.bids.end(), bid_left, n.bids, std::numeric_limits<PriceTicks>::min());
+    finish(ask, book.asks.end(), ask_left, n.asks, std::numeric_limits<PriceTicks>::max());
+}
+
+void refresh_depth(ConsolidatedBook& book) {
+    book.bid_depth.refresh(book.bids);
+    book.ask_depth.refresh(book.asks);
+}
+
+DepthView tradable_depth(const ConsolidatedBook& book, bool is_bid) {
+    const DepthSide& side = is_bid ? book.bid_depth : book.ask_depth;
+    size_t first = 0;
+    const NettedSide& netted = is_bid ? book.netting.bids : book.netting.asks;
+    if (book.netting.crossed) first = side.first_at_or_worse(netted.price);
+    if (first >= side.size()) return DepthView(side, first, 0);
+    return DepthView(side, first, book.netting.crossed && netted.partial ? netted.level.qty : side.qty(first));
+}
+
+bool apply_changes(ConsolidatedBook& book, Venue venue, const std::vector<LevelChange>& changes) {
+    const uint32_t bit = 1u << venue;
+    auto apply = [&](auto& side, const LevelChange& c) {
+        if (c.qty > 0) {
+            ConsolidatedLevel* lvl = side.find_or_insert(c.price);
+            if (!lvl) return false;
+            lvl->total += c.qty - lvl->qty[venue];
+            lvl->qty[venue] = c.qty;
+            lvl->venue_mask |= bit;
+        } else {
+            ConsolidatedLevel* lvl = side.find(c.price);
+            if (!lvl) return true;
+            lvl->total -= lvl->qty[venue];
+            lvl->qty[venue] = 0;
+            lvl->venue_mask &= ~bit;
+            if (lvl->venue_mask == 0) side.erase(c.price);
+        }
+        return true;
+    };
+    for (const auto& c : changes) {
+        if (c.is_bid) {
+            if (!apply(book.bids, c)) return false;
+            book.bid_depth.touch(c.price);
+        } else {
+            if (!apply(book.asks, c)) return false;
+            book.ask_depth.touch(c.price);
+        }
+    }
+    return true;
+}
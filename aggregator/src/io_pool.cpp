@@ -0,0 +1,37 @@
+#include "io_pool.h"
+#include <algorithm>
+#include <iostream>
+
+IoPool::IoPool(size_t size) {
+    if (size == 0) size = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < size; ++i) {
+        // 每个 io_context 只由一个线程驱动
+        contexts_.push_back(std::make_unique<boost::asio::io_context>(1));
+        guards_.push_back(boost::asio::make_work_guard(*contexts_.back()));
+    }
+}
+
+IoPool::~IoPool() {
+    stop();
+}
+
+boost::asio::io_context& IoPool::next() {
+    return *contexts_[next_++ % contexts_.size()];
+}
+
+void IoPool::start() {
+    if (!threads_.empty()) return;
+    std::cout << "[IoPool] Starting " << contexts_.size() << " io threads" << std::endl;
+    for (auto& ioc : contexts_) {
+        threads_.emplace_back([ctx = ioc.get()] { ctx->run(); });
+    }
+}
+
+void IoPool::stop() {
+    guards_.clear();
+    for (auto& ioc : contexts_) ioc->stop();
+    for (auto& t : threads_) {
+        if (t.joinable()) t.join();
+    }
+    threads_.clear();
+}
@@ -0,0 +1,95 @@
+#include "latency.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+constexpr double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+}
+
+int LatencyHistogram::bucket(uint64_t v) {
+    if (v < kSub) return static_cast<int>(v);
+    const uint64_t limit = (uint64_t(1) << kMaxBits) - 1;
+    if (v > limit) v = limit;
+    const int msb = 63 - __builtin_clzll(v);
+    const int shift = msb - kSubBits;
+    return (shift + 1) * kSub + static_cast<int>((v >> shift) & (kSub - 1));
+}
+
+uint64_t LatencyHistogram::bucket_upper(int idx) {
+    if (idx < kSub) return static_cast<uint64_t>(idx);
+    const int shift = idx / kSub - 1;
+    const uint64_t base = static_cast<uint64_t>(kSub + idx % kSub) << shift;
+    return base + (uint64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(int64_t ns) {
+    const uint64_t v = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+    counts_[bucket(v)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(v, std::memory_order_relaxed);
+    uint64_t prev = max_ns_.load(std::memory_order_relaxed);
+    while (v > prev && !max_ns_.compare_exchange_weak(prev, v, std::memory_order_relaxed)) {
+    }
+}
+
+int64_t LatencyHistogram::percentile(double q) const {
+    uint64_t total = 0;
+    for (const auto& c : counts_) total += c.load(std::memory_order_relaxed);
+    if (total == 0) return 0;
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * total)));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += counts_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) return static_cast<int64_t>(std::min(bucket_upper(i), max_ns()));
+    }
+    return static_cast<int64_t>(max_ns());
+}
+
+std::string LatencyMetrics::prometheus() const {
+    std::string out =
+        "# HELP agg_stage_latency_seconds Per-stage latency from WebSocket receive to gRPC write.\n"
+        "# TYPE agg_stage_latency_seconds summary\n";
+    char line[256];
+    auto emit = [&](const char* stage, const char* venue, const LatencyHistogram& h) {
+        std::string labels = std::string("stage=\"") + stage + "\"";
+        if (venue) labels += std::string(",venue=\"") + venue + "\"";
+        for (double q : kQuantiles) {
+            std::snprintf(line, sizeof line, "agg_stage_latency_seconds{%s,quantile=\"%g\"} %.9f\n",
+                          labels.c_str(), q, h.percentile(q) / 1e9);
+            out += line;
+        }
+        std::snprintf(line, sizeof line, "agg_stage_latency_seconds_sum{%s} %.9f\n", labels.c_str(),
+                      h.sum_ns() / 1e9);
+        out += line;
+        std::snprintf(line, sizeof line, "agg_stage_latency_seconds_count{%s} %llu\n", labels.c_str(),
+                      static_cast<unsigned long long>(h.count()));
+        out += line;
+    };
+    for (int v = 0; v < kVenueCount; ++v) emit("parse", venue_label(v), parse[v]);
+    for (int v = 0; v < kVenueCount; ++v) emit("queue", venue_label(v), queue[v]);
+    emit("merge", nullptr, merge);
+    emit("publish", nullptr, publish);
+    emit("write", nullptr, write);
+    emit("total", nullptr, total);
+
+    out += "# HELP agg_stage_latency_max_seconds Largest sample seen per stage.\n"
+           "# TYPE agg_stage_latency_max_seconds gauge\n";
+    auto emit_max = [&](const char* stage, const char* venue, const LatencyHistogram& h) {
+        if (venue) {
+            std::snprintf(line, sizeof line, "agg_stage_latency_max_seconds{stage=\"%s\",venue=\"%s\"} %.9f\n",
+                          stage, venue, h.max_ns() / 1e9);
+        } else {
+            std::snprintf(line, sizeof line, "agg_stage_latency_max_seconds{stage=\"%s\"} %.9f\n", stage,
+                          h.max_ns() / 1e9);
+        }
+        out += line;
+    };
+    for (int v = 0; v < kVenueCount; ++v) emit_max("parse", venue_label(v), parse[v]);
+    for (int v = 0; v < kVenueCount; ++v) emit_max("queue", venue_label(v), queue[v]);
+    emit_max("merge", nullptr, merge);
+    emit_max("publish", nullptr, publish);
+    emit_max("write", nullptr, write);
+    emit_max("total", nullptr, total);
+    return out;
+}
@@ -0,0 +1,152 @@
+#include "merge_scheduler.h"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+constexpr auto kStatsInterval = std::chrono::seconds(30);  // 指标打印间隔
+
+int64_t to_ns(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+}
+
+MergeScheduler::MergeScheduler(const std::vector<Instrument>& instruments,
+                               std::chrono::microseconds window, MergeFn merge,
+                               std::chrono::milliseconds check_interval)
+    : instruments_(instruments), window_(window), merge_(std::move(merge)), check_interval_(check_interval),
+      pending_(instruments.size()), stats_(instruments.size()) {}
+
+MergeScheduler::~MergeScheduler() {
+    stop();
+}
+
+void MergeScheduler::start() {
+    if (thread_.joinable()) return;
+    std::cout << "[Merge] window " << window_.count() << " us" << std::endl;
+    thread_ = std::thread([this] { run(); });
+}
+
+void MergeScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+void MergeScheduler::mark_dirty(size_t inst, Venue venue) {
+    Pending& p = pending_[inst];
+    if (p.venues.load(std::memory_order_relaxed) == 0) {
+        p.first_dirty_ns.store(to_ns(std::chrono::steady_clock::now()), std::memory_order_relaxed);
+    }
+    p.notifications.fetch_add(1, std::memory_order_relaxed);
+    if (p.venues.fetch_or(1u << venue, std::memory_order_acq_rel) != 0) return;
+    // 只有从无到有才需要唤醒。递增后空锁一次，保证合并线程不会卡在检查条件和入睡之间漏掉通知；
+    // notify 放在锁外，被唤醒的合并线程不必再等这把锁
+    if (dirty_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+        { std::lock_guard<std::mutex> lock(mutex_); }
+        cv_.notify_one();
+    }
+}
+
+MergeScheduler::Stats MergeScheduler::stats(size_t inst) const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_[inst];
+}
+
+void MergeScheduler::run() {
+    struct Batch {
+        size_t inst;
+        uint32_t venues;
+        uint64_t notifications;
+        int64_t first_dirty_ns;
+    };
+    std::vector<Batch> batch;
+    auto next_log = std::chrono::steady_clock::now() + kStatsInterval;
+    auto next_check = check_interval_.count() > 0 ? std::chrono::steady_clock::now() + check_interval_
+                                                  : std::chrono::steady_clock::time_point::max();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait_until(lock, std::min(next_log, next_check),
+                       [this] { return stop_ || dirty_.load(std::memory_order_acquire) > 0; });
+        if (stop_) break;
+
+        if (dirty_.load(std::memory_order_acquire) > 0 && window_.count() > 0) {
+            // 从最早的一次标记起等满一个窗口，期间到达的变化一起合并
+            int64_t first = INT64_MAX;
+            for (const auto& p : pending_) {
+                if (p.venues.load(std::memory_order_relaxed)) {
+                    first = std::min(first, p.first_dirty_ns.load(std::memory_order_relaxed));
+                }
+            }
+            if (first != INT64_MAX) {
+                std::chrono::steady_clock::time_point deadline{
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::nanoseconds(first) + window_)};
+                cv_.wait_until(lock, deadline, [this] { return stop_; });
+                if (stop_) break;
+            }
+        }
+        lock.unlock();
+
+        // 先清计数再取位图：取走之后再被标记的交易对一定会让计数重新从 0 变 1
+        dirty_.store(0, std::memory_order_release);
+        batch.clear();
+        for (size_t i = 0; i < pending_.size(); ++i) {
+            Pending& p = pending_[i];
+            uint32_t venues = p.venues.exchange(0, std::memory_order_acq_rel);
+            if (venues == 0) continue;
+            batch.push_back({i, venues, p.notifications.exchange(0, std::memory_order_relaxed),
+                             p.first_dirty_ns.load(std::memory_order_relaxed)});
+        }
+
+        for (const auto& b : batch) {
+            auto start = std::chrono::steady_clock::now();
+            merge_(b.inst, b.venues);
+            int64_t delay = to_ns(start) - b.first_dirty_ns;
+            std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+            Stats& s = stats_[b.inst];
+            s.notifications += b.notifications;
+            ++s.merges;
+            if (delay > 0) {
+                s.delay_sum_ns += delay;
+                s.delay_max_ns = std::max<uint64_t>(s.delay_max_ns, delay);
+            }
+        }
+
+        if (std::chrono::steady_clock::now() >= next_check) {
+            for (size_t i = 0; i < pending_.size(); ++i) merge_(i, 0);
+            next_check = std::chrono::steady_clock::now() + check_interval_;
+        }
+        if (std::chrono::steady_clock::now() >= next_log) {
+            log_stats();
+            next_log = std::chrono::steady_clock::now() + kStatsInterval;
+        }
+        lock.lock();
+    }
+}
+
+void MergeScheduler::log_stats() {
+    std::vector<Stats> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        snapshot = stats_;
+    }
+    for (size_t i = 0; i < snapshot.size(); ++i) {
+        const Stats& s = snapshot[i];
+        if (s.merges == 0) continue;
+        std::ostringstream out;
+        out << "[Merge] " << instruments_[i].symbol << ": " << s.notifications
+            << " updates -> " << s.merges << " merges (" << std::fixed << std::setprecision(2)
+            << double(s.notifications) / s.merges << "x), added latency avg "
+            << s.delay_sum_ns / s.merges / 1000 << " us, max " << s.delay_max_ns / 1000
+            << " us";
+        std::cout << out.str() << std::endl;
+    }
+}
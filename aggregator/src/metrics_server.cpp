@@ -0,0 +1,80 @@
+#include "metrics_server.h"
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <iostream>
+#include <memory>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+namespace {
+// 一个连接：读一个请求、回一个响应后关闭
+class MetricsSession : public std::enable_shared_from_this<MetricsSession> {
+public:
+    MetricsSession(tcp::socket socket, const std::function<std::string()>& render)
+        : stream_(std::move(socket)), render_(render) {}
+
+    void run() {
+        stream_.expires_after(std::chrono::seconds(5));
+        http::async_read(stream_, buffer_, request_,
+            [self = shared_from_this()](beast::error_code ec, size_t) {
+                if (!ec) self->respond();
+            });
+    }
+
+private:
+    void respond() {
+        response_.version(request_.version());
+        response_.keep_alive(false);
+        if (request_.method() == http::verb::get) {
+            response_.result(http::status::ok);
+            response_.set(http::field::content_type, "text/plain; version=0.0.4");
+            response_.body() = render_();
+        } else {
+            response_.result(http::status::method_not_allowed);
+        }
+        response_.prepare_payload();
+        http::async_write(stream_, response_, [self = shared_from_this()](beast::error_code, size_t) {
+            beast::error_code ec;
+            self->stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+        });
+    }
+
+    beast::tcp_stream stream_;
+    const std::function<std::string()>& render_;
+    beast::flat_buffer buffer_;
+    http::request<http::string_body> request_;
+    http::response<http::string_body> response_;
+};
+}  // namespace
+
+MetricsServer::MetricsServer(unsigned short port, std::function<std::string()> render)
+    : acceptor_(ioc_, tcp::endpoint(net::ip::make_address("127.0.0.1"), port)),
+      render_(std::move(render)) {}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+void MetricsServer::start() {
+    if (thread_.joinable()) return;
+    std::cout << "[Metrics] Serving Prometheus text on http://127.0.0.1:"
+              << acceptor_.local_endpoint().port() << "/metrics" << std::endl;
+    do_accept();
+    thread_ = std::thread([this] { ioc_.run(); });
+}
+
+void MetricsServer::stop() {
+    ioc_.stop();
+    if (thread_.joinable()) thread_.join();
+}
+
+void MetricsServer::do_accept() {
+    acceptor_.async_accept([this](beast::error_code ec, tcp::socket socket) {
+        if (ec) return;
+        std::make_shared<MetricsSession>(std::move(socket), render_)->run();
+        do_accept();
+    });
+}
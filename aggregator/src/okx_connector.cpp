@@ -3,60 +3,69 @@
 #include <iostream>
 #include <iomanip>
 
-#include "aggregator.h"
+#include "depth_parser.h"
 
 using json = nlohmann::json;
 
-OKXConnector::OKXConnector(Aggregator* aggregator)
-    : Connector(aggregator, "OKX",0.1) {}
+OKXConnector::OKXConnector(BookListener* aggregator, net::io_context& ioc, const std::vector<Instrument>& instruments)
+    : Connector(aggregator, ioc, "OKX", kOKX, instruments) {
+    for (const auto& inst : instruments) {
+        venue_symbols_.push_back(inst.base + "-" + inst.quote);  // BTC-USDT
+    }
+}
 
-void OKXConnector::parse_message(const std::string& msg) {
+void OKXConnector::parse_message(std::string_view msg) {
     // <--- 新增：过滤 pong 响应（常见格式）
-    std::string trimmed = msg;
-    // 去除空白字符
-    trimmed.erase(std::remove_if(trimmed.begin(), trimmed.end(), ::isspace), trimmed.end());
-
-    if (trimmed == "pong" ||
-        trimmed == "{\"pong\":true}" ||
-        trimmed == "{\"event\":\"pong\"}" ||
-        trimmed.rfind("pong", 0) == 0) {  // 以 "pong" 开头兜底
+    if (is_pong(msg)) {
         // 可选日志：std::cout << "[" << name_ << "] Ignored pong response" << std::endl;
         return;  // 直接返回，不解析
     }
+    if (fast_parse_ && parse_fast(msg)) {
+        return;
+    }
     try {
-        json j = json::parse(msg);
+        json j = json::parse(msg.begin(), msg.end());
         
+        // 订阅回包带回所订的频道（books 或 books5，见 book_arg）
         if (j.contains("event") && j["event"] == "subscribe") {
-            std::cout << "[OKX] Subscription SUCCESS (books50)" << std::endl;
+            const json arg = j.value("arg", json::object());
+            std::cout << "[OKX] Subscription SUCCESS (" << arg.value("channel", "?") << " "
+                      << arg.value("instId", "?") << ")" << std::endl;
             return;
         }
         if (j.contains("data") && j["data"].is_array() && !j["data"].empty()) {
             const auto& data = j["data"][0];
+            size_t inst = 0;
+            if (!j.contains("arg") ||
+                !find_instrument(j["arg"]["instId"].get_ref<const std::string&>(), inst)) {
+                return;
+            }
 
-            if (data.contains("bids") && data.contains("asks")) {
+            if (j.contains("action") && data.contains("bids") && data.contains("asks")) {
+                on_books(inst, j["action"].get_ref<const std::string&>(), data.dump(), data["bids"].dump(),
+                         data["asks"].dump());
+            } else if (data.contains("bids") && data.contains("asks")) {
                 {
-                    std::lock_guard<std::mutex> lock(book_mutex_);
-                    local_bids_.clear();
-                    local_asks_.clear();
+                    snapshot_bids_.clear();
+                    snapshot_asks_.clear();
                     // std::cout<<"[OKX Debug]"<<data["bids"][0]<<data["asks"][0]<<std::endl;
                     for (const auto& level : data["bids"]) {
-                        // double raw_price = std::stod(level[0].get<std::string>());
-                        // double price = standardize_price(raw_price, tick_size_,true);
-                        double price = std::stod(level[0].get<std::string>());
-                        double qty = std::stod(level[1].get<std::string>());
+                        PriceTicks price = to_ticks(inst, level[0].get_ref<const std::string&>(), true);
+                        Quantity qty = parse_quantity(level[1].get_ref<const std::string&>());
                         // printf("raw: %10.2f, bid: %10.2f,%.8f\n",raw_price,price,qty);
                         // printf("bid: %10.2f,%.8f\n",price,qty);
-                        if (qty > 0.0) local_bids_[price] += qty;
+                        if (qty > 0) snapshot_bids_.add(price, qty);
                     }
                     for (const auto& level : data["asks"]) {
-                        // double raw_price = std::stod(level[0].get<std::string>());
-                        // double price = standardize_price(raw_price, tick_size_,false);
-                        double price = std::stod(level[0].get<std::string>());
-                        double qty = std::stod(level[1].get<std::string>());
+                        PriceTicks price = to_ticks(inst, level[0].get_ref<const std::string&>(), false);
+                        Quantity qty = parse_quantity(level[1].get_ref<const std::string&>());
                         // printf("raw: %10.2f, ask: %10.2f,%.8f\n",raw_price,price,qty);
                         // printf("ask: %10.2f,%.8f\n",price,qty);
-                        if (qty > 0.0) local_asks_[price] += qty;
+                        if (qty > 0) snapshot_asks_.add(price, qty);
                     }
+                    std::lock_guard<std::mutex> lock(book_mutex_);
+                    set_stamp(inst, msg, "ts", "seqId");
+                    replace_book(inst);
                     // lock结束
                     //打印local_asks_第一个值
                     // std::cout<<"[OKX Debug]\t";
@@ -66,7 +75,7 @@ void OKXConnector::parse_message(const std::string& msg) {
                     // std::cout<<it->first<<","<<it->second<<std::endl;
                 }
                 if (aggregator_) {
-                    aggregator_->on_book_updated(this);
+                    aggregator_->on_book_updated(this, inst);
                 }
             }
         }
@@ -74,4 +83,81 @@ void OKXConnector::parse_message(const std::string& msg) {
         std::cerr << "Parse error: " << e.what() << std::endl;
     }
     
-}
\ No newline at end of file
+}
+
+// books 推送的快速路径；订阅回包等其他消息返回 false 交给 json 解析
+bool OKXConnector::parse_fast(std::string_view msg) {
+    std::string_view inst_id, data, bids, asks;
+    if (msg.find("\"event\"") != std::string_view::npos ||
+        !depth_parser::find_string(msg, "instId", inst_id) ||
+        !depth_parser::find_array(msg, "data", data) ||
+        !depth_parser::find_array(data, "bids", bids) ||
+        !depth_parser::find_array(data, "asks", asks)) {
+        return false;
+    }
+    size_t inst = 0;
+    if (!find_instrument(inst_id, inst)) {
+        return true;
+    }
+    std::string_view action;
+    if (depth_parser::find_string(msg, "action", action)) {
+        return on_books(inst, action, data, bids, asks);
+    }
+    snapshot_bids_.clear();
+    snapshot_asks_.clear();
+    if (!fill_snapshot_side(inst, bids, true, true) || !fill_snapshot_side(inst, asks, false, true)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(book_mutex_);
+        set_stamp(inst, data, "ts", "seqId");
+        replace_book(inst);
+    }
+    if (aggregator_) {
+        aggregator_->on_book_updated(this, inst);
+    }
+    return true;
+}
+
+bool OKXConnector::on_books(size_t inst, std::string_view action, std::string_view data, std::string_view bids,
+                            std::string_view asks) {
+    VenueBook& vb = books_[inst];
+    if (action == "snapshot") {
+        if (!apply_book_snapshot(inst, data, "ts", "seqId", bids, asks)) {
+            return false;
+        }
+    } else {
+        if (!vb.synced) {
+            return true;  // 等重新订阅后的快照
+        }
+        // 无变化时 OKX 也会推送 prevSeqId == seqId 的心跳式 update，同样满足衔接条件
+        uint64_t prev_seq = 0;
+        if (!depth_parser::find_uint(data, "prevSeqId", prev_seq) || prev_seq != vb.last_seq) {
+            mark_gap(inst, vb.last_seq, prev_seq);
+            resubscribe(inst);
+            return true;
+        }
+        if (!apply_book_update(inst, data, "ts", "seqId", bids, asks)) {
+            // 应用了一半的增量无法回退，按断档处理
+            mark_unsynced(inst, "bad level in books update");
+            resubscribe(inst);
+            return true;
+        }
+    }
+    if (!checksum_ok(inst, data)) {
+        // 已退出合并（见 mark_unsynced），不再通知，等重新订阅后的快照
+        resubscribe(inst);
+        return true;
+    }
+    if (aggregator_) {
+        aggregator_->on_book_updated(this, inst);
+    }
+    return true;
+}
+
+void OKXConnector::resubscribe(size_t inst) {
+    if (!running()) return;  // 回放时只能等录制里的下一份快照
+    const std::string arg = book_arg(venue_symbols_[inst]);
+    send(R"({"op":"unsubscribe","args":[)" + arg + "]}");
+    send(R"({"op":"subscribe","args":[)" + arg + "]}");
+}
@@ -0,0 +1,104 @@
+#include "rest_client.h"
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/ssl.hpp>
+#include <chrono>
+#include <memory>
+#include <openssl/err.h>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+namespace ssl = boost::asio::ssl;
+using tcp = net::ip::tcp;
+
+namespace {
+template <typename Stream>
+class RestRequest : public std::enable_shared_from_this<RestRequest<Stream>> {
+public:
+    RestRequest(Stream stream, net::any_io_executor executor, const RestTarget& target,
+                const std::string& path, RestCallback done)
+        : stream_(std::move(stream)), resolver_(executor), target_(target), done_(std::move(done)) {
+        request_.version(11);
+        request_.method(http::verb::get);
+        request_.target(path);
+        request_.set(http::field::host, target.host);
+        request_.set(http::field::user_agent, "aggregator");
+        request_.keep_alive(false);
+    }
+
+    void run() {
+        resolver_.async_resolve(target_.host, target_.port,
+            [self = this->shared_from_this()](beast::error_code ec, tcp::resolver::results_type results) {
+                if (ec) return self->finish(ec);
+                self->layer().expires_after(std::chrono::seconds(30));
+                self->layer().async_connect(results,
+                    [self](beast::error_code ec, const tcp::endpoint&) { self->on_connect(ec); });
+            });
+    }
+
+private:
+    beast::tcp_stream& layer() { return beast::get_lowest_layer(stream_); }
+
+    void on_connect(beast::error_code ec) {
+        if (ec) return finish(ec);
+        if constexpr (std::is_same_v<Stream, beast::ssl_stream<beast::tcp_stream>>) {
+            if (!SSL_set_tlsext_host_name(stream_.native_handle(), target_.host.c_str())) {
+                return finish({static_cast<int>(::ERR_get_error()), net::error::get_ssl_category()});
+            }
+            stream_.async_handshake(ssl::stream_base::client,
+                [self = this->shared_from_this()](beast::error_code ec) {
+                    if (ec) return self->finish(ec);
+                    self->write();
+                });
+        } else {
+            write();
+        }
+    }
+
+    void write() {
+        http::async_write(stream_, request_, [self = this->shared_from_this()](beast::error_code ec, size_t) {
+            if (ec) return self->finish(ec);
+            self->parser_.body_limit(64 << 20);  // 全量深度快照可能有几 MB
+            http::async_read(self->stream_, self->buffer_, self->parser_,
+                [self](beast::error_code ec, size_t) { self->finish(ec); });
+        });
+    }
+
+    void finish(beast::error_code ec) {
+        beast::error_code ignored;
+        layer().socket().shutdown(tcp::socket::shutdown_both, ignored);
+        unsigned status = 0;
+        std::string body;
+        if (!ec) {
+            auto& response = parser_.get();
+            status = response.result_int();
+            body = std::move(response.body());
+        }
+        done_(ec, status, std::move(body));
+    }
+
+    Stream stream_;
+    tcp::resolver resolver_;
+    RestTarget target_;
+    RestCallback done_;
+    http::request<http::empty_body> request_;
+    http::response_parser<http::string_body> parser_;
+    beast::flat_buffer buffer_;
+};
+}  // namespace
+
+void http_get(net::any_io_executor executor, ssl::context& ctx, const RestTarget& target,
+              const std::string& path, RestCallback done) {
+    if (target.tls) {
+        using Stream = beast::ssl_stream<beast::tcp_stream>;
+        std::make_shared<RestRequest<Stream>>(Stream(executor, ctx), executor, target, path,
+                                              std::move(done))->run();
+    } else {
+        std::make_shared<RestRequest<beast::tcp_stream>>(beast::tcp_stream(executor), executor, target,
+                                                         path, std::move(done))->run();
+    }
+}
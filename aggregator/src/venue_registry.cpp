@@ -0,0 +1,160 @@
+#include "venue_registry.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "binance_connector.h"
+#include "okx_connector.h"
+#include "bitget_connector.h"
+#include "bybit_connector.h"
+
+using json = nlohmann::json;
+
+Instrument make_instrument(const std::string& pair, double tick_size, const std::string& source) {
+    size_t dash = pair.find('-');
+    Instrument inst;
+    if (dash != std::string::npos) {
+        inst.base = pair.substr(0, dash);
+        inst.quote = pair.substr(dash + 1);
+    }
+    inst.symbol = inst.base + inst.quote;
+    inst.tick_size = tick_size;
+    inst.tick_units = tick_size_units(tick_size);
+    if (inst.base.empty() || inst.quote.empty()) {
+        throw std::invalid_argument("bad " + source + " entry: " + pair);
+    }
+    // 原始价位以 1e-8 为单位，tick 必须是它的整数倍
+    if (inst.tick_units == 0) {
+        std::ostringstream os;
+        os << "bad " << source << " entry: " << pair << ": tick " << tick_size << " is not a positive multiple of 1e-8";
+        throw std::invalid_argument(os.str());
+    }
+    return inst;
+}
+
+namespace {
+
+// AGG_SYMBOLS="BTC-USDT:0.1,ETH-USDT:0.01"，逗号分隔的 基础币-计价币:合并tick
+std::vector<Instrument> parse_symbols(const std::string& spec) {
+    std::vector<Instrument> out;
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t colon = item.find(':');
+        if (colon == std::string::npos) throw std::invalid_argument("bad AGG_SYMBOLS entry: " + item);
+        out.push_back(make_instrument(item.substr(0, colon), std::stod(item.substr(colon + 1)), "AGG_SYMBOLS"));
+    }
+    if (out.empty()) throw std::invalid_argument("AGG_SYMBOLS is empty");
+    return out;
+}
+
+Venue parse_venue(std::string name) {
+    for (auto& c : name) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    for (int v = 0; v < kVenueCount; ++v) {
+        if (name == venue_label(v)) return static_cast<Venue>(v);
+    }
+    throw std::invalid_argument("unknown venue in config: " + name);
+}
+
+// 只指定交易所、其余字段保持默认的配置
+VenueConfig default_venue(Venue venue) {
+    VenueConfig vc;
+    vc.venue = venue;
+    return vc;
+}
+
+AggregatorConfig load_file(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("cannot open AGG_CONFIG file " + path);
+    const json j = json::parse(in);
+
+    AggregatorConfig config;
+    for (const auto& s : j.value("symbols", json::array())) {
+        config.instruments.push_back(
+            make_instrument(s.at("symbol").get<std::string>(), s.at("tick_size").get<double>(), path));
+    }
+
+    // 不写 venues 时四个交易所全部启用
+    if (!j.contains("venues")) {
+        for (int v = 0; v < kVenueCount; ++v) config.venues.push_back(default_venue(static_cast<Venue>(v)));
+        return config;
+    }
+    bool seen[kVenueCount] = {};
+    for (const auto& e : j.at("venues")) {
+        VenueConfig vc = default_venue(parse_venue(e.at("venue").get<std::string>()));
+        if (seen[vc.venue]) throw std::invalid_argument("venue listed twice in " + path);
+        seen[vc.venue] = true;
+        if (!e.value("enabled", true)) {
+            std::cout << "[Config] " << venue_label(vc.venue) << " disabled" << std::endl;
+            continue;
+        }
+        vc.url = e.value("url", "");
+        vc.rest_url = e.value("rest_url", "");
+        vc.stale_ms = e.value("stale_ms", int64_t(-1));
+        vc.read_timeout_ms = e.value("read_timeout_ms", int64_t(-1));
+        if (e.contains("depth")) {
+            const std::string depth = e["depth"].get<std::string>();
+            if (depth != "full" && depth != "top") {
+                throw std::invalid_argument("depth must be \"full\" or \"top\" in " + path);
+            }
+            vc.full_depth = depth == "full";
+        }
+        for (const auto& s : e.value("symbols", json::array())) {
+            std::string symbol = s.get<std::string>();
+            symbol.erase(std::remove(symbol.begin(), symbol.end(), '-'), symbol.end());  // BTC-USDT -> BTCUSDT
+            vc.symbols.push_back(symbol);
+        }
+        config.venues.push_back(std::move(vc));
+    }
+    return config;
+}
+
+}  // namespace
+
+AggregatorConfig load_config() {
+    AggregatorConfig config;
+    const char* path = std::getenv("AGG_CONFIG");
+    if (path && *path) {
+        config = load_file(path);
+        std::cout << "[Config] Loaded " << path << ": " << config.venues.size() << " venues" << std::endl;
+    } else {
+        for (int v = 0; v < kVenueCount; ++v) config.venues.push_back(default_venue(static_cast<Venue>(v)));
+    }
+
+    const char* symbols = std::getenv("AGG_SYMBOLS");
+    if (symbols && *symbols) {
+        config.instruments = parse_symbols(symbols);
+    } else if (config.instruments.empty()) {
+        config.instruments = parse_symbols("BTC-USDT:0.1");
+    }
+
+    for (const VenueConfig& vc : config.venues) {
+        for (const std::string& symbol : vc.symbols) {
+            auto same = [&](const Instrument& i) { return i.symbol == symbol; };
+            if (std::none_of(config.instruments.begin(), config.instruments.end(), same)) {
+                throw std::invalid_argument(std::string(venue_label(vc.venue)) + " lists unknown symbol " + symbol);
+            }
+        }
+    }
+    if (config.venues.empty()) throw std::invalid_argument("no venue enabled");
+    return config;
+}
+
+std::unique_ptr<Connector> make_connector(const VenueConfig& config, BookListener* aggregator,
+                                          net::io_context& ioc, const std::vector<Instrument>& instruments) {
+    std::unique_ptr<Connector> c;
+    switch (config.venue) {
+    case kBinance: c = std::make_unique<BinanceConnector>(aggregator, ioc, instruments); break;
+    case kOKX:     c = std::make_unique<OKXConnector>(aggregator, ioc, instruments); break;
+    case kBitget:  c = std::make_unique<BitgetConnector>(aggregator, ioc, instruments); break;
+    case kBybit:   c = std::make_unique<BybitConnector>(aggregator, ioc, instruments); break;
+    default: throw std::invalid_argument("no connector for venue " + std::to_string(config.venue));
+    }
+    c->configure(config);
+    return c;
+}
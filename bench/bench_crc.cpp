@@ -0,0 +1,114 @@
+// OKX / Bitget 深度校验和的开销：
+// 1) CRC-32 本身：crc32.h 的 slicing-by-8 与逐位计算（有 zlib 时也与 zlib crc32 比），输入为 25 档拼接长度的数字串；
+// 2) verify_checksum 一次（从原始价位拼前 25 档、算 CRC、比较），簿为回放完该交易所全部帧后的状态；
+// 3) 每条消息的完整处理耗时，校验开 / 关（AGG_VERIFY_CHECKSUM=1 / 0），做法同 bench_parse。
+// 用法: bench_crc [录制目录或 .cap 文件]
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+
+#include "bench_util.h"
+#include "bitget_connector.h"
+#include "crc32.h"
+#include "okx_connector.h"
+#include "venue_frames.h"
+#ifdef BENCH_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+// 逐位计算，对照用
+uint32_t crc_bitwise(const char* data, size_t len) {
+    uint32_t crc = ~0u;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= static_cast<unsigned char>(data[i]);
+        for (int k = 0; k < 8; ++k) crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+    }
+    return ~crc;
+}
+
+// 把 verify_checksum 开放出来
+template <typename Base>
+class Probe : public Base {
+public:
+    using Base::Base;
+    using Connector::verify_checksum;
+};
+
+// 回放 frames 一遍（每轮新建 connector），返回最快一轮每条消息的纳秒数
+template <typename C>
+double per_message_ns(const VenueFrames& frames, bool verify, int rounds) {
+    setenv("AGG_VERIFY_CHECKSUM", verify ? "1" : "0", 1);
+    const std::vector<Instrument> instruments = fixture_instruments();
+    double best = std::numeric_limits<double>::max();
+    QuietLogs quiet;
+    for (int r = 0; r < rounds; ++r) {
+        DrainListener listener;
+        net::io_context ioc;
+        C connector(&listener, ioc, instruments);
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < frames.payloads.size(); ++i) {
+            connector.replay_frame(frames.payloads[i], frames.recv_ns[i]);
+        }
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+    }
+    return best / frames.payloads.size();
+}
+
+// 回放完全部帧后单次 verify_checksum 的纳秒数
+template <typename C>
+double verify_ns(const VenueFrames& frames) {
+    setenv("AGG_VERIFY_CHECKSUM", "1", 1);
+    const std::vector<Instrument> instruments = fixture_instruments();
+    QuietLogs quiet;
+    DrainListener listener;
+    net::io_context ioc;
+    Probe<C> connector(&listener, ioc, instruments);
+    for (size_t i = 0; i < frames.payloads.size(); ++i) {
+        connector.replay_frame(frames.payloads[i], frames.recv_ns[i]);
+    }
+    return time_ns([&] { keep(connector.verify_checksum(0, 0)); });
+}
+
+template <typename C>
+void venue_row(const char* name, const VenueFrames& frames) {
+    if (frames.payloads.empty()) return;
+    const double on = per_message_ns<C>(frames, true, 50);
+    const double off = per_message_ns<C>(frames, false, 50);
+    std::printf("%-8s %7zu %10zu %12.0f %12.0f %14.0f\n", name, frames.payloads.size(),
+                frames.bytes / frames.payloads.size(), on, off, verify_ns<C>(frames));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    // 25 档 bid、ask 交替的 "价:量:" 大约 700 字节
+    std::string text;
+    std::mt19937 rng(1);
+    while (text.size() < 700) {
+        text += std::to_string(60000 + rng() % 1000) + "." + std::to_string(rng() % 10) + ":0." +
+                std::to_string(rng() % 100000) + ":";
+    }
+    const double table = time_ns([&] { keep(crc32_ieee::compute(text.data(), text.size())); });
+    const double bitwise = time_ns([&] { keep(crc_bitwise(text.data(), text.size())); });
+    std::printf("crc32 over %zu bytes: slicing-by-8 %.0f ns, bitwise %.0f ns", text.size(), table, bitwise);
+#ifdef BENCH_HAVE_ZLIB
+    const double zlib = time_ns([&] {
+        keep(crc32(0, reinterpret_cast<const Bytef*>(text.data()), static_cast<uInt>(text.size())));
+    });
+    std::printf(", zlib %.0f ns", zlib);
+#endif
+    std::printf("\n\n");
+
+    VenueFrames frames[kVenueCount];
+    load_frames(fixture_path(argc, argv), frames);
+    std::printf("%-8s %7s %10s %12s %12s %14s\n", "venue", "frames", "avg bytes", "on ns/msg", "off ns/msg",
+                "verify ns");
+    venue_row<OKXConnector>("okx", frames[kOKX]);
+    venue_row<BitgetConnector>("bitget", frames[kBitget]);
+    return 0;
+}
@@ -0,0 +1,107 @@
+// 增量订阅（SubscribeRequest.deltas）省下的带宽：回放录制夹具，每次合并后让同一组参数的
+// 完整簿 BookFeed（每次推前 depth 档快照）、只在变化时推的完整簿 feed（on_change_only）和增量 feed
+// 各生成一次消息（BookFeed::next，与推给订阅者的字节相同），统计消息条数和每条 / 每次合并的字节数。
+// 同时把增量流逐条解码交给客户端的 DeltaBook（clients/common/delta_book.h），每次合并后与完整簿
+// feed 的快照逐档比较，重建不出完整流时返回 1。
+// 回放比实时快得多，增量流里按 AGG_SNAPSHOT_INTERVAL_MS（默认 5 秒）插入的快照几乎不会出现，
+// 实际带宽还要加上每个间隔一条快照。
+// 用法: bench_deltas [录制目录或 .cap 文件]
+#include <memory>
+
+#include "aggregator.h"
+#include "bench_util.h"
+#include "common/delta_book.h"
+#include "replay_harness.h"
+
+namespace {
+
+constexpr std::chrono::milliseconds kSnapshotInterval{5000};  // 与 AGG_SNAPSHOT_INTERVAL_MS 的默认值相同
+
+struct Stream {
+    const char* name;
+    std::unique_ptr<BookFeed> feed;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+
+    // 本次合并要推送的消息，没有返回空
+    EncodedUpdate next(const ConsolidatedBook& book) {
+        EncodedUpdate msg = feed->next(book, 0);
+        if (msg) {
+            ++messages;
+            bytes += msg->buffer.Length();
+        }
+        return msg;
+    }
+};
+
+aggregator::BookUpdate decode(const EncodedUpdate& msg) {
+    grpc::ByteBuffer buffer(msg->buffer);
+    aggregator::BookUpdate update;
+    grpc::SerializationTraits<aggregator::BookUpdate>::Deserialize(&buffer, &update);
+    return update;
+}
+
+// 重建的一边与完整快照的一边逐档比较
+template <typename Side, typename Levels>
+bool same_side(const Side& rebuilt, const Levels& levels) {
+    if (rebuilt.size() != static_cast<size_t>(levels.size())) return false;
+    auto it = rebuilt.begin();
+    for (const auto& lvl : levels) {
+        if (it->first != lvl.price() || it->second != lvl.quantity()) return false;
+        ++it;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int failures = 0;
+    std::string table;  // 回放时 connector 会打日志，结果最后一起打印
+    for (int depth : {10, 20, kTopLevels}) {
+        ReplayHarness harness(fixture_instruments());
+        const Instrument& instrument = harness.instruments()[0];
+        auto make = [&](const char* name, bool deltas, bool on_change_only) {
+            FeedOptions options;
+            options.depth = depth;
+            options.deltas = deltas;
+            options.on_change_only = on_change_only;
+            return Stream{name, std::make_unique<BookFeed>(options, instrument, kSnapshotInterval)};
+        };
+        Stream streams[] = {make("full", false, false), make("full on-change", false, true),
+                            make("deltas", true, false)};
+        Stream& full = streams[0];
+        Stream& deltas = streams[2];
+
+        DeltaBook rebuilt;
+        uint64_t merges = 0, gaps = 0, mismatches = 0;
+        harness.run(fixture_path(argc, argv), [&](size_t inst) {
+            const ConsolidatedBook& book = harness.book(inst);
+            const EncodedUpdate snapshot = full.next(book);
+            streams[1].next(book);
+            const EncodedUpdate delta = deltas.next(book);
+            ++merges;
+            if (delta && !rebuilt.apply(decode(delta))) ++gaps;
+            const aggregator::BookUpdate want = decode(snapshot);
+            if (!same_side(rebuilt.bids(), want.bids()) || !same_side(rebuilt.asks(), want.asks())) ++mismatches;
+        });
+
+        for (const Stream& s : streams) {
+            char row[128];
+            std::snprintf(row, sizeof(row), "%6d %-16s %10llu %14.1f %14.1f %7.2fx\n", depth, s.name,
+                          static_cast<unsigned long long>(s.messages),
+                          s.messages ? static_cast<double>(s.bytes) / s.messages : 0.0,
+                          static_cast<double>(s.bytes) / merges, static_cast<double>(full.bytes) / s.bytes);
+            table += row;
+        }
+        if (gaps || mismatches) {
+            std::fprintf(stderr, "FAIL depth %d: %llu sequence gaps, %llu of %llu merges not rebuilt by DeltaBook\n",
+                         depth, static_cast<unsigned long long>(gaps), static_cast<unsigned long long>(mismatches),
+                         static_cast<unsigned long long>(merges));
+            ++failures;
+        }
+    }
+    std::printf("%6s %-16s %10s %14s %14s %8s\n%s", "depth", "mode", "messages", "bytes/message", "bytes/merge",
+                "ratio", table.c_str());
+    return failures == 0 ? 0 : 1;
+}
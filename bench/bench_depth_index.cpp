@@ -0,0 +1,112 @@
+// 前缀和索引（DepthSide）的代价随深度的变化：合成 1k、10k、100k 档的合并簿买边（相邻档隔 2 tick），
+// 1) 整本重建索引（逐档 push_back）与改一档后 touch + refresh 比较，改动的档分别在最优价、第 100 档、
+//    中间和最深一档——refresh 只重算改动价位之后的档，越靠近盘口越接近整本重建；
+// 2) 在索引上 sweep_qty / sweep_notional（二分）与在簿上逐档累加到同样目标比较，
+//    目标在整边总量 / 总名义金额内均匀随机。
+// 各列均为每次调用的纳秒数。
+// 用法: bench_depth_index
+#include <random>
+
+#include "bench_util.h"
+#include "consolidated_book.h"
+#include "venue_registry.h"
+
+namespace {
+
+constexpr PriceTicks kBestBid = 1000000;
+constexpr int kTargets = 1024;
+
+// 逐档累加到 target 数量，返回吃到的档数
+size_t walk_qty(const ConsolidatedBids& side, Quantity target) {
+    size_t levels = 0;
+    Quantity taken = 0;
+    for (const auto& [price, lvl] : side) {
+        ++levels;
+        taken += lvl.total;
+        if (taken >= target) break;
+    }
+    return levels;
+}
+
+// 逐档累加到 target 名义金额，返回吃到的档数
+size_t walk_notional(const ConsolidatedBids& side, const DepthSide& index, double target) {
+    size_t levels = 0;
+    double notional = 0.0;
+    for (const auto& [price, lvl] : side) {
+        ++levels;
+        notional += index.notional(price, lvl.total);
+        if (notional >= target) break;
+    }
+    return levels;
+}
+
+}  // namespace
+
+int main() {
+    const int64_t tick_units = make_instrument("BTC-USDT", 0.1, "bench").tick_units;
+    std::printf("%8s %12s %12s %12s %12s %12s %10s %10s %10s %10s\n", "levels", "rebuild", "refresh@0",
+                "refresh@100", "refresh@mid", "refresh@last", "sweep_qty", "walk_qty", "sweep_ntl", "walk_ntl");
+
+    for (size_t n : {size_t(1000), size_t(10000), size_t(100000)}) {
+        std::mt19937 rng(7);
+        ConsolidatedBids bids;
+        std::vector<PriceTicks> prices;
+        for (size_t i = 0; i < n; ++i) {
+            const PriceTicks price = kBestBid - 2 * static_cast<PriceTicks>(i);
+            ConsolidatedLevel& lvl = bids[price];
+            lvl.qty[0] = lvl.total = static_cast<Quantity>(1 + rng() % 100) * 1000000;
+            lvl.venue_mask = 1;
+            prices.push_back(price);
+        }
+        DepthSide index(true);
+        index.set_tick_units(tick_units);
+        index.touch(kBestBid);
+        index.refresh(bids);
+
+        const double rebuild = time_ns([&] {
+            DepthSide fresh(true);
+            fresh.set_tick_units(tick_units);
+            for (const auto& [price, lvl] : bids) fresh.push_back(price, lvl.total);
+            keep(fresh);
+        });
+        // 改一档数量（来回加减，簿不变大）后 touch + refresh
+        auto refresh_at = [&](size_t level) {
+            const PriceTicks price = prices[level];
+            Quantity delta = 1000000;
+            return time_ns([&] {
+                bids[price].total += delta;
+                delta = -delta;
+                index.touch(price);
+                index.refresh(bids);
+                keep(index);
+            });
+        };
+        const double at_top = refresh_at(0), at_100 = refresh_at(100), at_mid = refresh_at(n / 2),
+                     at_last = refresh_at(n - 1);
+
+        const DepthView view(index, 0, index.qty(0));
+        std::vector<Quantity> qty_targets;
+        std::vector<double> notional_targets;
+        std::uniform_int_distribution<Quantity> qty_dist(1, index.cum_qty(n - 1));
+        std::uniform_real_distribution<double> notional_dist(0.0, index.cum_notional(n - 1));
+        for (int i = 0; i < kTargets; ++i) {
+            qty_targets.push_back(qty_dist(rng));
+            notional_targets.push_back(notional_dist(rng));
+        }
+        auto per_target = [&](auto&& fn) {
+            return time_ns([&] {
+                size_t levels = 0;
+                for (int i = 0; i < kTargets; ++i) levels += fn(i);
+                keep(levels);
+            }) / kTargets;
+        };
+        const double sweep_qty = per_target([&](int i) { return view.sweep_qty(qty_targets[i]).levels; });
+        const double walk_q = per_target([&](int i) { return walk_qty(bids, qty_targets[i]); });
+        const double sweep_ntl = per_target([&](int i) { return view.sweep_notional(notional_targets[i]).levels; });
+        const double walk_ntl = per_target([&](int i) { return walk_notional(bids, index, notional_targets[i]); });
+
+        std::printf("%8zu %12.0f %12.0f %12.0f %12.0f %12.0f %10.0f %10.0f %10.0f %10.0f\n", n, rebuild, at_top,
+                    at_100, at_mid, at_last, sweep_qty, walk_q, sweep_ntl, walk_ntl);
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+// 一条 BookUpdate 发给 S 个订阅者的序列化 CPU：改动之前每个订阅者 Write 时各序列化一次
+// （与 gRPC 写 proto 消息相同的 SerializationTraits 路径），改动之后编码一次成 ByteBuffer，
+// 每个订阅者只复制 EncodedUpdate 的 shared_ptr 和 ByteBuffer（增加 slice 引用计数）。
+// 消息取自回放录制夹具时每次合并后的前 100 档（带各交易所状态），不含网络发送本身。
+// 用法: bench_fanout [录制目录或 .cap 文件]
+#include <grpcpp/grpcpp.h>
+
+#include <memory>
+
+#include "aggregator.pb.h"
+#include "aggregator.grpc.pb.h"  // 与 aggregator.h 相同，带进 protobuf 的 SerializationTraits
+#include "bench_util.h"
+#include "replay_harness.h"
+
+namespace {
+
+struct EncodedMessage {
+    grpc::ByteBuffer buffer;
+};
+
+aggregator::BookUpdate build_update(const ReplayHarness& harness, const ConsolidatedBook& book, size_t inst) {
+    const int64_t tick_units = harness.instruments()[inst].tick_units;
+    aggregator::BookUpdate update;
+    update.set_symbol(harness.instruments()[inst].symbol);
+    update.set_timestamp_ms(1792324701000);
+    update.set_snapshot(true);
+    int count = 0;
+    for (const auto& [price, lvl] : book.bids) {
+        if (count++ >= kTopLevels) break;
+        auto* out = update.add_bids();
+        out->set_price(ticks_to_price(price, tick_units));
+        out->set_quantity(quantity_to_double(lvl.total));
+    }
+    count = 0;
+    for (const auto& [price, lvl] : book.asks) {
+        if (count++ >= kTopLevels) break;
+        auto* out = update.add_asks();
+        out->set_price(ticks_to_price(price, tick_units));
+        out->set_quantity(quantity_to_double(lvl.total));
+    }
+    for (int v = 0; v < kVenueCount; ++v) {
+        const VenueStamp& s = book.venues[v];
+        if (s.recv_unix_ns == 0) continue;
+        auto* status = update.add_venues();
+        status->set_venue(venue_label(v));
+        status->set_event_time_ms(s.event_ms);
+        status->set_receive_time_ns(s.recv_unix_ns);
+        status->set_sequence(s.sequence);
+    }
+    return update;
+}
+
+grpc::ByteBuffer serialize(const aggregator::BookUpdate& update) {
+    grpc::ByteBuffer buffer;
+    bool own_buffer = false;
+    grpc::SerializationTraits<aggregator::BookUpdate>::Serialize(update, &buffer, &own_buffer);
+    return buffer;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    ReplayHarness harness(fixture_instruments());
+    std::vector<aggregator::BookUpdate> updates;
+    harness.run(fixture_path(argc, argv), [&](size_t inst) {
+        updates.push_back(build_update(harness, harness.book(inst), inst));
+    });
+    size_t bytes = 0;
+    for (const auto& u : updates) bytes += u.ByteSizeLong();
+    std::printf("%zu updates, %zu bytes on average\n", updates.size(), bytes / updates.size());
+    std::printf("%12s %18s %18s %8s\n", "subscribers", "per-sub us/update", "once us/update", "ratio");
+
+    for (int subscribers : {1, 10, 100, 1000}) {
+        // 改动之前：每个订阅者各序列化一次
+        const double per_sub = time_ns([&] {
+            for (const auto& u : updates) {
+                for (int s = 0; s < subscribers; ++s) {
+                    grpc::ByteBuffer buffer = serialize(u);
+                    keep(buffer);
+                }
+            }
+        });
+        // 改动之后：编码一次，每个订阅者的写队列里放一份引用
+        std::vector<std::shared_ptr<const EncodedMessage>> queues(subscribers);
+        const double once = time_ns([&] {
+            for (const auto& u : updates) {
+                auto encoded = std::make_shared<EncodedMessage>();
+                encoded->buffer = serialize(u);
+                for (int s = 0; s < subscribers; ++s) {
+                    queues[s] = encoded;
+                    grpc::ByteBuffer write(queues[s]->buffer);
+                    keep(write);
+                }
+            }
+        });
+        std::printf("%12d %18.2f %18.2f %7.1fx\n", subscribers, per_sub / updates.size() / 1e3,
+                    once / updates.size() / 1e3, per_sub / once);
+    }
+    return 0;
+}
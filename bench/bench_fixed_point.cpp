@@ -0,0 +1,85 @@
+// 定点整数价格前后的合并吞吐：回放录制夹具，记下每次合并时参与合并的各交易所本地簿，
+// 再用改动之前 merge_books 的做法（清空后把各交易所 std::map 逐档相加，取前 100 档）分别合并
+// double 键（price = tick * tick_size，数量为 double）和 int64 键（tick 编号、1e-8 数量）的同一批簿。
+// 只比较价格表示，合并算法相同；增量合并和 FlatBook 的收益见 bench_flat_book。
+// 用法: bench_fixed_point [录制目录或 .cap 文件]
+#include <functional>
+#include <iostream>
+#include <map>
+
+#include "bench_util.h"
+#include "replay_harness.h"
+
+namespace {
+
+template <typename Price, typename Qty>
+struct VenueMaps {
+    std::map<Price, Qty, std::greater<Price>> bids;
+    std::map<Price, Qty> asks;
+};
+
+template <typename Price, typename Qty>
+using MergeInput = std::vector<VenueMaps<Price, Qty>>;  // 一次合并的各交易所簿
+
+// 改动之前的合并：清空、逐档相加、遍历前 100 档
+template <typename Price, typename Qty>
+size_t merge_books(const MergeInput<Price, Qty>& venues, VenueMaps<Price, Qty>& out) {
+    out.bids.clear();
+    out.asks.clear();
+    for (const auto& v : venues) {
+        for (const auto& [price, qty] : v.bids) out.bids[price] += qty;
+        for (const auto& [price, qty] : v.asks) out.asks[price] += qty;
+    }
+    Qty top = Qty{};
+    int count = 0;
+    for (auto it = out.bids.begin(); it != out.bids.end() && count < 100; ++it, ++count) top += it->second;
+    count = 0;
+    for (auto it = out.asks.begin(); it != out.asks.end() && count < 100; ++it, ++count) top += it->second;
+    keep(top);
+    return out.bids.size() + out.asks.size();
+}
+
+template <typename Price, typename Qty>
+void report(const char* label, const std::vector<MergeInput<Price, Qty>>& inputs) {
+    VenueMaps<Price, Qty> out;
+    size_t levels = 0;
+    const double ns = time_ns([&] {
+        levels = 0;
+        for (const auto& in : inputs) levels += merge_books(in, out);
+    });
+    const double per_merge = ns / inputs.size();
+    std::printf("%-8s %10.0f ns/merge %12.0f merges/s  %.0f levels/merge\n", label, per_merge, 1e9 / per_merge,
+                double(levels) / inputs.size());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    ReplayHarness harness(fixture_instruments());
+    const double tick = harness.instruments()[0].tick_size;
+    std::vector<MergeInput<double, double>> doubles;
+    std::vector<MergeInput<PriceTicks, Quantity>> ints;
+    harness.run(fixture_path(argc, argv), [&](size_t inst) {
+        const uint32_t excluded = harness.excluded(inst);
+        MergeInput<double, double>& d = doubles.emplace_back();
+        MergeInput<PriceTicks, Quantity>& n = ints.emplace_back();
+        for (int v = 0; v < kVenueCount; ++v) {
+            if (excluded & (1u << v)) continue;
+            const VenueBook& vb = harness.connector(v).books_[inst];
+            auto& dv = d.emplace_back();
+            auto& nv = n.emplace_back();
+            for (const auto& [price, qty] : vb.bids) {
+                dv.bids[ticks_to_price(price, tick)] = quantity_to_double(qty);
+                nv.bids[price] = qty;
+            }
+            for (const auto& [price, qty] : vb.asks) {
+                dv.asks[ticks_to_price(price, tick)] = quantity_to_double(qty);
+                nv.asks[price] = qty;
+            }
+        }
+    });
+    std::printf("%zu merges replayed\n", ints.size());
+    report("double", doubles);
+    report("int64", ints);
+    return 0;
+}
@@ -0,0 +1,70 @@
+// FlatBook 与 std::map 价位簿对比：回放录制夹具，记下四个交易所每条消息的价位变化，
+// 再把这串变化分别应用到每个交易所一对 std::map 和一对 FlatBook 上（数量为 0 时删除），
+// 分别计只应用、以及每条消息后再遍历两边前 100 档的耗时。
+// 用法: bench_flat_book [录制目录或 .cap 文件]
+#include <functional>
+#include <map>
+
+#include "bench_util.h"
+#include "change_stream.h"
+
+namespace {
+
+struct MapBook {
+    std::map<PriceTicks, Quantity, std::greater<PriceTicks>> bids;
+    std::map<PriceTicks, Quantity> asks;
+};
+
+struct FlatPair {
+    BidBook bids;
+    AskBook asks;
+};
+
+template <typename Side>
+void set(Side& side, PriceTicks price, Quantity qty) {
+    if (qty == 0) side.erase(price);
+    else side[price] = qty;
+}
+
+template <typename Side>
+Quantity top(const Side& side, int n) {
+    Quantity sum = 0;
+    for (auto it = side.begin(); it != side.end() && n-- > 0; ++it) sum += (*it).second;
+    return sum;
+}
+
+template <typename Book>
+double run(const std::vector<RecordedBatch>& stream, bool walk) {
+    return time_ns([&] {
+        Book books[kVenueCount];
+        Quantity sum = 0;
+        for (const RecordedBatch& b : stream) {
+            Book& book = books[b.venue];
+            for (const LevelChange& c : b.changes) {
+                if (c.is_bid) set(book.bids, c.price, c.qty);
+                else set(book.asks, c.price, c.qty);
+            }
+            if (walk) sum += top(book.bids, 100) + top(book.asks, 100);
+        }
+        keep(sum);
+    });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    ChangeRecorder recorder(fixture_instruments());
+    const std::vector<RecordedBatch> stream = recorder.run(fixture_path(argc, argv));
+    size_t changes = 0;
+    for (const RecordedBatch& b : stream) changes += b.changes.size();
+    std::printf("%zu messages, %zu level changes\n", stream.size(), changes);
+
+    for (bool walk : {false, true}) {
+        const double map_ns = run<MapBook>(stream, walk);
+        const double flat_ns = run<FlatPair>(stream, walk);
+        const char* what = walk ? "apply + top-100 walk" : "apply";
+        std::printf("%-22s std::map %8.0f ns/msg  FlatBook %8.0f ns/msg  (%.1fx)\n", what, map_ns / stream.size(),
+                    flat_ns / stream.size(), map_ns / flat_ns);
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+// 合并线程读簿与 connector 写簿的争用：writer 线程循环应用录制夹具里的价位变化，
+// reader 线程同时不停地取四个交易所的簿。
+//   mutex + copy：改动之前的做法，writer 在 book_mutex_ 下改簿，reader 在同一把锁下整簿拷贝（get_*_snapshot）；
+//   SPSC handoff：writer 改自己的簿后把变化整批放进 ChangeHandoff，reader 取出后应用到自己的副本，双方不加锁。
+// 报告 writer 每条消息的耗时分布和吞吐，以及 reader 每秒完成几轮（每轮取遍四个交易所）。
+// 用法: bench_handoff [录制目录或 .cap 文件]
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "bench_util.h"
+#include "change_stream.h"
+
+namespace {
+
+constexpr auto kDuration = std::chrono::seconds(1);
+
+struct Stats {
+    std::vector<uint32_t> write_ns;  // writer 每条消息的耗时
+    uint64_t reader_rounds = 0;
+};
+
+template <typename Book>
+void apply(Book& book, PriceTicks price, Quantity qty) {
+    if (qty == 0) book.erase(price);
+    else book[price] = qty;
+}
+
+void apply(BidBook& bids, AskBook& asks, const std::vector<LevelChange>& changes) {
+    for (const LevelChange& c : changes) {
+        if (c.is_bid) apply(bids, c.price, c.qty);
+        else apply(asks, c.price, c.qty);
+    }
+}
+
+// writer 循环回放 stream 直到 stop，每条消息调用 write(batch) 并计时
+template <typename Write>
+void run_writer(const std::vector<RecordedBatch>& stream, const std::atomic<bool>& stop, Stats& stats,
+                Write&& write) {
+    while (!stop.load(std::memory_order_relaxed)) {
+        for (const RecordedBatch& b : stream) {
+            const auto start = std::chrono::steady_clock::now();
+            write(b);
+            const auto end = std::chrono::steady_clock::now();
+            stats.write_ns.push_back(static_cast<uint32_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+        }
+    }
+}
+
+Stats mutex_copy(const std::vector<RecordedBatch>& stream) {
+    std::mutex book_mutex;
+    BidBook bids[kVenueCount];
+    AskBook asks[kVenueCount];
+    std::atomic<bool> stop{false};
+    Stats stats;
+    std::thread reader([&] {
+        while (!stop.load(std::memory_order_relaxed)) {
+            for (int v = 0; v < kVenueCount; ++v) {
+                BidBook b;
+                AskBook a;
+                {
+                    std::lock_guard<std::mutex> lock(book_mutex);
+                    b = bids[v];
+                }
+                {
+                    std::lock_guard<std::mutex> lock(book_mutex);
+                    a = asks[v];
+                }
+                keep(b);
+                keep(a);
+            }
+            ++stats.reader_rounds;
+        }
+    });
+    std::thread writer([&] {
+        run_writer(stream, stop, stats, [&](const RecordedBatch& b) {
+            std::lock_guard<std::mutex> lock(book_mutex);
+            apply(bids[b.venue], asks[b.venue], b.changes);
+        });
+    });
+    std::this_thread::sleep_for(kDuration);
+    stop = true;
+    writer.join();
+    reader.join();
+    return stats;
+}
+
+Stats spsc_handoff(const std::vector<RecordedBatch>& stream) {
+    struct WriterSide {
+        BidBook bids;
+        AskBook asks;
+        std::vector<LevelChange> pending;  // 队列满时留到下一条
+    };
+    WriterSide writers[kVenueCount];
+    std::unique_ptr<ChangeHandoff> handoff[kVenueCount];
+    for (auto& h : handoff) h = std::make_unique<ChangeHandoff>();
+    std::atomic<bool> stop{false};
+    Stats stats;
+    std::thread reader([&] {
+        BidBook bids[kVenueCount];
+        AskBook asks[kVenueCount];
+        ChangeBatch batch;
+        while (!stop.load(std::memory_order_relaxed)) {
+            for (int v = 0; v < kVenueCount; ++v) {
+                while (handoff[v]->ready.pop(batch)) {
+                    apply(bids[v], asks[v], batch.changes);
+                    batch.changes.clear();
+                    handoff[v]->spare.push(std::move(batch.changes));
+                }
+            }
+            ++stats.reader_rounds;
+        }
+    });
+    std::thread writer([&] {
+        run_writer(stream, stop, stats, [&](const RecordedBatch& b) {
+            WriterSide& w = writers[b.venue];
+            ChangeHandoff& h = *handoff[b.venue];
+            apply(w.bids, w.asks, b.changes);
+            w.pending.insert(w.pending.end(), b.changes.begin(), b.changes.end());
+            ChangeBatch batch{std::move(w.pending), 0, 0, {}};
+            if (!h.ready.push(std::move(batch))) {
+                w.pending = std::move(batch.changes);
+                return;
+            }
+            w.pending.clear();
+            h.spare.pop(w.pending);
+        });
+    });
+    std::this_thread::sleep_for(kDuration);
+    stop = true;
+    writer.join();
+    reader.join();
+    return stats;
+}
+
+void report(const char* label, Stats stats) {
+    std::vector<uint32_t>& ns = stats.write_ns;
+    std::sort(ns.begin(), ns.end());
+    auto pct = [&](double p) { return ns[std::min(ns.size() - 1, static_cast<size_t>(p * ns.size()))]; };
+    double sum = 0;
+    for (uint32_t v : ns) sum += v;
+    const double secs = std::chrono::duration<double>(kDuration).count();
+    std::printf("%-14s %9.0f %8u %8u %8u %10u %12.0f %12.0f\n", label, sum / ns.size(), pct(0.5), pct(0.99),
+                pct(0.999), ns.back(), ns.size() / secs, stats.reader_rounds / secs);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    ChangeRecorder recorder(fixture_instruments());
+    const std::vector<RecordedBatch> stream = recorder.run(fixture_path(argc, argv));
+    std::printf("%zu messages per pass, %lld s per run\n", stream.size(),
+                static_cast<long long>(std::chrono::duration_cast<std::chrono::seconds>(kDuration).count()));
+    std::printf("%-14s %9s %8s %8s %8s %10s %12s %12s\n", "", "mean ns", "p50", "p99", "p99.9", "max",
+                "writes/s", "reads/s");
+    report("mutex + copy", mutex_copy(stream));
+    report("SPSC handoff", spsc_handoff(stream));
+    return 0;
+}
@@ -0,0 +1,144 @@
+// 每多一个交易对的内存和 CPU：把录制夹具里的 BTCUSDT 帧改写成 N 个交易对（X00USDT、X01USDT ...），
+// 按收到顺序交给同一组 connector，由 ReplayHarness 在当前线程逐条合并（不经 MergeScheduler 合批）。
+// 每个 N 在单独的子进程里运行，记录建簿前后和回放后的 RSS 以及回放的 CPU 时间；
+// 每多一个交易对的代价取相对 N = 1 的增量除以 N - 1，connector 等固定开销不计入。
+// 用法: bench_instruments [录制目录或 .cap 文件]
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "bench_util.h"
+#include "replay_harness.h"
+
+namespace {
+
+struct Frame {
+    int64_t recv_ns;
+    int venue;
+    std::string payload;
+};
+
+std::vector<Frame> load(const std::string& path) {
+    std::vector<std::string> files;
+    if (std::filesystem::is_directory(path)) {
+        for (const auto& entry : std::filesystem::directory_iterator(path)) {
+            if (entry.path().extension() == ".cap") files.push_back(entry.path().string());
+        }
+    } else {
+        files.push_back(path);
+    }
+    std::vector<Frame> frames;
+    for (const auto& f : files) {
+        CaptureReader reader(f);
+        CaptureRecord record;
+        std::string_view payload;
+        while (reader.next(record, payload)) {
+            if (record.venue < kVenueCount) frames.push_back({record.recv_ns, record.venue, std::string(payload)});
+        }
+    }
+    std::stable_sort(frames.begin(), frames.end(),
+                     [](const Frame& a, const Frame& b) { return a.recv_ns < b.recv_ns; });
+    return frames;
+}
+
+void replace_all(std::string& s, const std::string& from, const std::string& to) {
+    for (size_t pos = s.find(from); pos != std::string::npos; pos = s.find(from, pos + to.size())) {
+        s.replace(pos, from.size(), to);
+    }
+}
+
+int64_t rss_kb() {
+    std::ifstream statm("/proc/self/statm");
+    int64_t size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+double cpu_ms() {
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e3 + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e3;
+}
+
+struct Result {
+    double built_mb;  // 建簿后的 RSS 增量
+    double full_mb;   // 回放后的 RSS 增量
+    double cpu_ms;    // 回放的 CPU 时间
+};
+
+Result run(const std::vector<Frame>& source, int n) {
+    std::vector<Instrument> instruments;
+    std::vector<std::vector<std::string>> payloads(n);  // [交易对][帧]
+    for (int k = 0; k < n; ++k) {
+        char base[16];
+        std::snprintf(base, sizeof base, "X%02d", k);
+        std::string lower = base;
+        lower[0] = 'x';
+        instruments.push_back(make_instrument(std::string(base) + "-USDT", 0.1, "bench"));
+        for (const Frame& f : source) {
+            std::string p = f.payload;
+            replace_all(p, "BTC", base);
+            replace_all(p, "btc", lower);
+            payloads[k].push_back(std::move(p));
+        }
+    }
+
+    // connector 的日志（同步、断档、析构）不输出
+    std::cout.rdbuf(nullptr);
+    std::cerr.rdbuf(nullptr);
+    Result r{};
+    const int64_t rss_start = rss_kb();
+    ReplayHarness harness(instruments);
+    r.built_mb = (rss_kb() - rss_start) / 1024.0;
+    const double cpu_start = cpu_ms();
+    for (size_t i = 0; i < source.size(); ++i) {
+        for (int k = 0; k < n; ++k) harness.connector(source[i].venue).replay_frame(payloads[k][i], source[i].recv_ns);
+    }
+    r.cpu_ms = cpu_ms() - cpu_start;
+    r.full_mb = (rss_kb() - rss_start) / 1024.0;
+    return r;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const std::vector<Frame> frames = load(fixture_path(argc, argv));
+    const int counts[] = {1, 8, 32, 128};
+    constexpr size_t kRuns = sizeof(counts) / sizeof(counts[0]);
+    // 子进程把结果写进共享映射
+    auto* results = static_cast<Result*>(
+        mmap(nullptr, sizeof(Result) * kRuns, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    for (size_t i = 0; i < kRuns; ++i) {
+        // 每个 N 用新进程，RSS 不受前一轮释放的内存影响
+        const pid_t pid = fork();
+        if (pid == 0) {
+            results[i] = run(frames, counts[i]);
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+    }
+
+    std::printf("%zu frames per instrument, merged one by one\n", frames.size());
+    std::printf("%5s %9s %9s %9s %12s | %12s %12s %12s\n", "N", "built MB", "full MB", "cpu ms", "cpu ns/frame",
+                "+MB/sym", "+full MB/sym", "+cpu ms/sym");
+    const Result& one = results[0];
+    for (size_t i = 0; i < kRuns; ++i) {
+        const Result& r = results[i];
+        const int n = counts[i];
+        std::printf("%5d %9.1f %9.1f %9.1f %12.0f", n, r.built_mb, r.full_mb, r.cpu_ms,
+                    r.cpu_ms * 1e6 / (double(frames.size()) * n));
+        if (n > 1) {
+            std::printf(" | %12.2f %12.2f %12.2f", (r.built_mb - one.built_mb) / (n - 1),
+                        (r.full_mb - one.full_mb) / (n - 1), (r.cpu_ms - one.cpu_ms) / (n - 1));
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+// 各交易所的解析吞吐：快速解析路径（depth_parser 直接读帧、写簿）与 nlohmann::json 路径（AGG_FAST_PARSE=0）。
+// 读出录制夹具里每个交易所的原始帧，每轮新建一个 connector 按顺序 replay_frame 全部帧
+// （包括写本地簿、序号检查和校验和），取多轮中最快的一轮。
+// 用法: bench_parse [录制目录或 .cap 文件]
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+#include "bench_util.h"
+#include "venue_frames.h"
+
+namespace {
+
+// 一个交易所全部帧解析一遍的最短耗时（纳秒）
+double replay_ns(int venue, const VenueFrames& frames, bool fast, int rounds) {
+    setenv("AGG_FAST_PARSE", fast ? "1" : "0", 1);
+    const std::vector<Instrument> instruments = fixture_instruments();
+    double best = std::numeric_limits<double>::max();
+    QuietLogs quiet;
+    for (int r = 0; r < rounds; ++r) {
+        DrainListener listener;
+        net::io_context ioc;
+        VenueConfig vc;
+        vc.venue = static_cast<Venue>(venue);
+        auto connector = make_connector(vc, &listener, ioc, instruments);
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < frames.payloads.size(); ++i) {
+            connector->replay_frame(frames.payloads[i], frames.recv_ns[i]);
+        }
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+    }
+    return best;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    VenueFrames frames[kVenueCount];
+    load_frames(fixture_path(argc, argv), frames);
+    std::printf("%-8s %7s %10s %14s %14s %8s\n", "venue", "frames", "avg bytes", "fast ns/frame", "json ns/frame",
+                "speedup");
+    for (int v = 0; v < kVenueCount; ++v) {
+        const VenueFrames& f = frames[v];
+        if (f.payloads.empty()) continue;
+        const double fast = replay_ns(v, f, true, 50) / f.payloads.size();
+        const double dom = replay_ns(v, f, false, 50) / f.payloads.size();
+        std::printf("%-8s %7zu %10zu %14.0f %14.0f %7.1fx\n", venue_label(v), f.payloads.size(),
+                    f.bytes / f.payloads.size(), fast, dom, dom / fast);
+    }
+    return 0;
+}
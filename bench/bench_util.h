@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// 基准测试公用部分。默认输入是 tests/data 下的录制夹具（BENCH_FIXTURE，由 CMake 传入），
+// 第一个参数可换成别的录制目录或 .cap 文件
+
+inline std::string fixture_path(int argc, char** argv) {
+    return argc > 1 ? argv[1] : BENCH_FIXTURE;
+}
+
+// 反复调用 fn() 直到累计超过 min_ms（至少一次），返回每次调用的平均纳秒数
+template <typename Fn>
+double time_ns(Fn&& fn, int64_t min_ms = 500) {
+    using clock = std::chrono::steady_clock;
+    fn();  // 预热
+    uint64_t calls = 0;
+    const auto start = clock::now();
+    auto now = start;
+    do {
+        fn();
+        ++calls;
+        now = clock::now();
+    } while (now - start < std::chrono::milliseconds(min_ms));
+    return std::chrono::duration<double, std::nano>(now - start).count() / calls;
+}
+
+// 防止编译器把只为计时而算的结果优化掉
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "replay_harness.h"
+
+// 一条消息交给合并线程的价位变化
+struct RecordedBatch {
+    int venue;
+    size_t inst;
+    std::vector<LevelChange> changes;
+};
+
+// 回放录制，按到达顺序记下四个交易所每条消息交出的变化（重新同步时是整簿替换产生的差值）。
+// 只记录，不合并
+class ChangeRecorder : public BookListener {
+public:
+    explicit ChangeRecorder(std::vector<Instrument> instruments) : instruments_(std::move(instruments)) {
+        for (int v = 0; v < kVenueCount; ++v) {
+            VenueConfig vc;
+            vc.venue = static_cast<Venue>(v);
+            connectors_.push_back(make_connector(vc, this, ioc_, instruments_));
+            targets_[v] = connectors_.back().get();
+        }
+    }
+
+    std::vector<RecordedBatch> run(const std::string& path) {
+        batches_.clear();
+        ReplayConnector replay(path, 0, targets_);
+        replay.start();
+        while (!replay.finished()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        replay.stop();
+        return std::move(batches_);
+    }
+
+    void on_book_updated(Connector* c, size_t inst) override {
+        c->publish_changes(inst);
+        c->drain_changes(inst, [&](const ChangeBatch& batch) {
+            batches_.push_back({c->venue_, inst, batch.changes});
+        });
+    }
+    void on_feed_down(Connector*) override {}
+    void on_book_down(Connector*, size_t) override {}
+
+private:
+    std::vector<Instrument> instruments_;
+    net::io_context ioc_;
+    std::vector<std::unique_ptr<Connector>> connectors_;
+    Connector* targets_[kVenueCount] = {};
+    std::vector<RecordedBatch> batches_;
+};
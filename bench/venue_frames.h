@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "replay_harness.h"
+
+// 录制里一个交易所的原始帧，按录制顺序
+struct VenueFrames {
+    std::vector<std::string> payloads;
+    std::vector<int64_t> recv_ns;
+    size_t bytes = 0;
+};
+
+// 读出 path（.cap 文件或目录）里的全部帧，按交易所分开
+inline void load_frames(const std::string& path, VenueFrames (&out)[kVenueCount]) {
+    std::vector<std::string> files;
+    if (std::filesystem::is_directory(path)) {
+        for (const auto& entry : std::filesystem::directory_iterator(path)) {
+            if (entry.path().extension() == ".cap") files.push_back(entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+    } else {
+        files.push_back(path);
+    }
+    for (const auto& f : files) {
+        CaptureReader reader(f);
+        CaptureRecord record;
+        std::string_view payload;
+        while (reader.next(record, payload)) {
+            if (record.venue >= kVenueCount) continue;
+            VenueFrames& v = out[record.venue];
+            v.payloads.emplace_back(payload);
+            v.recv_ns.push_back(record.recv_ns);
+            v.bytes += payload.size();
+        }
+    }
+}
+
+// 只把变化交出并丢弃，避免交接队列写满
+class DrainListener : public BookListener {
+public:
+    void on_book_updated(Connector* c, size_t inst) override {
+        c->publish_changes(inst);
+        c->drain_changes(inst, [](const ChangeBatch&) {});
+    }
+    void on_feed_down(Connector*) override {}
+    void on_book_down(Connector*, size_t) override {}
+};
+
+// 作用域内丢掉 connector 的日志（同步、断档、析构），不输出也不计入耗时
+class QuietLogs {
+public:
+    QuietLogs() : out_(std::cout.rdbuf(nullptr)), err_(std::cerr.rdbuf(nullptr)) {}
+    ~QuietLogs() {
+        std::cout.rdbuf(out_);
+        std::cerr.rdbuf(err_);
+        std::cout.clear();
+        std::cerr.clear();
+    }
+    QuietLogs(const QuietLogs&) = delete;
+    QuietLogs& operator=(const QuietLogs&) = delete;
+
+private:
+    std::streambuf* out_;
+    std::streambuf* err_;
+};
@@ -13,6 +13,12 @@ int main(int argc, char** argv) {
     if (argc > 1) {
         target_str = argv[1];
     }
+    std::string symbol;  // 为空时由服务端选默认交易对
+    if (argc > 2) {
+        symbol = argv[2];
+    }
+    // 默认订阅对冲后的可成交视图，第三个参数为 raw 时看原始合并簿（可能交叉）
+    const bool tradable = !(argc > 3 && std::string(argv[3]) == "raw");
     std::cout << "Connecting to: " << target_str << std::endl;
 
     const int max_retries = 10;
@@ -26,6 +32,10 @@ int main(int argc, char** argv) {
 
         grpc::ClientContext context;
         aggregator::SubscribeRequest request;
+        request.set_symbol(symbol);
+        request.set_max_depth(1);           // 只需要最优一档
+        request.set_on_change_only(true);   // 最优价/量不变时服务端不推送
+        request.set_tradable(tradable);
         auto reader = stub->SubscribeBook(&context, request);
 
         aggregator::BookUpdate update;
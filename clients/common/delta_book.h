@@ -0,0 +1,47 @@
+#pragma once
+
+#include "aggregator.pb.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+
+// 增量订阅（SubscribeRequest.deltas = true）的客户端重建：
+// 收到快照时整体替换，收到增量时按价位覆盖，quantity 为 0 表示删除。
+// apply 返回 false 表示序号不连续，调用方应重新订阅（或等待下一次快照）。
+class DeltaBook {
+public:
+    using Bids = std::map<double, double, std::greater<double>>;
+    using Asks = std::map<double, double>;
+
+    bool apply(const aggregator::BookUpdate& update) {
+        if (update.snapshot()) {
+            bids_.clear();
+            asks_.clear();
+        } else if (!synced_ || update.sequence() != sequence_ + 1) {
+            synced_ = false;
+            return false;
+        }
+        for (const auto& lvl : update.bids()) set(bids_, lvl);
+        for (const auto& lvl : update.asks()) set(asks_, lvl);
+        sequence_ = update.sequence();
+        synced_ = true;
+        return true;
+    }
+
+    const Bids& bids() const { return bids_; }
+    const Asks& asks() const { return asks_; }
+    uint64_t sequence() const { return sequence_; }
+    bool synced() const { return synced_; }
+
+private:
+    template <typename Side>
+    static void set(Side& side, const aggregator::Level& lvl) {
+        if (lvl.quantity() > 0) side[lvl.price()] = lvl.quantity();
+        else side.erase(lvl.price());
+    }
+
+    Bids bids_;
+    Asks asks_;
+    uint64_t sequence_ = 0;
+    bool synced_ = false;
+};
@@ -0,0 +1,162 @@
+#include <grpcpp/grpcpp.h>
+#include "aggregator.grpc.pb.h"
+#include "aggregator.pb.h"
+#include "common/delta_book.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <cstdint>
+#include <cmath>
+
+// 压测客户端：同时开 N 个订阅，统计各订阅的收包数、收到的字节数，
+// 以及 timestamp_ms 到本地收到之间的延迟分位数（同机测试时才有意义），
+// 和 venues 里各交易所从事件时间到聚合器收到的延迟。
+// mode 为 delta 时走增量订阅，并用 DeltaBook 重建、校验序号；
+// 带 +venues（如 full+venues）时订阅各交易所数量明细，并校验明细之和等于总量。
+// 用法: client_load [target] [subscribers] [seconds] [symbol] [full|delta][+venues]
+
+static int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char** argv) {
+    std::string target_str = "localhost:50051";
+    int subscribers = 100;
+    int seconds = 30;
+    if (argc > 1) target_str = argv[1];
+    if (argc > 2) subscribers = std::max(1, std::stoi(argv[2]));
+    if (argc > 3) seconds = std::max(1, std::stoi(argv[3]));
+    std::string symbol;
+    if (argc > 4) symbol = argv[4];
+    std::string mode = argc > 5 ? argv[5] : "full";
+    bool deltas = mode.find("delta") != std::string::npos;
+    bool breakdown = mode.find("+venues") != std::string::npos;
+    bool tradable = mode.find("+tradable") != std::string::npos;
+    std::cout << "Connecting " << subscribers << " subscribers to: " << target_str
+              << " for " << seconds << "s" << std::endl;
+
+    auto channel = grpc::CreateChannel(target_str, grpc::InsecureChannelCredentials());
+    auto stub = aggregator::AggregatorService::NewStub(channel);
+
+    std::vector<std::unique_ptr<grpc::ClientContext>> contexts;
+    for (int i = 0; i < subscribers; ++i) contexts.push_back(std::make_unique<grpc::ClientContext>());
+
+    std::mutex result_mutex;
+    std::vector<int64_t> latencies;
+    std::map<std::string, std::vector<int64_t>> venue_latencies;  // 交易所 -> 事件时间到聚合器收到（ms）
+    std::vector<uint64_t> counts(subscribers, 0);
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> snapshots{0};
+    std::atomic<uint64_t> gaps{0};
+    std::atomic<uint64_t> breakdown_errors{0};
+    std::atomic<uint64_t> crossed{0};  // 第一个订阅者收到的交叉 / 锁定簿
+    std::atomic<int> failed{0};
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < subscribers; ++i) {
+        threads.emplace_back([&, i]() {
+            aggregator::SubscribeRequest request;
+            request.set_symbol(symbol);
+            request.set_deltas(deltas);
+            request.set_venue_breakdown(breakdown);
+            request.set_tradable(tradable);
+            auto reader = stub->SubscribeBook(contexts[i].get(), request);
+            aggregator::BookUpdate update;
+            DeltaBook book;
+            std::vector<int64_t> local;
+            std::map<std::string, std::vector<int64_t>> local_venues;
+            while (reader->Read(&update)) {
+                local.push_back(now_ms() - static_cast<int64_t>(update.timestamp_ms()));
+                // 只统计第一个订阅者，避免同一条消息按订阅者数重复计入
+                if (i == 0) {
+                    for (const auto& v : update.venues()) {
+                        if (v.event_time_ms() == 0) continue;
+                        local_venues[v.venue()].push_back(v.receive_time_ns() / 1000000 - v.event_time_ms());
+                    }
+                }
+                bytes += update.ByteSizeLong();
+                if (update.snapshot()) ++snapshots;
+                if (deltas && !book.apply(update)) ++gaps;
+                if (i == 0) {
+                    const bool is_crossed =
+                        deltas ? (book.synced() && !book.bids().empty() && !book.asks().empty() &&
+                                  book.bids().begin()->first >= book.asks().begin()->first)
+                               : (update.bids_size() > 0 && update.asks_size() > 0 &&
+                                  update.bids(0).price() >= update.asks(0).price());
+                    if (is_crossed) ++crossed;
+                }
+                if (breakdown) {
+                    auto check = [&](const auto& levels) {
+                        for (const auto& lvl : levels) {
+                            if (lvl.quantity() == 0) continue;
+                            double sum = 0;
+                            for (double q : lvl.venue_quantities()) sum += q;
+                            if (__builtin_popcount(lvl.venue_mask()) != lvl.venue_quantities_size() ||
+                                std::abs(sum - lvl.quantity()) > 1e-6) {
+                                ++breakdown_errors;
+                            }
+                        }
+                    };
+                    check(update.bids());
+                    check(update.asks());
+                }
+            }
+            grpc::Status status = reader->Finish();
+            if (!status.ok() && status.error_code() != grpc::StatusCode::CANCELLED) ++failed;
+
+            std::lock_guard<std::mutex> lock(result_mutex);
+            counts[i] = local.size();
+            latencies.insert(latencies.end(), local.begin(), local.end());
+            for (auto& [venue, l] : local_venues) {
+                auto& all = venue_latencies[venue];
+                all.insert(all.end(), l.begin(), l.end());
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    for (auto& ctx : contexts) ctx->TryCancel();
+    for (auto& t : threads) t.join();
+
+    std::sort(counts.begin(), counts.end());
+    uint64_t total = 0;
+    for (uint64_t c : counts) total += c;
+
+    std::cout << "\n=== Load Result ===\n";
+    std::cout << "Updates received: " << total << " ("
+              << std::fixed << std::setprecision(1) << double(total) / seconds << "/s)\n";
+    std::cout << "Per subscriber:   min " << counts.front() << ", max " << counts.back() << "\n";
+    std::cout << "Payload bytes:    " << bytes.load() << " ("
+              << (total ? bytes.load() / total : 0) << " per update, "
+              << snapshots.load() << " snapshots)\n";
+    if (deltas) std::cout << "Sequence gaps:    " << gaps.load() << "\n";
+    if (breakdown) std::cout << "Breakdown errors: " << breakdown_errors.load() << "\n";
+    std::cout << "Crossed books:    " << crossed.load() << " (first subscriber)\n";
+    std::cout << "Failed streams:   " << failed.load() << "\n";
+
+    auto pct = [](const std::vector<int64_t>& sorted, double p) {
+        size_t idx = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+        return sorted[idx];
+    };
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << "Latency (ms):     p50 " << pct(latencies, 0.50) << ", p90 " << pct(latencies, 0.90)
+                  << ", p99 " << pct(latencies, 0.99) << ", p99.9 " << pct(latencies, 0.999)
+                  << ", max " << latencies.back() << "\n";
+    }
+    for (auto& [venue, l] : venue_latencies) {
+        std::sort(l.begin(), l.end());
+        std::cout << "Feed " << std::setw(8) << std::left << venue << std::right
+                  << "(ms): p50 " << pct(l, 0.50) << ", p99 " << pct(l, 0.99) << ", max " << l.back() << "\n";
+    }
+    std::cout << "===================\n";
+    return 0;
+}
@@ -15,6 +15,10 @@ int main(int argc, char** argv) {
     if (argc > 1) {
         target_str = argv[1];
     }
+    std::string symbol;  // 为空时由服务端选默认交易对
+    if (argc > 2) {
+        symbol = argv[2];
+    }
     std::cout << "Connecting to: " << target_str << std::endl;
     
     const int max_retries = 10;
@@ -26,13 +30,17 @@ int main(int argc, char** argv) {
         auto channel = grpc::CreateChannel(target_str, grpc::InsecureChannelCredentials());
         auto stub = aggregator::AggregatorService::NewStub(channel);
 
+        // 档位由服务端在对冲后的可成交视图上计算（mid 才有意义），结果变化时才推送
         grpc::ClientContext context;
-        aggregator::SubscribeRequest request;
-        auto reader = stub->SubscribeBook(&context, request);
-
-        aggregator::BookUpdate update;
+        aggregator::PriceBandsRequest request;
+        request.set_symbol(symbol);
+        request.set_min_interval_ms(100);   // 10Hz 足够刷新显示
+        for (int bps : {1,2,5,10,20,50, 100, 200, 500, 1000}) {
+            request.add_bps(bps);
+        }
+        auto reader = stub->SubscribePriceBands(&context, request);
 
-        const std::vector<int> bps_levels = {1,2,5,10,20,50, 100, 200, 500, 1000};  // bps
+        aggregator::PriceBandsUpdate update;
 
         bool connected = false;
 
@@ -57,8 +65,8 @@ int main(int argc, char** argv) {
                     << std::put_time(&jst_tm, "%Y-%m-%d %H:%M:%S")
                     << '.' << std::setfill('0') << std::setw(3) << ms << " JST ===\n";
 
-            double best_bid = update.bids_size() > 0 ? update.bids(0).price() : 0.0;
-            double best_ask = update.asks_size() > 0 ? update.asks(0).price() : 0.0;
+            double best_bid = update.best_bid();
+            double best_ask = update.best_ask();
 
             if (best_bid <= 0.0 || best_ask <= 0.0) {
                 std::cout << "No valid BBO\n";
@@ -82,34 +90,17 @@ int main(int argc, char** argv) {
             std::cout << "+ bps | Target Bid | Closest Bid |   Qty (BTC)  | Target Ask | Closest Ask | Qty (BTC)\n";
             std::cout << "------|------------|-------------|--------------|------------|-------------|-------------\n";
 
-            for (int bps : bps_levels) {
+            for (const auto& band : update.bands()) {
+                int bps = band.bps();
                 double bps_offset = mid * (bps / 10000.0);
                 double target_bid = mid - bps_offset;  // 更低的买价
                 double target_ask = mid + bps_offset;  // 更高的卖价
 
-                // Find closest bid: highest price <= target_bid
-                double bid_price = 0.0;
-                double bid_qty = 0.0;
-                for (int i = 0; i < update.bids_size(); ++i) {
-                    double p = update.bids(i).price();
-                    if (p <= target_bid + 1e-6) {  // 容差
-                        bid_price = p;
-                        bid_qty = update.bids(i).quantity();
-                        break;  // bids 已从高到低，第一匹配就是最近
-                    }
-                }
-
-                // Find closest ask: lowest price >= target_ask
-                double ask_price = 0.0;
-                double ask_qty = 0.0;
-                for (int i = 0; i < update.asks_size(); ++i) {
-                    double p = update.asks(i).price();
-                    if (p >= target_ask - 1e-6) {
-                        ask_price = p;
-                        ask_qty = update.asks(i).quantity();
-                        break;  // asks 已从低到高，第一匹配就是最近
-                    }
-                }
+                // 服务端给出的最近价位：不高于 target_bid 的最高买价、不低于 target_ask 的最低卖价
+                double bid_price = band.bid_price();
+                double bid_qty = band.bid_quantity();
+                double ask_price = band.ask_price();
+                double ask_qty = band.ask_quantity();
 
                 // 格式化 Closest Bid/Ask 为 2 位小数
                 std::ostringstream bid_price_str, ask_price_str;
@@ -14,6 +14,10 @@ int main(int argc, char** argv) {
     if (argc > 1) {
         target_str = argv[1];
     }
+    std::string symbol;  // 为空时由服务端选默认交易对
+    if (argc > 2) {
+        symbol = argv[2];
+    }
     std::cout << "Connecting to: " << target_str << std::endl;
 
     const int max_retries = 10;
@@ -25,18 +29,22 @@ int main(int argc, char** argv) {
         auto channel = grpc::CreateChannel(target_str, grpc::InsecureChannelCredentials());
         auto stub = aggregator::AggregatorService::NewStub(channel);
 
+        // 档位由服务端在全部深度上计算，结果变化时才推送，每条只有几十字节
         grpc::ClientContext context;
-        aggregator::SubscribeRequest request;
-        auto reader = stub->SubscribeBook(&context, request);
+        aggregator::VolumeBandsRequest request;
+        request.set_symbol(symbol);
+        request.set_min_interval_ms(100);   // 10Hz 足够刷新显示
+        // Volume Bands 阈值（USD）
+        for (double band : {10000.0, 100000.0, 1000000.0, 5000000.0, 10000000.0, 25000000.0, 50000000.0}) {
+            request.add_notionals(band);
+        }
+        auto reader = stub->SubscribeVolumeBands(&context, request);
 
-        aggregator::BookUpdate update;
+        aggregator::VolumeBandsUpdate update;
         std::cout << std::fixed << std::setprecision(2);
 
         bool connected = false;
 
-        // Volume Bands 阈值（USD）
-        const std::vector<double> bands = {10000.0, 100000.0, 1000000.0, 5000000.0, 10000000.0, 25000000.0, 50000000.0};
-
         while (reader->Read(&update)) {
             connected = true;
             retry_count = 0;
@@ -54,52 +62,22 @@ int main(int argc, char** argv) {
                     << std::put_time(&jst_tm, "%Y-%m-%d %H:%M:%S")
                     << '.' << std::setfill('0') << std::setw(3) << ms << " JST ===\n";
 
-            double best_bid = update.bids_size() > 0 ? update.bids(0).price() : 0.0;
-            double best_ask = update.asks_size() > 0 ? update.asks(0).price() : 0.0;
-
-            if (best_bid <= 0.0 || best_ask <= 0.0) {
-                std::cout << "No valid BBO\n";
-                std::cout << "==============================================\n";
-                continue;
-            }
-
-            double mid = (best_bid + best_ask) / 2.0;
-
-            // Volume Bands 计算函数（逐级检查）
-            auto compute_volume_bands = [&](const auto& levels, bool is_bid) {
-                double cum_notional = 0.0;
-                std::vector<double> remaining = bands;
-
-                for (int i = 0; i < levels.size(); ++i) {
-                    const auto& lvl = levels.Get(i);
-                    double level_notional = lvl.price() * lvl.quantity();
-                    cum_notional += level_notional;
-
-                    // 逐个检查每个剩余阈值
-                    for (auto it = remaining.begin(); it != remaining.end(); ) {
-                        if (cum_notional >= *it) {
-                            std::cout << (is_bid ? "Bid " : "Ask ") << *it / 1000000.0 << "M USD @ "
-                                    << lvl.price() << " (cum: " << cum_notional << ")\n";
-                            it = remaining.erase(it);
-                        } else {
-                            ++it;
-                        }
+            // 价格为 0 表示簿上深度不够
+            auto print_bands = [&](bool is_bid) {
+                for (const auto& band : update.bands()) {
+                    double price = is_bid ? band.bid_price() : band.ask_price();
+                    std::cout << (is_bid ? "Bid " : "Ask ") << band.notional() / 1000000.0 << "M USD";
+                    if (price > 0.0) {
+                        std::cout << " @ " << price << "\n";
+                    } else {
+                        std::cout << ": not reached\n";
                     }
-
-                    if (remaining.empty()) break;
-                }
-
-                // 未达到的阈值
-                for (double band : remaining) {
-                    double last_price = levels.size() > 0 ? levels.Get(levels.size() - 1).price() : 0.0;
-                    std::cout << (is_bid ? "Bid " : "Ask ") << band / 1000000.0 << "M USD: not reached "
-                            << "(cum: " << cum_notional << ", nearest @ " << last_price << ")\n";
                 }
             };
 
-            std::cout << "\nVolume Bands:\n";
-            compute_volume_bands(update.bids(), true);
-            compute_volume_bands(update.asks(), false);
+            std::cout << "\nVolume Bands (seq " << update.sequence() << "):\n";
+            print_bands(true);
+            print_bands(false);
 
             std::cout << "==============================================\n";
         }
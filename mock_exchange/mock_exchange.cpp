@@ -0,0 +1,723 @@
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// 本地模拟交易所：在四个端口上分别按 Binance / OKX / Bitget / Bybit 的协议
+// 接受订阅/退订、回确认、应答 ping，并按固定频率推送合成深度：分档快照频道（depth20 / books5 / books50）
+// 每条推送完整前 N 档；Bybit orderbook.50 和增量频道（Binance @depth、OKX / Bitget books）先推快照再推变化。
+// Binance 端口同时应答 REST 深度快照 GET /api/v3/depth?symbol=BTCUSDT&limit=1000。
+// 行情由 seed 和交易对名决定，同样的参数每次推送的内容相同，用于压测和延迟回归。
+// 聚合器用 AGG_<VENUE>_URL=ws://127.0.0.1:<port>（Binance REST 用 AGG_BINANCE_REST_URL=http://127.0.0.1:<port>）指向这里。
+// 用法: mock_exchange [rate] [depth] [base_port] [seed] [cert.pem key.pem]
+//   rate       每个交易对每秒推送条数（默认 10，即 100ms 一条）
+//   depth      每条推送的档数，0 表示各频道默认（Binance 20 / OKX 5 / Bitget 50 / Bybit 50，增量频道 200）
+//   base_port  Binance 端口，OKX / Bitget / Bybit 依次 +1 / +2 / +3（默认 19001）
+//   给出证书和私钥时走 TLS（wss://、https://），否则明文 ws://、http://
+// 环境变量 MOCK_GAP_EVERY=N：增量频道每 N 条更新丢一条（簿和序号照常推进），用来测接收端的断档检测
+// 环境变量 MOCK_STALL=okx:5：该交易所的每个连接开始 5 秒后不再推送也不回 pong（连接不断），用来测过期排除和读超时
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+namespace ssl = boost::asio::ssl;
+using tcp = net::ip::tcp;
+using json = nlohmann::json;
+
+namespace {
+
+enum class Venue { kBinance, kOKX, kBitget, kBybit };
+const char* kVenueNames[] = {"Binance", "OKX", "Bitget", "Bybit"};
+const int kDefaultDepth[] = {20, 5, 50, 50};
+const int kFullDepth = 200;  // 增量频道默认档数
+
+struct Options {
+    double rate = 10;
+    int depth = 0;
+    unsigned short base_port = 19001;
+    uint64_t seed = 1;
+    int gap_every = 0;
+    int stall_venue = -1;  // MOCK_STALL
+    double stall_after_s = 0;
+    std::string cert;
+    std::string key;
+};
+
+// 每个交易所的发送统计，定期打印
+struct Counters {
+    std::atomic<uint64_t> sessions{0};
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> skipped{0};  // 客户端读得慢、写队列积压时跳过的 tick
+    std::atomic<uint64_t> dropped{0};  // MOCK_GAP_EVERY 故意丢掉的增量
+    std::atomic<uint64_t> rest{0};     // REST 深度快照请求
+};
+Counters g_counters[4];
+
+int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 合成订单簿：价格以 0.01 为单位的整数，数量以 1e-4 为单位的整数。
+// 每个 tick 中间价随机游走一步，并随机改动/删除若干档
+class SyntheticBook {
+public:
+    SyntheticBook(const std::string& symbol, uint64_t seed, int levels)
+        : rng_(seed ^ std::hash<std::string>{}(symbol)), levels_(levels) {
+        double mid = 100;
+        if (symbol.rfind("BTC", 0) == 0) mid = 65000;
+        else if (symbol.rfind("ETH", 0) == 0) mid = 3000;
+        else if (symbol.rfind("SOL", 0) == 0) mid = 150;
+        spacing_ = mid >= 1000 ? 10 : 1;
+        mid_ = static_cast<int64_t>(mid * 100) / spacing_ * spacing_;
+        for (int k = 1; k <= levels_; ++k) {
+            bids_[mid_ - k * spacing_] = random_qty();
+            asks_[mid_ + k * spacing_] = random_qty();
+        }
+    }
+
+    void step() {
+        int move = static_cast<int>(rng_() % 5) - 2;  // -2..2，多数时候不动
+        if (move == -2 || move == 2) mid_ += (move / 2) * spacing_;
+        // 穿过中间价的档位移除，两侧补足 levels_ 档
+        while (!bids_.empty() && bids_.begin()->first >= mid_) bids_.erase(bids_.begin());
+        while (!asks_.empty() && asks_.begin()->first <= mid_) asks_.erase(asks_.begin());
+        for (int k = 1; k <= levels_; ++k) {
+            bids_.emplace(mid_ - k * spacing_, random_qty());
+            asks_.emplace(mid_ + k * spacing_, random_qty());
+        }
+        for (int i = 0; i < 6; ++i) {
+            bool bid = rng_() & 1;
+            int64_t price = bid ? mid_ - (1 + rng_() % levels_) * spacing_
+                                : mid_ + (1 + rng_() % levels_) * spacing_;
+            if (rng_() % 10 == 0) {
+                if (bid) bids_.erase(price);
+                else asks_.erase(price);
+            } else {
+                (bid ? bids_[price] : asks_[price]) = random_qty();
+            }
+        }
+        trim(bids_);
+        trim(asks_);
+    }
+
+    template <typename Fn>
+    void top(bool bid, int depth, Fn&& fn) const {
+        int n = 0;
+        auto emit = [&](const auto& side) {
+            for (const auto& [price, qty] : side) {
+                if (n++ >= depth) break;
+                fn(price, qty);
+            }
+        };
+        if (bid) emit(bids_);
+        else emit(asks_);
+    }
+
+    static std::string price(int64_t p) {
+        char buf[32];
+        std::snprintf(buf, sizeof buf, "%lld.%02lld", static_cast<long long>(p / 100),
+                      static_cast<long long>(p % 100));
+        return buf;
+    }
+    static std::string qty(int64_t q) {
+        char buf[32];
+        std::snprintf(buf, sizeof buf, "%lld.%04lld", static_cast<long long>(q / 10000),
+                      static_cast<long long>(q % 10000));
+        return buf;
+    }
+
+private:
+    int64_t random_qty() { return 1 + static_cast<int64_t>(rng_() % 50000); }  // 0.0001 ~ 5
+
+    template <typename Side>
+    void trim(Side& side) {
+        while (static_cast<int>(side.size()) > levels_ + 10) side.erase(std::prev(side.end()));
+    }
+
+    std::mt19937_64 rng_;
+    int levels_;
+    int64_t spacing_;
+    int64_t mid_;
+    std::map<int64_t, int64_t, std::greater<int64_t>> bids_;
+    std::map<int64_t, int64_t> asks_;
+};
+
+// Binance 增量流和 REST 快照（另一条 HTTP 连接）必须基于同一本簿，按交易对全局共享。
+// 同一交易对同时只应有一个连接订阅增量流，否则各连接看到的 U/u 会断档
+struct SharedBook {
+    std::mutex mutex;
+    SyntheticBook book;
+    int depth;
+    uint64_t update_id = 1000;
+    std::map<int64_t, int64_t> last_bids;  // 上次发出的前 depth 档
+    std::map<int64_t, int64_t> last_asks;
+};
+
+SharedBook& shared_book(const std::string& symbol, const Options& options) {
+    static std::mutex mutex;
+    static std::map<std::string, std::unique_ptr<SharedBook>> books;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& slot = books[symbol];
+    if (!slot) {
+        const int depth = options.depth > 0 ? options.depth : kFullDepth;
+        slot.reset(new SharedBook{{}, SyntheticBook(symbol, options.seed, depth + 10), depth, 1000, {}, {}});
+        slot->book.top(true, depth, [&](int64_t p, int64_t q) { slot->last_bids[p] = q; });
+        slot->book.top(false, depth, [&](int64_t p, int64_t q) { slot->last_asks[p] = q; });
+    }
+    return *slot;
+}
+
+// 一个订阅：交易对 + 该频道在协议里的名字
+struct Subscription {
+    std::string channel;   // btcusdt@depth20@100ms / books5 / books50 / orderbook.50 / books / btcusdt@depth@100ms
+    std::string inst_id;   // 回包里的交易对写法
+    SyntheticBook book;
+    int depth;
+    bool incremental;      // 先快照后增量（Bybit 也是，但没有断档注入）
+    SharedBook* shared = nullptr;  // Binance 增量流
+    uint64_t seq = 0;
+    uint64_t updates = 0;  // 已生成的增量条数，用于 MOCK_GAP_EVERY
+    std::map<int64_t, int64_t> last_bids;  // 增量：上次发出的前 depth 档
+    std::map<int64_t, int64_t> last_asks;
+};
+
+std::string levels_json(const SyntheticBook& book, bool bid, int depth, bool okx_style) {
+    std::string out = "[";
+    book.top(bid, depth, [&](int64_t p, int64_t q) {
+        if (out.size() > 1) out += ',';
+        out += "[\"" + SyntheticBook::price(p) + "\",\"" + SyntheticBook::qty(q) + "\"";
+        if (okx_style) out += ",\"0\",\"1\"";
+        out += ']';
+    });
+    out += ']';
+    return out;
+}
+
+// OKX / Bitget 深度校验和：前 25 档 bid、ask 交替拼成 "价:量:价:量..."，CRC-32（zlib 多项式）按有符号返回
+int32_t book_checksum(const SyntheticBook& book) {
+    std::vector<std::string> bids, asks;
+    book.top(true, 25, [&](int64_t p, int64_t q) { bids.push_back(SyntheticBook::price(p) + ":" + SyntheticBook::qty(q)); });
+    book.top(false, 25, [&](int64_t p, int64_t q) { asks.push_back(SyntheticBook::price(p) + ":" + SyntheticBook::qty(q)); });
+    std::string text;
+    for (size_t i = 0; i < 25; ++i) {
+        for (const auto* side : {&bids, &asks}) {
+            if (i >= side->size()) continue;
+            if (!text.empty()) text += ':';
+            text += (*side)[i];
+        }
+    }
+    uint32_t crc = 0xFFFFFFFFu;
+    for (unsigned char c : text) {
+        crc ^= c;
+        for (int k = 0; k < 8; ++k) crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+    }
+    return static_cast<int32_t>(~crc);
+}
+
+// 增量：与上次发出的前 depth 档比对，消失的价位发数量 0；changes 累加发出的档数
+std::string delta_json(const SyntheticBook& book, bool bid, int depth, std::map<int64_t, int64_t>& last,
+                       bool okx_style, size_t* changes = nullptr) {
+    std::map<int64_t, int64_t> cur;
+    book.top(bid, depth, [&](int64_t p, int64_t q) { cur[p] = q; });
+    std::string out = "[";
+    auto add = [&](int64_t p, int64_t q) {
+        if (out.size() > 1) out += ',';
+        out += "[\"" + SyntheticBook::price(p) + "\",\"" + SyntheticBook::qty(q) + "\"";
+        if (okx_style) out += q ? ",\"0\",\"1\"" : ",\"0\",\"0\"";
+        out += ']';
+        if (changes) ++*changes;
+    };
+    for (const auto& [p, q] : last) {
+        if (!cur.count(p)) add(p, 0);
+    }
+    for (const auto& [p, q] : cur) {
+        auto it = last.find(p);
+        if (it == last.end() || it->second != q) add(p, q);
+    }
+    last.swap(cur);
+    out += ']';
+    return out;
+}
+
+template <typename Stream>
+class Session : public std::enable_shared_from_this<Session<Stream>> {
+public:
+    static constexpr size_t kMaxQueued = 64;  // 积压超过这么多条时跳过 tick
+
+    Session(Stream ws, Venue venue, const Options& options)
+        : ws_(std::move(ws)), venue_(venue), options_(options),
+          depth_(options.depth > 0 ? options.depth : kDefaultDepth[static_cast<int>(venue)]),
+          timer_(ws_.get_executor()) {}
+
+    void run() {
+        if constexpr (std::is_same_v<typename Stream::next_layer_type, beast::ssl_stream<beast::tcp_stream>>) {
+            ws_.next_layer().async_handshake(ssl::stream_base::server,
+                [self = this->shared_from_this()](beast::error_code ec) {
+                    if (!ec) self->accept();
+                });
+        } else {
+            accept();
+        }
+    }
+
+private:
+    int index() const { return static_cast<int>(venue_); }
+
+    // 先按 HTTP 读请求：WebSocket 升级请求交给 async_accept(req)，其余当 REST 请求
+    void accept() {
+        beast::get_lowest_layer(ws_).expires_after(std::chrono::seconds(30));
+        http::async_read(ws_.next_layer(), buffer_, request_,
+            [self = this->shared_from_this()](beast::error_code ec, size_t) {
+                if (ec) return;
+                if (websocket::is_upgrade(self->request_)) self->upgrade();
+                else self->serve_rest();
+            });
+    }
+
+    // GET /api/v3/depth?symbol=BTCUSDT&limit=1000（只有 Binance 端口），应答后关闭连接
+    void serve_rest() {
+        ++g_counters[index()].rest;
+        const std::string target(request_.target());
+        auto param = [&](const std::string& key) {
+            size_t pos = target.find(key + "=");
+            if (pos == std::string::npos) return std::string();
+            pos += key.size() + 1;
+            return target.substr(pos, target.find('&', pos) - pos);
+        };
+        response_.version(request_.version());
+        response_.keep_alive(false);
+        response_.set(http::field::content_type, "application/json");
+        const std::string symbol = param("symbol");
+        if (venue_ != Venue::kBinance || target.rfind("/api/v3/depth?", 0) != 0) {
+            response_.result(http::status::not_found);
+            response_.body() = R"({"code":-1,"msg":"not found"})";
+        } else if (symbol.empty()) {
+            response_.result(http::status::bad_request);
+            response_.body() = R"({"code":-1121,"msg":"Invalid symbol."})";
+        } else {
+            const std::string limit_text = param("limit");
+            const int limit = limit_text.empty() ? 100 : std::max(1, std::atoi(limit_text.c_str()));
+            SharedBook& sb = shared_book(symbol, options_);
+            std::lock_guard<std::mutex> lock(sb.mutex);
+            const int depth = std::min(limit, sb.depth);
+            response_.result(http::status::ok);
+            response_.body() = R"({"lastUpdateId":)" + std::to_string(sb.update_id) + R"(,"bids":)" +
+                               levels_json(sb.book, true, depth, false) + R"(,"asks":)" +
+                               levels_json(sb.book, false, depth, false) + "}";
+        }
+        response_.prepare_payload();
+        http::async_write(ws_.next_layer(), response_,
+            [self = this->shared_from_this()](beast::error_code, size_t) {
+                beast::error_code ec;
+                beast::get_lowest_layer(self->ws_).socket().shutdown(tcp::socket::shutdown_send, ec);
+            });
+    }
+
+    void upgrade() {
+        beast::get_lowest_layer(ws_).expires_never();  // 之后由 websocket 自己的超时接管
+        ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+        ws_.async_accept(request_, [self = this->shared_from_this()](beast::error_code ec) {
+            if (ec) return;
+            ++g_counters[self->index()].sessions;
+            self->ws_.text(true);
+            self->do_read();
+            self->next_tick_ = std::chrono::steady_clock::now();
+            self->started_ = self->next_tick_;
+            self->schedule();
+        });
+    }
+
+    void do_read() {
+        ws_.async_read(buffer_, [self = this->shared_from_this()](beast::error_code ec, size_t) {
+            if (ec) return self->close();
+            std::string msg = beast::buffers_to_string(self->buffer_.data());
+            self->buffer_.consume(self->buffer_.size());
+            self->on_message(msg);
+            self->do_read();
+        });
+    }
+
+    // MOCK_STALL：连接开始一段时间后装死
+    bool stalled() const {
+        return options_.stall_venue == index() &&
+               std::chrono::steady_clock::now() - started_ >= std::chrono::duration<double>(options_.stall_after_s);
+    }
+
+    void on_message(const std::string& msg) {
+        if (stalled()) return;
+        if (msg == "ping") {
+            send(venue_ == Venue::kBybit ? R"({"success":true,"ret_msg":"pong","conn_id":"mock","op":"ping"})"
+                                         : "pong");
+            return;
+        }
+        json j = json::parse(msg, nullptr, false);
+        if (j.is_discarded()) return;
+
+        switch (venue_) {
+        case Venue::kBinance:
+            // {"method":"SUBSCRIBE","params":["btcusdt@depth20@100ms"],"id":1}
+            if (j.value("method", "") != "SUBSCRIBE" && j.value("method", "") != "UNSUBSCRIBE") return;
+            for (const auto& p : j["params"]) {
+                std::string stream = p.get<std::string>();
+                std::string symbol = stream.substr(0, stream.find('@'));
+                for (auto& c : symbol) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+                if (j["method"] == "SUBSCRIBE") add(stream, symbol, symbol);
+                else remove(stream, symbol);
+            }
+            send(R"({"result":null,"id":)" + j.value("id", json(1)).dump() + "}");
+            break;
+        case Venue::kOKX:
+        case Venue::kBitget:
+            // {"op":"subscribe","args":[{"channel":"books5","instId":"BTC-USDT"}]}，unsubscribe 同样格式
+            if (j.value("op", "") != "subscribe" && j.value("op", "") != "unsubscribe") return;
+            for (const auto& a : j["args"]) {
+                std::string inst_id = a.value("instId", "");
+                std::string symbol;
+                for (char c : inst_id) if (c != '-') symbol += c;
+                if (j["op"] == "subscribe") add(a.value("channel", ""), inst_id, symbol);
+                else remove(a.value("channel", ""), inst_id);
+                send(R"({"event":")" + j["op"].get<std::string>() + R"(","arg":)" + a.dump() +
+                     R"(,"connId":"mock"})");
+            }
+            break;
+        case Venue::kBybit:
+            // {"op":"subscribe","args":["orderbook.50.BTCUSDT"]}；{"op":"ping"} 也当 ping
+            if (j.value("op", "") == "ping") {
+                send(R"({"success":true,"ret_msg":"pong","conn_id":"mock","op":"ping"})");
+                return;
+            }
+            if (j.value("op", "") != "subscribe") return;
+            for (const auto& a : j["args"]) {
+                std::string topic = a.get<std::string>();
+                std::string symbol = topic.substr(topic.rfind('.') + 1);
+                add(topic, symbol, symbol);
+            }
+            send(R"({"success":true,"ret_msg":"","conn_id":"mock","op":"subscribe"})");
+            break;
+        }
+    }
+
+    void add(const std::string& channel, const std::string& inst_id, const std::string& symbol) {
+        const bool binance_diff = venue_ == Venue::kBinance && channel.find("@depth@") != std::string::npos;
+        const bool incremental = binance_diff || venue_ == Venue::kBybit ||
+                                 ((venue_ == Venue::kOKX || venue_ == Venue::kBitget) && channel == "books");
+        int depth = depth_;
+        if (incremental && venue_ != Venue::kBybit && options_.depth == 0) depth = kFullDepth;
+        SharedBook* shared = binance_diff ? &shared_book(symbol, options_) : nullptr;
+        subs_.push_back(std::make_unique<Subscription>(
+            Subscription{channel, inst_id, SyntheticBook(symbol, options_.seed, depth + 10), depth, incremental,
+                         shared, 0, 0, {}, {}}));
+    }
+
+    void remove(const std::string& channel, const std::string& inst_id) {
+        for (auto it = subs_.begin(); it != subs_.end(); ++it) {
+            if ((*it)->channel == channel && (*it)->inst_id == inst_id) {
+                subs_.erase(it);
+                return;
+            }
+        }
+    }
+
+    // 先快照后增量的频道：第一条发前 depth 档全量，之后只发与上次相比的变化
+    static void book_sides(Subscription& s, bool snapshot, bool okx_style, std::string& bids, std::string& asks) {
+        if (snapshot) {
+            bids = levels_json(s.book, true, s.depth, okx_style);
+            asks = levels_json(s.book, false, s.depth, okx_style);
+            s.last_bids.clear();
+            s.last_asks.clear();
+            s.book.top(true, s.depth, [&](int64_t p, int64_t q) { s.last_bids[p] = q; });
+            s.book.top(false, s.depth, [&](int64_t p, int64_t q) { s.last_asks[p] = q; });
+        } else {
+            bids = delta_json(s.book, true, s.depth, s.last_bids, okx_style);
+            asks = delta_json(s.book, false, s.depth, s.last_asks, okx_style);
+        }
+    }
+
+    // 增量消息经过这里发送，MOCK_GAP_EVERY 在这里丢消息
+    void send_update(Subscription& s, std::string msg) {
+        if (options_.gap_every > 0 && ++s.updates % options_.gap_every == 0) {
+            ++g_counters[index()].dropped;
+            return;
+        }
+        send(std::move(msg));
+    }
+
+    void schedule() {
+        // 按绝对时间推进，发送耗时不累积成漂移
+        next_tick_ += std::chrono::nanoseconds(static_cast<int64_t>(1e9 / options_.rate));
+        timer_.expires_at(next_tick_);
+        timer_.async_wait([self = this->shared_from_this()](beast::error_code ec) {
+            if (ec || self->closed_) return;
+            self->tick();
+            self->schedule();
+        });
+    }
+
+    void tick() {
+        if (stalled()) return;
+        if (queue_.size() > kMaxQueued) {
+            ++g_counters[index()].skipped;
+            return;
+        }
+        const std::string ts = std::to_string(now_ms());
+        for (auto& s : subs_) {
+            if (!s->shared) s->book.step();
+            ++s->seq;
+            const std::string seq = std::to_string(s->seq);
+            const bool snapshot = s->seq == 1;
+            std::string b, a;
+            switch (venue_) {
+            case Venue::kBinance:
+                if (s->shared) {
+                    // 增量流：U/u 为这条覆盖的 update id 范围，接在上一条 u 之后
+                    SharedBook& sb = *s->shared;
+                    std::lock_guard<std::mutex> lock(sb.mutex);
+                    sb.book.step();
+                    size_t changes = 0;
+                    b = delta_json(sb.book, true, sb.depth, sb.last_bids, false, &changes);
+                    a = delta_json(sb.book, false, sb.depth, sb.last_asks, false, &changes);
+                    const uint64_t first = sb.update_id + 1;
+                    sb.update_id += std::max<size_t>(1, changes);
+                    send_update(*s, R"({"stream":")" + s->channel + R"(","data":{"e":"depthUpdate","E":)" + ts +
+                                    R"(,"s":")" + s->inst_id + R"(","U":)" + std::to_string(first) +
+                                    R"(,"u":)" + std::to_string(sb.update_id) + R"(,"b":)" + b +
+                                    R"(,"a":)" + a + "}}");
+                    break;
+                }
+                send(R"({"stream":")" + s->channel + R"(","data":{"lastUpdateId":)" + seq +
+                     R"(,"bids":)" + levels_json(s->book, true, depth_, false) +
+                     R"(,"asks":)" + levels_json(s->book, false, depth_, false) + "}}");
+                break;
+            case Venue::kOKX:
+                if (s->incremental) {
+                    // books：snapshot 的 prevSeqId 为 -1，之后每条 prevSeqId 等于上一条 seqId
+                    book_sides(*s, snapshot, true, b, a);
+                    std::string msg = R"({"arg":{"channel":")" + s->channel + R"(","instId":")" + s->inst_id +
+                                      R"("},"action":")" + (snapshot ? "snapshot" : "update") +
+                                      R"(","data":[{"asks":)" + a + R"(,"bids":)" + b + R"(,"ts":")" + ts +
+                                      R"(","checksum":)" + std::to_string(book_checksum(s->book)) +
+                                      R"(,"prevSeqId":)" + (snapshot ? "-1" : std::to_string(s->seq - 1)) +
+                                      R"(,"seqId":)" + seq + "}]}";
+                    if (snapshot) send(std::move(msg));
+                    else send_update(*s, std::move(msg));
+                    break;
+                }
+                send(R"({"arg":{"channel":")" + s->channel + R"(","instId":")" + s->inst_id +
+                     R"("},"data":[{"asks":)" + levels_json(s->book, false, depth_, true) +
+                     R"(,"bids":)" + levels_json(s->book, true, depth_, true) +
+                     R"(,"ts":")" + ts + R"(","seqId":)" + seq + "}]}");
+                break;
+            case Venue::kBitget:
+                if (s->incremental) {
+                    book_sides(*s, snapshot, false, b, a);
+                    std::string msg = std::string(R"({"action":")") + (snapshot ? "snapshot" : "update") +
+                                      R"(","arg":{"instType":"SPOT","channel":")" + s->channel +
+                                      R"(","instId":")" + s->inst_id + R"("},"data":[{"asks":)" + a +
+                                      R"(,"bids":)" + b + R"(,"checksum":)" + std::to_string(book_checksum(s->book)) +
+                                      R"(,"seq":)" + seq + R"(,"ts":")" + ts +
+                                      R"("}],"ts":)" + ts + "}";
+                    if (snapshot) send(std::move(msg));
+                    else send_update(*s, std::move(msg));
+                    break;
+                }
+                send(R"({"action":"snapshot","arg":{"instType":"SPOT","channel":")" + s->channel +
+                     R"(","instId":")" + s->inst_id + R"("},"data":[{"asks":)" +
+                     levels_json(s->book, false, depth_, false) + R"(,"bids":)" +
+                     levels_json(s->book, true, depth_, false) + R"(,"checksum":0,"seq":)" + seq +
+                     R"(,"ts":")" + ts + R"("}],"ts":)" + ts + "}");
+                break;
+            case Venue::kBybit:
+                book_sides(*s, snapshot, false, b, a);
+                send(R"({"topic":")" + s->channel + R"(","type":")" + (snapshot ? "snapshot" : "delta") +
+                     R"(","ts":)" + ts + R"(,"data":{"s":")" + s->inst_id + R"(","b":)" + b +
+                     R"(,"a":)" + a + R"(,"u":)" + seq + R"(,"seq":)" + seq + R"(},"cts":)" + ts + "}");
+                break;
+            }
+        }
+    }
+
+    void send(std::string msg) {
+        queue_.push_back(std::move(msg));
+        if (queue_.size() == 1) do_write();
+    }
+
+    void do_write() {
+        ws_.async_write(net::buffer(queue_.front()),
+            [self = this->shared_from_this()](beast::error_code ec, size_t n) {
+                if (ec) return self->close();
+                ++g_counters[self->index()].messages;
+                g_counters[self->index()].bytes += n;
+                self->queue_.pop_front();
+                if (!self->queue_.empty()) self->do_write();
+            });
+    }
+
+    void close() {
+        if (closed_) return;
+        closed_ = true;
+        timer_.cancel();
+    }
+
+    Stream ws_;
+    const Venue venue_;
+    const Options& options_;
+    const int depth_;
+    beast::flat_buffer buffer_;
+    http::request<http::string_body> request_;
+    http::response<http::string_body> response_;
+    std::deque<std::string> queue_;
+    std::vector<std::unique_ptr<Subscription>> subs_;
+    net::steady_timer timer_;
+    std::chrono::steady_clock::time_point next_tick_;
+    std::chrono::steady_clock::time_point started_;
+    bool closed_ = false;
+};
+
+// 每个交易所一个监听端口；每个连接放在自己的 strand 上
+class Listener : public std::enable_shared_from_this<Listener> {
+public:
+    Listener(net::io_context& ioc, ssl::context* tls, Venue venue, unsigned short port, const Options& options)
+        : ioc_(ioc), tls_(tls), venue_(venue), options_(options), acceptor_(ioc) {
+        tcp::endpoint ep{net::ip::make_address("0.0.0.0"), port};
+        acceptor_.open(ep.protocol());
+        acceptor_.set_option(net::socket_base::reuse_address(true));
+        acceptor_.bind(ep);
+        acceptor_.listen();
+        std::cout << "[Mock] " << kVenueNames[static_cast<int>(venue)] << " listening on "
+                  << (tls ? "wss" : "ws") << "://0.0.0.0:" << port << std::endl;
+    }
+
+    void run() { do_accept(); }
+
+private:
+    void do_accept() {
+        acceptor_.async_accept(net::make_strand(ioc_),
+            [self = shared_from_this()](beast::error_code ec, tcp::socket socket) {
+                if (!ec) {
+                    socket.set_option(tcp::no_delay(true));
+                    if (self->tls_) {
+                        using Stream = websocket::stream<beast::ssl_stream<beast::tcp_stream>>;
+                        std::make_shared<Session<Stream>>(Stream(std::move(socket), *self->tls_),
+                                                          self->venue_, self->options_)->run();
+                    } else {
+                        using Stream = websocket::stream<beast::tcp_stream>;
+                        std::make_shared<Session<Stream>>(Stream(std::move(socket)), self->venue_,
+                                                          self->options_)->run();
+                    }
+                }
+                self->do_accept();
+            });
+    }
+
+    net::io_context& ioc_;
+    ssl::context* tls_;
+    const Venue venue_;
+    const Options& options_;
+    tcp::acceptor acceptor_;
+};
+
+void print_stats(net::steady_timer& timer, std::chrono::seconds interval) {
+    timer.expires_after(interval);
+    timer.async_wait([&timer, interval](beast::error_code ec) {
+        if (ec) return;
+        for (int v = 0; v < 4; ++v) {
+            Counters& c = g_counters[v];
+            uint64_t msgs = c.messages.exchange(0);
+            uint64_t bytes = c.bytes.exchange(0);
+            if (c.sessions == 0) continue;
+            std::cout << "[Mock] " << kVenueNames[v] << ": sessions " << c.sessions << ", "
+                      << msgs / interval.count() << " msg/s, " << bytes / interval.count() / 1024
+                      << " KB/s, skipped ticks " << c.skipped << ", dropped updates " << c.dropped
+                      << ", REST snapshots " << c.rest << std::endl;
+        }
+        print_stats(timer, interval);
+    });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (argc > 1) options.rate = std::max(0.1, std::stod(argv[1]));
+    if (argc > 2) options.depth = std::max(0, std::stoi(argv[2]));
+    if (argc > 3) options.base_port = static_cast<unsigned short>(std::stoi(argv[3]));
+    if (argc > 4) options.seed = std::stoull(argv[4]);
+    if (const char* gap = std::getenv("MOCK_GAP_EVERY")) options.gap_every = std::max(0, std::atoi(gap));
+    if (const char* stall = std::getenv("MOCK_STALL")) {
+        // venue:seconds，venue 不区分大小写
+        std::string spec(stall);
+        std::string venue = spec.substr(0, spec.find(':'));
+        for (auto& c : venue) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        for (int v = 0; v < 4; ++v) {
+            std::string name = kVenueNames[v];
+            for (auto& c : name) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            if (name == venue) options.stall_venue = v;
+        }
+        if (spec.find(':') != std::string::npos) options.stall_after_s = std::stod(spec.substr(spec.find(':') + 1));
+    }
+    if (argc > 6) {
+        options.cert = argv[5];
+        options.key = argv[6];
+    }
+
+    net::io_context ioc;
+    std::unique_ptr<ssl::context> tls;
+    if (!options.cert.empty()) {
+        tls = std::make_unique<ssl::context>(ssl::context::tlsv12_server);
+        tls->use_certificate_chain_file(options.cert);
+        tls->use_private_key_file(options.key, ssl::context::pem);
+    }
+
+    std::cout << "[Mock] rate " << options.rate << " msg/s per symbol, depth "
+              << (options.depth ? std::to_string(options.depth) : std::string("venue default"))
+              << ", seed " << options.seed;
+    if (options.gap_every) std::cout << ", dropping every " << options.gap_every << "th update";
+    if (options.stall_venue >= 0) {
+        std::cout << ", " << kVenueNames[options.stall_venue] << " stalls after " << options.stall_after_s << " s";
+    }
+    std::cout << std::endl;
+    for (int v = 0; v < 4; ++v) {
+        std::make_shared<Listener>(ioc, tls.get(), static_cast<Venue>(v),
+                                   static_cast<unsigned short>(options.base_port + v), options)->run();
+    }
+
+    net::steady_timer stats_timer(ioc);
+    print_stats(stats_timer, std::chrono::seconds(10));
+
+    net::signal_set signals(ioc, SIGINT, SIGTERM);
+    signals.async_wait([&](beast::error_code, int) { ioc.stop(); });
+
+    // 推送量大时可以多开线程，每个连接仍在自己的 strand 上
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; ++i) pool.emplace_back([&ioc] { ioc.run(); });
+    ioc.run();
+    for (auto& t : pool) t.join();
+    return 0;
+}
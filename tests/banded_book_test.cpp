@@ -0,0 +1,99 @@
+// BandedBook 与 std::map 逐步比对：随机设置 / 删除价位（最优价来回漂移，偶尔跳出很远，不时删除最优价），每步后要求
+// 1) 任一价位的数量（含带外）与 map 一致；
+// 2) 稠密部分恰好是 map 里离最优价 kBandTicks 以内的价位；
+// 3) 把 on_change 交出的变化应用到另一个 map 上，得到的正好是稠密部分（合并端看到的簿）。
+// 跳得再远也不应抛 length_error
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "banded_book.h"
+
+namespace {
+
+int failures = 0;
+
+void fail(const std::string& what) {
+    if (failures++ < 10) std::cerr << "FAIL: " << what << std::endl;
+}
+
+template <bool IsBid>
+void run(uint32_t seed) {
+    using Compare = std::conditional_t<IsBid, std::greater<PriceTicks>, std::less<PriceTicks>>;
+    const char* side = IsBid ? "bids" : "asks";
+    constexpr PriceTicks band = BandedBook<IsBid>::kBandTicks;
+
+    BandedBook<IsBid> book;
+    std::map<PriceTicks, Quantity, Compare> all;        // 全部价位
+    std::map<PriceTicks, Quantity, Compare> published;  // 按 on_change 维护的对外视图
+    std::mt19937 rng(seed);
+    PriceTicks center = 1000000;
+
+    for (int step = 0; step < 50000; ++step) {
+        const uint32_t r = rng() % 1000;
+        if (r == 0) center += static_cast<PriceTicks>(rng() % 4000000) - 2000000;  // 远跳
+        else if (r < 50) center += static_cast<PriceTicks>(rng() % 201) - 100;
+        // 大多数价位落在带内，少数远在带外
+        const PriceTicks spread = rng() % 10 == 0 ? 4 * band : band / 4;
+        PriceTicks price = center + static_cast<PriceTicks>(rng() % (2 * spread + 1)) - spread;
+        Quantity qty = rng() % 3 == 0 ? 0 : 1 + rng() % 1000;
+        // 不时吃掉最优价，让带外价位移回稠密部分
+        if (rng() % 10 == 0 && !book.empty()) {
+            price = book.best_price();
+            qty = 0;
+        }
+
+        try {
+            book.set(price, qty, [&](PriceTicks p, Quantity q) {
+                if (q > 0) published[p] = q;
+                else if (!published.erase(p)) fail(std::string(side) + ": removed unpublished tick " + std::to_string(p));
+            });
+        } catch (const std::exception& e) {
+            fail(std::string(side) + " step " + std::to_string(step) + ": " + e.what());
+            return;
+        }
+        if (qty > 0) all[price] = qty;
+        else all.erase(price);
+
+        if (book.get(price) != qty) fail(std::string(side) + ": get(" + std::to_string(price) + ") mismatch");
+        if (step % 97 != 0) continue;
+
+        // 完整比对
+        size_t dense = 0;
+        for (const auto& [p, q] : all) {
+            if ((IsBid ? all.begin()->first - p : p - all.begin()->first) > band) break;
+            const Quantity* got = book.find(p);
+            if (!got || *got != q) fail(std::string(side) + ": tick " + std::to_string(p) + " missing from band");
+            ++dense;
+        }
+        if (book.size() != dense || book.size() + book.far_size() != all.size()) {
+            fail(std::string(side) + " step " + std::to_string(step) + ": " + std::to_string(book.size()) + "+" +
+                 std::to_string(book.far_size()) + " levels, want " + std::to_string(dense) + "+" +
+                 std::to_string(all.size() - dense));
+        }
+        auto it = published.begin();
+        for (const auto& [p, q] : book) {
+            if (it == published.end() || it->first != p || it->second != q) {
+                fail(std::string(side) + ": published view differs at tick " + std::to_string(p));
+                break;
+            }
+            ++it;
+        }
+        if (published.size() != book.size()) fail(std::string(side) + ": published view size differs");
+        if (failures) return;
+    }
+}
+
+}  // namespace
+
+int main() {
+    run<true>(1);
+    run<false>(2);
+    std::cout << "banded_book_test: " << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
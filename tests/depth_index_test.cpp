@@ -0,0 +1,192 @@
+// 前缀和索引与逐档重算比对：回放录制的四个交易所的原始帧，每隔几次合并 refresh_depth 一次
+// （中间的 touch 累积下来），然后
+// 1) 增量维护的两边 DepthSide 与按原始合并簿整本重建的 DepthSide 逐档比较价格、数量和累计值；
+// 2) 在可成交视图（tradable_depth）上按一组数量 / 名义金额吃单（QueryImpact 的做法），
+//    以及按价格找档（价格档位的做法），与在对冲后的簿上逐档走一遍的结果比较。
+// 用法: depth_index_test <录制目录或 .cap 文件>
+#include <cmath>
+#include <sstream>
+
+#include "replay_harness.h"
+
+namespace {
+
+constexpr uint64_t kRefreshEvery = 3;
+
+struct Level {
+    PriceTicks price;
+    Quantity qty;
+};
+
+// 可成交视图的一边，逐档从原始簿推出：比保留价更优的档去掉，部分对冲的一档用剩余数量
+template <typename Side>
+std::vector<Level> tradable_levels(const Side& side, const Netting& n, const NettedSide& ns, bool is_bid) {
+    std::vector<Level> out;
+    for (const auto& [price, lvl] : side) {
+        if (n.crossed && (is_bid ? price > ns.price : price < ns.price)) continue;
+        const bool partial = n.crossed && price == ns.price && ns.partial;
+        out.push_back({price, partial ? ns.level.qty : lvl.total});
+    }
+    return out;
+}
+
+bool close(double a, double b) { return std::fabs(a - b) <= 1e-9 * std::max(1.0, std::fabs(b)); }
+
+// 逐档吃掉 target 数量
+Sweep walk_qty(const DepthSide& side, const std::vector<Level>& levels, Quantity target) {
+    Sweep s;
+    Quantity taken = 0;
+    for (const Level& l : levels) {
+        const Quantity take = std::min(l.qty, target - taken);
+        taken += take;
+        s.notional += side.notional(l.price, take);
+        ++s.levels;
+        s.worst = l.price;
+        if (taken == target) {
+            s.filled = true;
+            break;
+        }
+    }
+    s.qty = quantity_to_double(taken);
+    return s;
+}
+
+// 逐档吃掉 target 名义金额，最后一档按价格折算数量
+Sweep walk_notional(const DepthSide& side, const std::vector<Level>& levels, double target) {
+    Sweep s;
+    Quantity full = 0;  // 整档吃掉的数量
+    for (const Level& l : levels) {
+        const double n = side.notional(l.price, l.qty);
+        ++s.levels;
+        s.worst = l.price;
+        if (s.notional + n >= target) {
+            s.filled = true;
+            s.qty = quantity_to_double(full) + (target - s.notional) / side.to_price(l.price);
+            s.notional = target;
+            return s;
+        }
+        s.notional += n;
+        full += l.qty;
+    }
+    s.qty = quantity_to_double(full);
+    return s;
+}
+
+std::string describe(const Sweep& s) {
+    std::ostringstream os;
+    os << "{filled " << s.filled << ", levels " << s.levels << ", qty " << s.qty << ", notional " << s.notional
+       << ", worst " << s.worst << "}";
+    return os.str();
+}
+
+bool same_sweep(const Sweep& got, const Sweep& want) {
+    if (got.filled != want.filled || got.levels != want.levels) return false;
+    if (got.levels == 0) return true;
+    return got.worst == want.worst && close(got.qty, want.qty) && close(got.notional, want.notional);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: depth_index_test <capture dir or .cap file>" << std::endl;
+        return 2;
+    }
+    ReplayHarness harness(fixture_instruments());
+    Failures failures;
+    uint64_t merges = 0, checked = 0, sweeps = 0, multi_level = 0;  // multi_level: 吃满且跨多档的
+    harness.run(argv[1], [&](size_t inst) {
+        if (merges++ % kRefreshEvery != 0) return;
+        ConsolidatedBook& book = harness.book(inst);
+        refresh_depth(book);
+        const std::string at = "merge " + std::to_string(merges - 1);
+
+        // 1) 增量 refresh 与整本重建
+        auto check_index = [&](const DepthSide& got, const auto& side, bool is_bid) {
+            const char* name = is_bid ? "bids" : "asks";
+            DepthSide want(is_bid);
+            want.set_tick_units(harness.instruments()[inst].tick_units);
+            for (const auto& [price, lvl] : side) want.push_back(price, lvl.total);
+            if (got.size() != want.size()) {
+                failures.fail(at + " " + name + ": " + std::to_string(got.size()) + " indexed levels vs " +
+                              std::to_string(want.size()));
+                return;
+            }
+            for (size_t i = 0; i < got.size(); ++i) {
+                if (got.price(i) != want.price(i) || got.qty(i) != want.qty(i) || got.cum_qty(i) != want.cum_qty(i) ||
+                    !close(got.cum_notional(i), want.cum_notional(i))) {
+                    failures.fail(at + " " + name + ": index differs at level " + std::to_string(i) + " (tick " +
+                                  std::to_string(got.price(i)) + " vs " + std::to_string(want.price(i)) + ")");
+                    return;
+                }
+            }
+        };
+        check_index(book.bid_depth, book.bids, true);
+        check_index(book.ask_depth, book.asks, false);
+
+        // 2) 可成交视图上的查询与逐档走
+        auto check_view = [&](bool is_bid, const std::vector<Level>& levels) {
+            const char* name = is_bid ? "bids" : "asks";
+            const DepthSide& side = is_bid ? book.bid_depth : book.ask_depth;
+            const DepthView view = tradable_depth(book, is_bid);
+            if (view.size() != levels.size()) {
+                failures.fail(at + " " + name + ": view has " + std::to_string(view.size()) + " levels vs " +
+                              std::to_string(levels.size()));
+                return;
+            }
+            Quantity total = 0;
+            for (size_t i = 0; i < levels.size(); ++i) {
+                total += levels[i].qty;
+                if (view.price(i) != levels[i].price || view.qty(i) != levels[i].qty || view.cum_qty(i) != total) {
+                    failures.fail(at + " " + name + ": view differs at level " + std::to_string(i));
+                    return;
+                }
+            }
+            // 数量：小单、跨多档、正好吃完整边、超过整边
+            for (Quantity q : {Quantity(1000000), Quantity(100000000), Quantity(1000000000), Quantity(10000000000),
+                               total, total + 1}) {
+                if (q <= 0) continue;
+                const Sweep got = view.sweep_qty(q), want = walk_qty(side, levels, q);
+                if (!same_sweep(got, want)) {
+                    failures.fail(at + " " + name + " sweep_qty(" + std::to_string(q) + "): " + describe(got) +
+                                  " vs " + describe(want));
+                }
+                ++sweeps;
+                if (want.filled && want.levels > 1) ++multi_level;
+            }
+            for (double notional : {1234.5, 98765.4, 1.5e6, 2.5e7, 3.5e9}) {
+                const Sweep got = view.sweep_notional(notional), want = walk_notional(side, levels, notional);
+                if (!same_sweep(got, want)) {
+                    failures.fail(at + " " + name + " sweep_notional(" + std::to_string(notional) +
+                                  "): " + describe(got) + " vs " + describe(want));
+                }
+                ++sweeps;
+                if (want.filled && want.levels > 1) ++multi_level;
+            }
+            // 价格：从最优价往外若干 tick 处第一个不优于它的档
+            if (levels.empty()) return;
+            for (PriceTicks offset : {PriceTicks(0), PriceTicks(1), PriceTicks(7), PriceTicks(50), PriceTicks(1000)}) {
+                const PriceTicks limit = is_bid ? levels.front().price - offset : levels.front().price + offset;
+                size_t want = 0;
+                while (want < levels.size() && (is_bid ? levels[want].price > limit : levels[want].price < limit)) {
+                    ++want;
+                }
+                if (view.first_at_or_worse(limit) != want) {
+                    failures.fail(at + " " + name + " first_at_or_worse(" + std::to_string(limit) + ")");
+                }
+            }
+        };
+        const Netting& n = book.netting;
+        check_view(true, tradable_levels(book.bids, n, n.bids, true));
+        check_view(false, tradable_levels(book.asks, n, n.asks, false));
+        ++checked;
+    });
+
+    if (checked < 100) failures.fail("only " + std::to_string(checked) + " refreshes checked");
+    if (multi_level == 0) failures.fail("no sweep filled across several levels");
+
+    std::cout << "depth_index_test: " << merges << " merges, " << checked << " refreshes checked, " << sweeps
+              << " sweeps (" << multi_level << " across several levels), " << failures.count << " mismatches"
+              << std::endl;
+    return failures.count == 0 ? 0 : 1;
+}
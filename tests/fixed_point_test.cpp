@@ -0,0 +1,91 @@
+// parse_decimal 的边界：截断、负数、格式不合法、没有数字和 int64 溢出；
+// tick_size 的校验（必须是 1e-8 的正整数倍）和 tick 编号转回价格
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "fixed_point.h"
+
+namespace {
+
+int failures = 0;
+
+void expect(std::string_view s, int decimals, bool ok, int64_t want = 0) {
+    int64_t got = 0;
+    const bool parsed = parse_decimal(s, decimals, got);
+    if (parsed != ok || (ok && got != want)) {
+        ++failures;
+        std::cerr << "FAIL: parse_decimal(\"" << s << "\", " << decimals << ") = " << parsed << " " << got
+                  << ", want " << ok << " " << want << std::endl;
+    }
+}
+
+void expect_tick(double tick_size, int64_t want) {
+    const int64_t got = tick_size_units(tick_size);
+    if (got != want) {
+        ++failures;
+        std::cerr << "FAIL: tick_size_units(" << tick_size << ") = " << got << ", want " << want << std::endl;
+    }
+}
+
+void expect_price(PriceTicks ticks, int64_t tick_units, double want) {
+    const double got = ticks_to_price(ticks, tick_units);
+    if (got != want) {
+        ++failures;
+        std::cerr.precision(17);
+        std::cerr << "FAIL: ticks_to_price(" << ticks << ", " << tick_units << ") = " << got << ", want " << want
+                  << std::endl;
+    }
+}
+
+}  // namespace
+
+int main() {
+    expect("65000.1", 8, true, 6500010000000);
+    expect("0.00012345", 8, true, 12345);
+    expect("1.123456789", 8, true, 112345678);  // 多余位截断
+    expect("-2.5", 8, true, -250000000);
+    expect(".5", 8, true, 50000000);
+    expect("-.5", 8, true, -50000000);
+    expect("7.", 8, true, 700000000);
+    expect("42", 0, true, 42);
+
+    expect("", 8, false);
+    expect("-", 8, false);
+    expect(".", 8, false);
+    expect("-.", 8, false);
+    expect("1e5", 8, false);
+    expect("+1", 8, false);
+    expect("--1", 8, false);
+    expect("1.2.3", 8, false);
+    expect(" 1", 8, false);
+
+    // 8 位小数时 int64 能表示的最大值为 92233720368.54775807
+    expect("92233720368.54775807", 8, true, INT64_MAX);
+    expect("92233720368.54775808", 8, false);
+    expect("92233720369", 8, false);
+    expect("100000000000", 8, false);
+    expect("-92233720368.54775807", 8, true, -INT64_MAX);
+    expect("99999999999999999999", 8, false);  // from_chars 本身越界
+
+    expect_tick(0.1, 10000000);
+    expect_tick(0.01, 1000000);
+    expect_tick(0.00000001, 1);
+    expect_tick(0.5, 50000000);
+    expect_tick(25, 2500000000);
+    expect_tick(0, 0);
+    expect_tick(-0.1, 0);
+    expect_tick(4e-9, 0);          // 舍入为 0，原始价位除以它会除零
+    expect_tick(1.5e-8, 0);        // 不是 1e-8 的整数倍
+    expect_tick(0.123456789, 0);
+    expect_tick(0.0000000149, 0);
+
+    // 直接乘 double 的 tick_size 会得到 65000.100000000006 一类的值
+    expect_price(650001, 10000000, 65000.1);
+    expect_price(6500012, 1000000, 65000.12);
+    expect_price(3, 10000000, 0.3);
+    expect_price(7, 1, 0.00000007);
+
+    std::cout << "fixed_point_test: " << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// 可成交视图（net_crossed）与暴力重算逐档比对：回放录制的四个交易所的原始帧，每次合并后把原始合并簿
+// 两边整本拷成数组，从两边最优价开始每次对冲两档中较小的数量（档内按交易所最近一次更新从早到晚扣减，
+// 扣完的档删掉），直到不再交叉。得到的两边与按 book.netting 从原始簿推出的可成交视图比较全部档位的
+// 价格、总量、各交易所数量和位图，以及对冲总量。夹具里必须出现过交叉，且有部分对冲的档。
+// 用法: netting_test <录制目录或 .cap 文件>
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <sstream>
+
+#include "replay_harness.h"
+
+namespace {
+
+struct Level {
+    PriceTicks price = 0;
+    Quantity total = 0;
+    Quantity qty[kVenueCount] = {};
+    uint32_t venue_mask = 0;
+};
+
+Level to_level(PriceTicks price, const ConsolidatedLevel& lvl) {
+    Level out;
+    out.price = price;
+    out.total = lvl.total;
+    std::copy(std::begin(lvl.qty), std::end(lvl.qty), std::begin(out.qty));
+    out.venue_mask = lvl.venue_mask;
+    return out;
+}
+
+template <typename Side>
+std::vector<Level> copy_side(const Side& side) {
+    std::vector<Level> out;
+    for (const auto& [price, lvl] : side) out.push_back(to_level(price, lvl));
+    return out;
+}
+
+// 暴力对冲：每步对冲两边首档中较小的数量，返回对冲总量，bids/asks 留下可成交视图
+Quantity brute_net(std::vector<Level>& bids, std::vector<Level>& asks, const int (&order)[kVenueCount]) {
+    auto take = [&](Level& lvl, Quantity m) {
+        lvl.total -= m;
+        for (int v : order) {
+            const Quantity t = std::min(lvl.qty[v], m);
+            lvl.qty[v] -= t;
+            m -= t;
+            if (lvl.qty[v] == 0) lvl.venue_mask &= ~(1u << v);
+        }
+    };
+    size_t b = 0, a = 0;
+    Quantity netted = 0;
+    while (b < bids.size() && a < asks.size() && bids[b].price >= asks[a].price) {
+        const Quantity m = std::min(bids[b].total, asks[a].total);
+        take(bids[b], m);
+        take(asks[a], m);
+        netted += m;
+        if (bids[b].total == 0) ++b;
+        if (asks[a].total == 0) ++a;
+    }
+    bids.erase(bids.begin(), bids.begin() + b);
+    asks.erase(asks.begin(), asks.begin() + a);
+    return netted;
+}
+
+// 按 book.netting 从原始簿推出的一边：比保留价更优的档去掉，部分对冲的一档换成剩余数量
+template <typename Side>
+std::vector<Level> netted_side(const Side& side, const Netting& n, const NettedSide& ns, bool is_bid) {
+    std::vector<Level> out;
+    for (const auto& [price, lvl] : side) {
+        if (n.crossed && (is_bid ? price > ns.price : price < ns.price)) continue;
+        Level l = to_level(price, lvl);
+        if (n.crossed && price == ns.price && ns.partial) {
+            l.total = ns.level.qty;
+            std::copy(std::begin(ns.level.venue_qty), std::end(ns.level.venue_qty), std::begin(l.qty));
+            l.venue_mask = ns.level.venue_mask;
+        }
+        out.push_back(l);
+    }
+    return out;
+}
+
+bool same_side(const std::vector<Level>& got, const std::vector<Level>& want, std::string& diff) {
+    if (got.size() != want.size()) {
+        diff = "level count " + std::to_string(got.size()) + " vs " + std::to_string(want.size());
+        return false;
+    }
+    for (size_t i = 0; i < got.size(); ++i) {
+        bool same = got[i].price == want[i].price && got[i].total == want[i].total &&
+                    got[i].venue_mask == want[i].venue_mask;
+        for (int v = 0; v < kVenueCount; ++v) same = same && got[i].qty[v] == want[i].qty[v];
+        if (!same) {
+            std::ostringstream os;
+            os << "level " << i << ": tick " << got[i].price << " total " << got[i].total << " mask "
+               << got[i].venue_mask << " vs tick " << want[i].price << " total " << want[i].total << " mask "
+               << want[i].venue_mask;
+            diff = os.str();
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: netting_test <capture dir or .cap file>" << std::endl;
+        return 2;
+    }
+    ReplayHarness harness(fixture_instruments());
+    Failures failures;
+    uint64_t checked = 0, crossed = 0, partial = 0;
+    harness.run(argv[1], [&](size_t inst) {
+        const ConsolidatedBook& book = harness.book(inst);
+        const Netting& n = book.netting;
+        const std::string at = "merge " + std::to_string(checked);
+
+        // 与 net_crossed 的扣减顺序一致：最近一次更新从早到晚；同一时间按交易所编号
+        int order[kVenueCount];
+        std::iota(std::begin(order), std::end(order), 0);
+        std::stable_sort(std::begin(order), std::end(order), [&](int a, int b) {
+            return book.venues[a].recv_unix_ns < book.venues[b].recv_unix_ns;
+        });
+        std::vector<Level> bids = copy_side(book.bids);
+        std::vector<Level> asks = copy_side(book.asks);
+        const bool want_crossed = !bids.empty() && !asks.empty() && bids.front().price >= asks.front().price;
+        const Quantity netted = brute_net(bids, asks, order);
+
+        if (n.crossed != want_crossed) failures.fail(at + ": crossed flag " + std::to_string(n.crossed));
+        if (n.netted != netted) {
+            failures.fail(at + ": netted " + std::to_string(n.netted) + " vs " + std::to_string(netted));
+        }
+        std::string diff;
+        if (!same_side(netted_side(book.bids, n, n.bids, true), bids, diff)) failures.fail(at + " bids: " + diff);
+        if (!same_side(netted_side(book.asks, n, n.asks, false), asks, diff)) failures.fail(at + " asks: " + diff);
+        if (n.crossed) ++crossed;
+        if (n.crossed && (n.bids.partial || n.asks.partial)) ++partial;
+        ++checked;
+    });
+
+    if (checked < 100) failures.fail("only " + std::to_string(checked) + " merges replayed");
+    // 夹具里各交易所的簿相互错开，应经常交叉，否则比对没有意义
+    if (crossed == 0) failures.fail("no crossed merge in the fixture");
+    if (partial == 0) failures.fail("no partially netted level in the fixture");
+
+    std::cout << "netting_test: " << checked << " merges, " << crossed << " crossed, " << partial
+              << " with a partially netted level, " << failures.count << " mismatches" << std::endl;
+    return failures.count == 0 ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+// 相隔很远的交易所报价：Bybit 和 OKX 两个 connector 交替收到随机快照（中心价来回漂移，偶尔跳到
+// 离对方几百万 tick 外，再跳回来），经 ReplayHarness 按 Aggregator::merge 的方式合并。每帧之后要求
+// 1) 合并线程不抛异常（合并簿窗口放不下时不能抛 length_error）；
+// 2) 刚更新的交易所与已在合并簿里的放得进同一个窗口时参与合并，放不下时被排除并记为 out_of_range；
+// 3) 合并簿逐档等于参与合并的交易所本地簿之和（含各交易所数量和位图）。
+// 远跳和跳回都必须出现过
+#include <map>
+#include <random>
+#include <sstream>
+
+#include "replay_harness.h"
+
+namespace {
+
+constexpr int kLevels = 10;
+constexpr PriceTicks kBase = 5000000;
+constexpr PriceTicks kFarJump = 3000000;  // 远大于 FlatBook::kMaxSpan（2^20）
+
+// tick 编号 -> 价格字符串（tick 0.1）
+std::string price_text(PriceTicks ticks) {
+    return std::to_string(ticks / 10) + "." + std::to_string(ticks % 10);
+}
+
+// 以 center 为中心各 kLevels 档的买卖盘，[["价","量"],...]
+std::string levels(std::mt19937& rng, PriceTicks center, bool is_bid, bool okx) {
+    std::string out = "[";
+    for (int i = 0; i < kLevels; ++i) {
+        const PriceTicks p = is_bid ? center - 1 - i * 3 : center + 1 + i * 3;
+        if (i) out += ',';
+        out += "[\"" + price_text(p) + "\",\"" + std::to_string(1 + rng() % 50) + (okx ? "\",\"0\",\"1\"]" : "\"]");
+    }
+    return out + "]";
+}
+
+std::string bybit_snapshot(std::mt19937& rng, PriceTicks center, uint64_t u) {
+    return R"({"topic":"orderbook.50.BTCUSDT","type":"snapshot","ts":1,"data":{"s":"BTCUSDT","b":)" +
+           levels(rng, center, true, false) + R"(,"a":)" + levels(rng, center, false, false) + R"(,"u":)" +
+           std::to_string(u) + "}}";
+}
+
+// books5 分档快照（没有 action，不带校验和）
+std::string okx_snapshot(std::mt19937& rng, PriceTicks center, uint64_t seq) {
+    return R"({"arg":{"channel":"books5","instId":"BTC-USDT"},"data":[{"asks":)" + levels(rng, center, false, true) +
+           R"(,"bids":)" + levels(rng, center, true, true) + R"(,"ts":"1","seqId":)" + std::to_string(seq) + "}]}";
+}
+
+// 合并簿的一边与参与合并的交易所本地簿之和逐档比较
+template <typename Side>
+bool same_as_venues(const Side& side, ReplayHarness& harness, uint32_t excluded, bool is_bid) {
+    std::map<PriceTicks, ConsolidatedLevel> want;
+    for (int v = 0; v < kVenueCount; ++v) {
+        if (excluded & (1u << v)) continue;
+        const VenueBook& vb = harness.connector(v).books_[0];
+        auto add = [&](const auto& book) {
+            for (const auto& [price, qty] : book) {
+                ConsolidatedLevel& lvl = want[price];
+                lvl.qty[v] = qty;
+                lvl.total += qty;
+                lvl.venue_mask |= 1u << v;
+            }
+        };
+        if (is_bid) add(vb.bids);
+        else add(vb.asks);
+    }
+    if (side.size() != want.size()) return false;
+    for (const auto& [price, lvl] : side) {
+        auto it = want.find(price);
+        if (it == want.end() || it->second.total != lvl.total || it->second.venue_mask != lvl.venue_mask) return false;
+        for (int v = 0; v < kVenueCount; ++v) {
+            if (it->second.qty[v] != lvl.qty[v]) return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    ReplayHarness harness(fixture_instruments());
+    ConsolidatedBook& book = harness.book(0);
+    const Venue venues[2] = {kBybit, kOKX};
+    PriceTicks center[2] = {kBase, kBase};
+    bool sent[2] = {false, false};
+    uint64_t seq = 1;
+    std::mt19937 rng(3);
+    Failures failures;
+    uint64_t far_exclusions = 0, rejoins = 0;
+
+    for (int step = 0; step < 4000 && failures.count == 0; ++step) {
+        const int k = rng() % 2;
+        const uint32_t r = rng() % 100;
+        if (r < 4) center[k] = center[1 - k] + (center[1 - k] < kBase ? kFarJump : -kFarJump);  // 远跳，价格保持为正
+        else if (r < 12) center[k] = center[1 - k] + static_cast<PriceTicks>(rng() % 2001) - 1000;  // 跳回对方附近
+        else center[k] += static_cast<PriceTicks>(rng() % 101) - 50;
+
+        const Venue v = venues[k];
+        const uint32_t bit = 1u << v;
+        const bool was_out = book.out_of_range & bit;
+        const std::string at = "step " + std::to_string(step) + " " + venue_label(v);
+        try {
+            Connector& c = harness.connector(v);
+            c.replay_frame(k == 0 ? bybit_snapshot(rng, center[k], seq) : okx_snapshot(rng, center[k], seq), 0);
+            ++seq;
+        } catch (const std::exception& e) {
+            failures.fail(at + ": " + e.what());
+            break;
+        }
+        sent[k] = true;
+
+        // 与另一个交易所（已在合并簿里时）是否放得进同一个窗口
+        const uint32_t excluded = harness.excluded(0);
+        const int o = 1 - k;
+        bool fits = true;
+        if (sent[o] && !(excluded & (1u << venues[o]))) {
+            const VenueBook& a = harness.connector(v).books_[0];
+            const VenueBook& b = harness.connector(venues[o]).books_[0];
+            const PriceTicks span = ConsolidatedBids::kMaxSpan;
+            fits = std::max(a.bids.best_price(), b.bids.best_price()) -
+                           std::min(a.bids.worst_price(), b.bids.worst_price()) < span &&
+                   std::max(a.asks.worst_price(), b.asks.worst_price()) -
+                           std::min(a.asks.best_price(), b.asks.best_price()) < span;
+        }
+        const bool in_merge = !(excluded & bit);
+        if (fits != in_merge) {
+            failures.fail(at + ": " + (fits ? "kept out of the merge although it fits" : "merged although out of range"));
+        }
+        if (!fits && !(book.out_of_range & bit)) failures.fail(at + ": excluded but not marked out of range");
+        if (!fits && !was_out) ++far_exclusions;
+        if (fits && was_out) ++rejoins;
+
+        if (!same_as_venues(book.bids, harness, excluded, true)) failures.fail(at + ": bids differ from the venue books");
+        if (!same_as_venues(book.asks, harness, excluded, false)) failures.fail(at + ": asks differ from the venue books");
+    }
+
+    if (far_exclusions < 10) failures.fail("only " + std::to_string(far_exclusions) + " out-of-range exclusions");
+    if (rejoins < 10) failures.fail("only " + std::to_string(rejoins) + " rejoins after coming back in range");
+
+    std::cout << "outlying_venue_test: " << far_exclusions << " out-of-range exclusions, " << rejoins << " rejoins, "
+              << failures.count << " failures" << std::endl;
+    return failures.count == 0 ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+// 订阅节流（PublishThrottle）：用模拟时钟按 BookFeed 的用法驱动（合并后 publish、定时检查时只让 due 的补发），
+// 间隔内的变化之后簿安静下来，定时检查必须把最后的状态推出去，打点取被压下的最早一帧；
+// 间隔内变回原样的不补发；没有待发时定时检查不推送
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "publish_throttle.h"
+
+namespace {
+
+using namespace std::chrono_literals;
+using Clock = PublishThrottle::Clock;
+
+int failures = 0;
+
+void expect(bool ok, const std::string& what) {
+    if (!ok) {
+        ++failures;
+        std::cerr << "FAIL: " << what << std::endl;
+    }
+}
+
+struct Sent {
+    int state;
+    int64_t origin_ns;
+};
+
+// 与 BookFeed 相同的流程：节流、与上次推送比较（on_change_only），推送后记下时间
+class Feed {
+public:
+    explicit Feed(std::chrono::milliseconds min_interval) : throttle_(min_interval) {}
+
+    void publish(Clock::time_point now, int state, int64_t origin_ns) {
+        if (!throttle_.admit(now, origin_ns)) return;
+        if (!sent.empty() && sent.back().state == state) return;
+        sent.push_back({state, origin_ns});
+        throttle_.sent(now);
+    }
+    // 合并线程的定时检查：簿没有变化
+    void check(Clock::time_point now, int state) {
+        if (throttle_.due(now)) publish(now, state, 0);
+    }
+    bool pending() const { return throttle_.pending(); }
+
+    std::vector<Sent> sent;
+
+private:
+    PublishThrottle throttle_;
+};
+
+}  // namespace
+
+int main() {
+    const Clock::time_point t0{};
+
+    {
+        Feed feed(50ms);
+        feed.publish(t0, 1, 100);
+        expect(feed.sent.size() == 1, "first change is sent at once");
+        feed.publish(t0 + 10ms, 2, 200);
+        feed.publish(t0 + 20ms, 3, 300);
+        expect(feed.sent.size() == 1 && feed.pending(), "changes inside the interval are held");
+        feed.check(t0 + 30ms, 3);
+        expect(feed.sent.size() == 1, "check before the interval ends does not send");
+        // 之后簿不再变化，只有定时检查
+        feed.check(t0 + 130ms, 3);
+        expect(feed.sent.size() == 2 && feed.sent.back().state == 3, "quiet book: held state is flushed by the check");
+        expect(feed.sent.back().origin_ns == 200, "flushed update carries the earliest held origin");
+        expect(!feed.pending(), "nothing pending after the flush");
+        feed.check(t0 + 230ms, 3);
+        expect(feed.sent.size() == 2, "check without a held change does not send");
+        feed.publish(t0 + 240ms, 4, 400);
+        expect(feed.sent.size() == 3 && feed.sent.back().origin_ns == 400, "change after the interval is sent at once");
+    }
+    {
+        // 间隔内变了又变回去：到期时与上次推送相同，不补发，也不再挂着待发
+        Feed feed(50ms);
+        feed.publish(t0, 1, 100);
+        feed.publish(t0 + 10ms, 2, 200);
+        feed.publish(t0 + 20ms, 1, 300);
+        feed.check(t0 + 100ms, 1);
+        expect(feed.sent.size() == 1 && !feed.pending(), "change reverted inside the interval is not re-sent");
+    }
+    {
+        // 到期后的下一次合并直接推送，定时检查不再重复
+        Feed feed(50ms);
+        feed.publish(t0, 1, 100);
+        feed.publish(t0 + 10ms, 2, 200);
+        feed.publish(t0 + 60ms, 3, 300);
+        expect(feed.sent.size() == 2 && feed.sent.back().state == 3 && feed.sent.back().origin_ns == 200,
+               "next merge after the interval sends the latest state");
+        feed.check(t0 + 100ms, 3);
+        expect(feed.sent.size() == 2, "check after a merge-time send does not repeat it");
+    }
+    {
+        // 不节流：每次变化都推送，从不挂待发
+        Feed feed(0ms);
+        for (int i = 1; i <= 5; ++i) feed.publish(t0 + i * 1ms, i, i);
+        expect(feed.sent.size() == 5 && !feed.pending(), "no interval: every change is sent");
+    }
+
+    std::cout << "publish_throttle_test: " << failures << " failures" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "consolidated_book.h"
+#include "replay_connector.h"
+#include "venue_registry.h"
+
+// 测试用的合并端：录制文件经 ReplayConnector 交给真实的四个 connector 解析，
+// 每条消息交出的变化在回放线程里立即按 Aggregator::merge 的方式合并（排除 / 加回、增量应用、对冲），
+// 然后调用 on_merge(inst) 做检查。connector 不连网，io_context 不运行
+class ReplayHarness : public BookListener {
+public:
+    explicit ReplayHarness(std::vector<Instrument> instruments) : instruments_(std::move(instruments)) {
+        for (size_t i = 0; i < instruments_.size(); ++i) {
+            books_.push_back(std::make_unique<ConsolidatedBook>());
+            books_.back()->bid_depth.set_tick_units(instruments_[i].tick_units);
+            books_.back()->ask_depth.set_tick_units(instruments_[i].tick_units);
+        }
+        for (int v = 0; v < kVenueCount; ++v) {
+            VenueConfig vc;
+            vc.venue = static_cast<Venue>(v);
+            connectors_.push_back(make_connector(vc, this, ioc_, instruments_));
+            targets_[v] = connectors_.back().get();
+        }
+    }
+
+    // 按收到时间回放 path（.cap 文件或目录），结束后返回
+    void run(const std::string& path, std::function<void(size_t inst)> on_merge) {
+        on_merge_ = std::move(on_merge);
+        ReplayConnector replay(path, 0, targets_);
+        replay.start();
+        while (!replay.finished()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        replay.stop();
+    }
+
+    ConsolidatedBook& book(size_t inst) { return *books_[inst]; }
+    Connector& connector(int venue) { return *targets_[venue]; }
+    const std::vector<Instrument>& instruments() const { return instruments_; }
+    uint32_t excluded(size_t inst) const { return books_[inst]->excluded.load(std::memory_order_relaxed); }
+    uint64_t merges() const { return merges_; }
+
+    void on_book_updated(Connector* c, size_t inst) override {
+        c->publish_changes(inst);
+        ConsolidatedBook& book = *books_[inst];
+        const Venue v = c->venue_;
+        const uint32_t bit = 1u << v;
+        uint32_t excluded = book.excluded.load(std::memory_order_relaxed);
+        if (excluded & bit) {
+            // 价格离其他交易所太远时继续排除（见 Aggregator::merge）
+            if (include_venue(book, *c, inst, scratch_)) {
+                book.out_of_range &= ~bit;
+                book.excluded.store(excluded & ~bit, std::memory_order_relaxed);
+            } else {
+                book.out_of_range |= bit;
+            }
+        } else {
+            bool in_range = true;
+            c->drain_changes(inst, [&](const ChangeBatch& batch) {
+                if (!in_range) return;
+                book.venues[v] = batch.stamp;
+                in_range = apply_changes(book, v, batch.changes);
+            });
+            if (!in_range) {
+                exclude_venue(book, v, scratch_);
+                book.out_of_range |= bit;
+                book.excluded.store(excluded | bit, std::memory_order_relaxed);
+            }
+        }
+        merge_done(inst);
+    }
+
+    void on_feed_down(Connector* c) override {
+        for (size_t i = 0; i < instruments_.size(); ++i) drop(c, i);
+    }
+
+    void on_book_down(Connector* c, size_t inst) override { drop(c, inst); }
+
+private:
+    void drop(Connector* c, size_t inst) {
+        ConsolidatedBook& book = *books_[inst];
+        const uint32_t bit = 1u << c->venue_;
+        const uint32_t excluded = book.excluded.load(std::memory_order_relaxed);
+        book.out_of_range &= ~bit;
+        if (excluded & bit) return;
+        exclude_venue(book, c->venue_, scratch_);
+        c->drain_changes(inst, [](const ChangeBatch&) {});
+        book.excluded.store(excluded | bit, std::memory_order_relaxed);
+        merge_done(inst);
+    }
+
+    void merge_done(size_t inst) {
+        net_crossed(*books_[inst]);
+        ++merges_;
+        if (on_merge_) on_merge_(inst);
+    }
+
+    std::vector<Instrument> instruments_;
+    std::vector<std::unique_ptr<ConsolidatedBook>> books_;
+    net::io_context ioc_;
+    std::vector<std::unique_ptr<Connector>> connectors_;
+    Connector* targets_[kVenueCount] = {};
+    std::vector<LevelChange> scratch_;
+    std::function<void(size_t)> on_merge_;
+    uint64_t merges_ = 0;
+};
+
+// 录制夹具用的交易对，与 mock_exchange 的 BTCUSDT 一致
+inline std::vector<Instrument> fixture_instruments() {
+    return {make_instrument("BTC-USDT", 0.1, "fixture")};
+}
+
+// 失败计数：打印前几条，main 按总数返回
+struct Failures {
+    uint64_t count = 0;
+    void fail(const std::string& what) {
+        if (count++ < 10) std::cerr << "FAIL: " << what << std::endl;
+    }
+};